@@ -8,6 +8,7 @@
 // else.
 #include "util/asio.h"
 #include "bucket/BucketApplicator.h"
+#include "bucket/BucketIndex.h"
 #include "bucket/BucketList.h"
 #include "bucket/BucketManager.h"
 #include "bucket/LedgerCmp.h"
@@ -25,14 +26,18 @@
 #include "lib/util/format.h"
 #include "main/Application.h"
 #include "medida/medida.h"
+#include "util/BlockCompression.h"
 #include "util/Fs.h"
 #include "util/Logging.h"
 #include "util/TmpDir.h"
 #include "util/XDRStream.h"
 #include "util/make_unique.h"
 #include "xdrpp/message.h"
+#include "xdrpp/printer.h"
+#include <algorithm>
 #include <cassert>
 #include <future>
+#include <map>
 
 namespace stellar
 {
@@ -69,6 +74,7 @@ Bucket::~Bucket()
     {
         CLOG(TRACE, "Bucket") << "Bucket::~Bucket removing file: " << mFilename;
         std::remove(mFilename.c_str());
+        std::remove(indexFilename(mFilename).c_str());
     }
 }
 
@@ -94,6 +100,33 @@ Bucket::setRetain(bool r)
     mRetain = r;
 }
 
+std::string
+Bucket::indexFilename(std::string const& bucketFilename)
+{
+    return bucketFilename + ".index";
+}
+
+static LedgerKey
+getBucketEntryKey(BucketEntry const& e)
+{
+    if (e.type() == LIVEENTRY)
+    {
+        return LedgerEntryKey(e.liveEntry());
+    }
+    return e.deadEntry();
+}
+
+static bool
+entryLessThanKey(BucketEntry const& e, LedgerKey const& key)
+{
+    LedgerEntryIdCmp cmp;
+    if (e.type() == LIVEENTRY)
+    {
+        return cmp(e.liveEntry(), key);
+    }
+    return cmp(e.deadEntry(), key);
+}
+
 /**
  * Helper class that reads from the file underlying a bucket, keeping the bucket
  * alive for the duration of its existence.
@@ -107,11 +140,16 @@ class Bucket::InputIterator
     BucketEntry const* mEntryPtr;
     XDRInputFileStream mIn;
     BucketEntry mEntry;
+    uint64_t mEntryOffset{0};
+    size_t mBlockSize;
+    LedgerKey const* mEnd{nullptr};
+    std::shared_ptr<BucketIndex const> mIndex;
 
     void
     loadEntry()
     {
-        if (mIn.readOne(mEntry))
+        mEntryOffset = mIn.pos();
+        if (mIn.readOne(mEntry) && !(mEnd && !entryLessThanKey(mEntry, *mEnd)))
         {
             mEntryPtr = &mEntry;
         }
@@ -132,8 +170,13 @@ class Bucket::InputIterator
         return *mEntryPtr;
     }
 
-    InputIterator(std::shared_ptr<Bucket const> bucket)
-        : mBucket(bucket), mEntryPtr(nullptr)
+    InputIterator(std::shared_ptr<Bucket const> bucket,
+                  size_t blockSize = XDRInputFileStream::kDefaultBlockSize,
+                  bool useMmap = false)
+        : mBucket(bucket)
+        , mEntryPtr(nullptr)
+        , mIn(0, blockSize, useMmap)
+        , mBlockSize(blockSize)
     {
         if (!mBucket->mFilename.empty())
         {
@@ -150,6 +193,71 @@ class Bucket::InputIterator
         mIn.close();
     }
 
+    // Restrict the iterator to entries with keys in [*begin, *end), either of
+    // which may be null for an unbounded range. Uses the bucket's index to
+    // skip straight to the page holding `begin`. Keys must outlive the
+    // iterator.
+    void
+    setRange(LedgerKey const* begin, LedgerKey const* end)
+    {
+        mEnd = end;
+        if (mBucket->mFilename.empty())
+        {
+            return;
+        }
+        if (!begin)
+        {
+            if (mEntryPtr && mEnd && !entryLessThanKey(*mEntryPtr, *mEnd))
+            {
+                mEntryPtr = nullptr;
+            }
+            return;
+        }
+
+        mIndex = mBucket->getIndex();
+        auto const& pages = mIndex->getPages();
+        LedgerEntryIdCmp cmp;
+        auto i = std::upper_bound(
+            pages.begin(), pages.end(), *begin,
+            [&cmp](LedgerKey const& k, BucketIndex::Page const& p) {
+                return cmp(k, p.mFirstKey);
+            });
+        mIn.seek(i == pages.begin() ? 0 : (i - 1)->mOffset);
+        loadEntry();
+        while (mEntryPtr && entryLessThanKey(*mEntryPtr, *begin))
+        {
+            loadEntry();
+        }
+    }
+
+    // Consult the bucket's index before reading on towards `key`. Returns
+    // false, without touching the bucket file, if the bucket holds no entry
+    // for `key`. Otherwise, if the page that may hold `key` starts more than
+    // a block ahead, seeks straight to it instead of reading up to it.
+    bool
+    skipTowards(LedgerKey const& key)
+    {
+        if (!mEntryPtr)
+        {
+            return false;
+        }
+        if (!mIndex)
+        {
+            mIndex = mBucket->getIndex();
+        }
+        auto page = mIndex->findPage(key);
+        if (!page)
+        {
+            return false;
+        }
+        if (page->mOffset > mEntryOffset + mBlockSize)
+        {
+            mIn.seek(page->mOffset);
+            loadEntry();
+        }
+        return true;
+    }
+
     InputIterator& operator++()
     {
         if (mIn)
@@ -175,20 +283,26 @@ class Bucket::OutputIterator
     BucketEntryIdCmp mCmp;
     std::unique_ptr<BucketEntry> mBuf;
     std::unique_ptr<SHA256> mHasher;
+    std::unique_ptr<BucketIndex> mIndex;
     size_t mBytesPut{0};
     size_t mObjectsPut{0};
     bool mKeepDeadEntries{true};
 
   public:
-    OutputIterator(std::string const& tmpDir, bool keepDeadEntries)
+    // If `compressed` is set the file is written block-compressed. If
+    // `hashed` is false the output is not hashed, and can only be finished
+    // with `finishPart`.
+    OutputIterator(std::string const& tmpDir, bool keepDeadEntries,
+                   bool compressed, bool hashed = true)
         : mFilename(randomBucketName(tmpDir))
         , mBuf(nullptr)
-        , mHasher(SHA256::create())
+        , mHasher(hashed ? SHA256::create() : nullptr)
+        , mIndex(make_unique<BucketIndex>())
         , mKeepDeadEntries(keepDeadEntries)
     {
         CLOG(TRACE, "Bucket")
             << "Bucket::OutputIterator opening file to write: " << mFilename;
-        mOut.open(mFilename);
+        mOut.open(mFilename, compressed);
     }
 
     void
@@ -210,6 +324,7 @@ class Bucket::OutputIterator
             // merely replace (same identity), the buffered entry.
             if (mCmp(*mBuf, e))
             {
+                mIndex->addEntry(getBucketEntryKey(*mBuf), mBytesPut);
                 mOut.writeOne(*mBuf, mHasher.get(), &mBytesPut);
                 mObjectsPut++;
             }
@@ -223,12 +338,15 @@ class Bucket::OutputIterator
         *mBuf = e;
     }
 
-    std::shared_ptr<Bucket>
-    getBucket(BucketManager& bucketManager)
+    // Flush the buffered entry and close the file. Returns false, having
+    // deleted the file, if nothing was written.
+    bool
+    finish()
     {
         assert(mOut);
         if (mBuf)
         {
+            mIndex->addEntry(getBucketEntryKey(*mBuf), mBytesPut);
             mOut.writeOne(*mBuf, mHasher.get(), &mBytesPut);
             mObjectsPut++;
             mBuf.reset();
@@ -241,29 +359,131 @@ class Bucket::OutputIterator
             assert(mBytesPut == 0);
             CLOG(DEBUG, "Bucket") << "Deleting empty bucket file " << mFilename;
             std::remove(mFilename.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    std::shared_ptr<Bucket>
+    getBucket(BucketManager& bucketManager)
+    {
+        assert(mHasher);
+        if (!finish())
+        {
             return std::make_shared<Bucket>();
         }
+        mIndex->save(Bucket::indexFilename(mFilename));
         return bucketManager.adoptFileAsBucket(mFilename, mHasher->finish(),
                                                mObjectsPut, mBytesPut);
     }
+
+    // The output of one key range of a partitioned merge, to be concatenated
+    // with the other ranges into the final bucket file.
+    struct Part
+    {
+        std::string mFilename;
+        size_t mObjects{0};
+        size_t mBytes{0};
+        std::unique_ptr<BucketIndex> mIndex;
+    };
+
+    // Finish the output as a Part rather than a bucket. The caller takes
+    // ownership of the file, if any was written.
+    Part
+    finishPart()
+    {
+        Part part;
+        if (finish())
+        {
+            part.mFilename = mFilename;
+            part.mObjects = mObjectsPut;
+            part.mBytes = mBytesPut;
+            part.mIndex = std::move(mIndex);
+        }
+        return part;
+    }
 };
 
+std::shared_ptr<BucketIndex const>
+Bucket::getIndex() const
+{
+    if (mFilename.empty())
+    {
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(mIndexMutex);
+    if (!mIndex)
+    {
+        std::shared_ptr<BucketIndex> index =
+            BucketIndex::load(indexFilename(mFilename));
+        if (!index)
+        {
+            // Buckets downloaded from history, or written before indexes
+            // existed, have no index file; rebuild the index in memory.
+            CLOG(DEBUG, "Bucket") << "Rebuilding index of bucket " << mFilename;
+            index = std::make_shared<BucketIndex>();
+            XDRInputFileStream in;
+            in.open(mFilename);
+            BucketEntry e;
+            uint64_t pos = in.pos();
+            while (in.readOne(e))
+            {
+                index->addEntry(getBucketEntryKey(e), pos);
+                pos = in.pos();
+            }
+        }
+        mIndex = index;
+    }
+    return mIndex;
+}
+
 bool
-Bucket::containsBucketIdentity(BucketEntry const& id) const
+Bucket::getBucketEntry(LedgerKey const& key, BucketEntry& out) const
 {
-    BucketEntryIdCmp cmp;
-    Bucket::InputIterator iter(shared_from_this());
-    while (iter)
+    auto index = getIndex();
+    if (!index)
+    {
+        return false;
+    }
+    auto page = index->findPage(key);
+    if (!page)
     {
-        if (!(cmp(*iter, id) || cmp(id, *iter)))
+        return false;
+    }
+
+    XDRInputFileStream in;
+    in.open(mFilename);
+    in.seek(page->mOffset);
+    LedgerEntryIdCmp cmp;
+    for (size_t i = 0; i < index->getPageSize() && in.readOne(out); ++i)
+    {
+        bool less, greater;
+        if (out.type() == LIVEENTRY)
         {
-            return true;
+            less = cmp(out.liveEntry(), key);
+            greater = cmp(key, out.liveEntry());
+        }
+        else
+        {
+            less = cmp(out.deadEntry(), key);
+            greater = cmp(key, out.deadEntry());
+        }
+        if (!less)
+        {
+            // Entries are sorted: we have either found `key` or passed it.
+            return !greater;
         }
-        ++iter;
     }
     return false;
 }
 
+bool
+Bucket::containsBucketIdentity(BucketEntry const& id) const
+{
+    BucketEntry e;
+    return getBucketEntry(getBucketEntryKey(id), e);
+}
+
 std::pair<size_t, size_t>
 Bucket::countLiveAndDeadEntries() const
 {
@@ -323,8 +543,9 @@ Bucket::fresh(BucketManager& bucketManager,
 
     std::sort(dead.begin(), dead.end(), BucketEntryIdCmp());
 
-    OutputIterator liveOut(bucketManager.getTmpDir(), true);
-    OutputIterator deadOut(bucketManager.getTmpDir(), true);
+    bool compressed = bucketManager.getCompressBuckets();
+    OutputIterator liveOut(bucketManager.getTmpDir(), true, compressed);
+    OutputIterator deadOut(bucketManager.getTmpDir(), true, compressed);
     for (auto const& e : live)
     {
         liveOut.put(e);
@@ -342,10 +563,31 @@ Bucket::fresh(BucketManager& bucketManager,
 inline void
 maybe_put(BucketEntryIdCmp const& cmp, Bucket::OutputIterator& out,
           Bucket::InputIterator& in,
-          std::vector<Bucket::InputIterator>& shadowIterators)
+          std::vector<Bucket::InputIterator>& shadowIterators,
+          size_t& shadowReads, size_t& shadowReadsAvoided)
 {
+    LedgerKey key;
+    if (!shadowIterators.empty())
+    {
+        key = getBucketEntryKey(*in);
+    }
     for (auto& si : shadowIterators)
     {
+        if (!si)
+        {
+            continue;
+        }
+
+        // Skip shadows whose key range or bloom filter rule out the candidate
+        // without reading them. A skipped shadow falls behind; it catches up,
+        // by seeking if it is far behind, on the next candidate it may hold.
+        if (!si.skipTowards(key))
+        {
+            ++shadowReadsAvoided;
+            continue;
+        }
+        ++shadowReads;
+
         // Advance the shadowIterator while it's less than the candidate
         while (si && cmp(*si, *in))
         {
@@ -369,176 +611,525 @@ maybe_put(BucketEntryIdCmp const& cmp, Bucket::OutputIterator& out,
     out.put(*in);
 }
 
-std::shared_ptr<Bucket>
-Bucket::merge(BucketManager& bucketManager,
-              std::shared_ptr<Bucket> const& oldBucket,
-              std::shared_ptr<Bucket> const& newBucket,
-              std::vector<std::shared_ptr<Bucket>> const& shadows,
-              bool keepDeadEntries)
+// Merge the entries of `oldBucket` and `newBucket` with keys in [*begin,
+// *end) into `out`. Null bounds are unbounded.
+static void
+mergeRange(BucketManager& bucketManager, Bucket::OutputIterator& out,
+           std::shared_ptr<Bucket> const& oldBucket,
+           std::shared_ptr<Bucket> const& newBucket,
+           std::vector<std::shared_ptr<Bucket>> const& shadows,
+           LedgerKey const* begin, LedgerKey const* end)
 {
-    // This is the key operation in the scheme: merging two (read-only)
-    // buckets together into a new 3rd bucket, while calculating its hash,
-    // in a single pass.
+    size_t blockSize = bucketManager.getReadBlockSize();
+    bool useMmap = bucketManager.getReadUseMmap();
+    Bucket::InputIterator oi(oldBucket, blockSize, useMmap);
+    Bucket::InputIterator ni(newBucket, blockSize, useMmap);
+    oi.setRange(begin, end);
+    ni.setRange(begin, end);
 
-    assert(oldBucket);
-    assert(newBucket);
-
-    Bucket::InputIterator oi(oldBucket);
-    Bucket::InputIterator ni(newBucket);
-
-    std::vector<Bucket::InputIterator> shadowIterators(shadows.begin(),
-                                                       shadows.end());
-
-    auto timer = bucketManager.getMergeTimer().TimeScope();
-    Bucket::OutputIterator out(bucketManager.getTmpDir(), keepDeadEntries);
+    // Reserve up front: InputIterators point into themselves and must not be
+    // moved by a reallocation once positioned.
+    std::vector<Bucket::InputIterator> shadowIterators;
+    shadowIterators.reserve(shadows.size());
+    for (auto const& s : shadows)
+    {
+        shadowIterators.emplace_back(s, blockSize, useMmap);
+        shadowIterators.back().setRange(begin, nullptr);
+    }
 
     BucketEntryIdCmp cmp;
+    size_t shadowReads = 0, shadowReadsAvoided = 0;
     while (oi || ni)
     {
         if (!ni)
         {
             // Out of new entries, take old entries.
-            maybe_put(cmp, out, oi, shadowIterators);
+            maybe_put(cmp, out, oi, shadowIterators, shadowReads,
+                      shadowReadsAvoided);
             ++oi;
         }
         else if (!oi)
         {
             // Out of old entries, take new entries.
-            maybe_put(cmp, out, ni, shadowIterators);
+            maybe_put(cmp, out, ni, shadowIterators, shadowReads,
+                      shadowReadsAvoided);
             ++ni;
         }
         else if (cmp(*oi, *ni))
         {
             // Next old-entry has smaller key, take it.
-            maybe_put(cmp, out, oi, shadowIterators);
+            maybe_put(cmp, out, oi, shadowIterators, shadowReads,
+                      shadowReadsAvoided);
             ++oi;
         }
         else if (cmp(*ni, *oi))
         {
             // Next new-entry has smaller key, take it.
-            maybe_put(cmp, out, ni, shadowIterators);
+            maybe_put(cmp, out, ni, shadowIterators, shadowReads,
+                      shadowReadsAvoided);
             ++ni;
         }
         else
         {
             // Old and new are for the same key, take new.
-            maybe_put(cmp, out, ni, shadowIterators);
+            maybe_put(cmp, out, ni, shadowIterators, shadowReads,
+                      shadowReadsAvoided);
             ++oi;
             ++ni;
         }
     }
-    return out.getBucket(bucketManager);
+
+    if (!shadows.empty())
+    {
+        CLOG(DEBUG, "Bucket") << "Merge shadow lookups: " << shadowReads
+                              << " read, " << shadowReadsAvoided
+                              << " avoided";
+        bucketManager.getShadowReadsMeter().Mark(shadowReads);
+        bucketManager.getShadowReadsAvoidedMeter().Mark(shadowReadsAvoided);
+    }
 }
 
-static void
-compareSizes(std::string const& objType, uint64_t inDatabase,
-             uint64_t inBucketlist)
+static uint64_t
+bucketFileSize(std::shared_ptr<Bucket> const& b)
 {
-    if (inDatabase != inBucketlist)
+    if (b->getFilename().empty())
     {
-        throw std::runtime_error(fmt::format(
-            "{} object count mismatch: DB has {}, BucketList has {}", objType,
-            inDatabase, inBucketlist));
+        return 0;
     }
+    std::ifstream in(b->getFilename(),
+                     std::ifstream::ate | std::ifstream::binary);
+    return static_cast<uint64_t>(in.tellg());
 }
 
-// FIXME issue NNN: this should be refactored to run in a read-transaction on a
-// background thread and take a soci::session& rather than Database&. For now we
-// code it to run on main thread because there's a bunch of code to move around
-// in the ledger frames and db layer to make that work.
+// Pick up to `partitions - 1` keys cutting the combined keyspace of the two
+// buckets into ranges of roughly equal entry counts. Index pages hold a fixed
+// number of entries, so their first keys are an evenly spaced sample.
+static std::vector<LedgerKey>
+chooseSplitKeys(std::shared_ptr<Bucket> const& oldBucket,
+                std::shared_ptr<Bucket> const& newBucket, size_t partitions)
+{
+    LedgerEntryIdCmp cmp;
+    std::vector<LedgerKey> samples;
+    for (auto const& b : {oldBucket, newBucket})
+    {
+        auto index = b->getIndex();
+        if (index)
+        {
+            for (auto const& p : index->getPages())
+            {
+                samples.push_back(p.mFirstKey);
+            }
+        }
+    }
+    std::sort(samples.begin(), samples.end(), cmp);
 
-void
-checkDBAgainstBuckets(medida::MetricsRegistry& metrics,
-                      BucketManager& bucketManager, Database& db,
-                      BucketList& bl)
+    std::vector<LedgerKey> splits;
+    for (size_t i = 1; i < partitions && !samples.empty(); ++i)
+    {
+        // Skip keys that would leave an empty range.
+        auto const& k = samples[i * samples.size() / partitions];
+        if (cmp(samples.front(), k) &&
+            (splits.empty() || cmp(splits.back(), k)))
+        {
+            splits.push_back(k);
+        }
+    }
+    return splits;
+}
+
+// Merge the key ranges between `splits` on separate threads, then concatenate
+// the ranges in order, hashing as we go. Since every range holds exactly the
+// entries the serial merge would have written for it, the result is
+// byte-for-byte the bucket the serial merge produces.
+static std::shared_ptr<Bucket>
+mergePartitioned(BucketManager& bucketManager,
+                 std::shared_ptr<Bucket> const& oldBucket,
+                 std::shared_ptr<Bucket> const& newBucket,
+                 std::vector<std::shared_ptr<Bucket>> const& shadows,
+                 bool keepDeadEntries, std::vector<LedgerKey> const& splits)
 {
-    CLOG(INFO, "Bucket") << "CheckDB starting";
-    auto execTimer =
-        metrics.NewTimer({"bucket", "checkdb", "execute"}).TimeScope();
+    auto mergePart = [&](size_t i) {
+        LedgerKey const* begin = (i == 0) ? nullptr : &splits[i - 1];
+        LedgerKey const* end = (i == splits.size()) ? nullptr : &splits[i];
+        Bucket::OutputIterator out(bucketManager.getTmpDir(), keepDeadEntries,
+                                   false, false);
+        mergeRange(bucketManager, out, oldBucket, newBucket, shadows, begin,
+                   end);
+        return out.finishPart();
+    };
 
-    // Step 1: Collect all buckets to merge.
-    std::vector<std::shared_ptr<Bucket>> buckets;
+    std::vector<std::future<Bucket::OutputIterator::Part>> futures;
+    for (size_t i = 1; i <= splits.size(); ++i)
+    {
+        futures.emplace_back(std::async(std::launch::async, mergePart, i));
+    }
+    std::vector<Bucket::OutputIterator::Part> parts;
+    parts.emplace_back(mergePart(0));
+    for (auto& f : futures)
+    {
+        parts.emplace_back(f.get());
+    }
+
+    std::string filename = randomBucketName(bucketManager.getTmpDir());
+    std::ofstream out(filename, std::ofstream::binary | std::ofstream::trunc);
+    std::unique_ptr<BlockCompressor> compressor;
+    if (bucketManager.getCompressBuckets())
+    {
+        compressor = make_unique<BlockCompressor>(out);
+    }
+    auto hasher = SHA256::create();
+    auto index = make_unique<BucketIndex>();
+    std::vector<char> buf(bucketManager.getReadBlockSize());
+    size_t objects = 0, bytes = 0;
+    for (auto const& part : parts)
+    {
+        if (part.mObjects == 0)
+        {
+            continue;
+        }
+        std::ifstream in(part.mFilename, std::ifstream::binary);
+        while (in)
+        {
+            in.read(buf.data(), buf.size());
+            auto n = static_cast<size_t>(in.gcount());
+            hasher->add(ByteSlice(buf.data(), n));
+            if (compressor)
+            {
+                compressor->write(buf.data(), n);
+            }
+            else
+            {
+                out.write(buf.data(), n);
+            }
+        }
+        in.close();
+        std::remove(part.mFilename.c_str());
+        index->append(*part.mIndex, bytes);
+        objects += part.mObjects;
+        bytes += part.mBytes;
+    }
+    if (compressor)
+    {
+        compressor->flush();
+    }
+    out.close();
+    if (!out)
+    {
+        std::remove(filename.c_str());
+        throw std::runtime_error("failed writing bucket file " + filename);
+    }
+
+    if (objects == 0)
+    {
+        CLOG(DEBUG, "Bucket") << "Deleting empty bucket file " << filename;
+        std::remove(filename.c_str());
+        return std::make_shared<Bucket>();
+    }
+    index->save(Bucket::indexFilename(filename));
+    return bucketManager.adoptFileAsBucket(filename, hasher->finish(), objects,
+                                           bytes);
+}
+
+std::shared_ptr<Bucket>
+Bucket::merge(BucketManager& bucketManager,
+              std::shared_ptr<Bucket> const& oldBucket,
+              std::shared_ptr<Bucket> const& newBucket,
+              std::vector<std::shared_ptr<Bucket>> const& shadows,
+              bool keepDeadEntries)
+{
+    // This is the key operation in the scheme: merging two (read-only)
+    // buckets together into a new 3rd bucket, while calculating its hash,
+    // in a single pass.
+
+    assert(oldBucket);
+    assert(newBucket);
+
+    auto timer = bucketManager.getMergeTimer().TimeScope();
+
+    // Very large merges may instead be cut into key ranges merged in
+    // parallel; see mergePartitioned.
+    size_t partitions = bucketManager.getMergePartitions(
+        bucketFileSize(oldBucket) + bucketFileSize(newBucket));
+    if (partitions > 1)
+    {
+        auto splits = chooseSplitKeys(oldBucket, newBucket, partitions);
+        if (!splits.empty())
+        {
+            CLOG(DEBUG, "Bucket") << "Merging in " << splits.size() + 1
+                                  << " partitions";
+            return mergePartitioned(bucketManager, oldBucket, newBucket,
+                                    shadows, keepDeadEntries, splits);
+        }
+    }
+
+    Bucket::OutputIterator out(bucketManager.getTmpDir(), keepDeadEntries,
+                               bucketManager.getCompressBuckets());
+    mergeRange(bucketManager, out, oldBucket, newBucket, shadows, nullptr,
+               nullptr);
+    return out.getBucket(bucketManager);
+}
+
+BucketDBChecker::BucketDBChecker(Application& app)
+    : mApp(app)
+    , mExecTimer(app.getMetrics().NewTimer({"bucket", "checkdb", "execute"}))
+    , mCompareMeter(app.getMetrics().NewMeter(
+          {"bucket", "checkdb", "object-compare"}, "comparison"))
+    , mCompared(app.getMetrics().NewCounter({"bucket", "checkdb", "compared"}))
+    , mMismatches(
+          app.getMetrics().NewCounter({"bucket", "checkdb", "mismatches"}))
+    , mRunning(app.getMetrics().NewCounter({"bucket", "checkdb", "running"}))
+{
+    // Buckets are collected newest first: for equal keys, the first bucket
+    // holding the key has the current entry.
+    auto& bl = app.getBucketManager().getBucketList();
     for (size_t i = 0; i < BucketList::kNumLevels; ++i)
     {
-        CLOG(INFO, "Bucket") << "CheckDB collecting buckets from level " << i;
         auto& level = bl.getLevel(i);
         auto& next = level.getNext();
         if (next.isLive())
         {
-            CLOG(INFO, "Bucket") << "CheckDB resolving future bucket on level "
-                                 << i;
-            buckets.push_back(next.resolve());
+            if (next.isMerging() && !next.mergeComplete())
+            {
+                // resolved by `run`, on a copy sharing the merge's output
+                mMerging.emplace_back(mBuckets.size(), next);
+                mBuckets.emplace_back();
+            }
+            else
+            {
+                mBuckets.push_back(next.resolve());
+            }
         }
-        buckets.push_back(level.getCurr());
-        buckets.push_back(level.getSnap());
+        mBuckets.push_back(level.getCurr());
+        mBuckets.push_back(level.getSnap());
     }
 
-    if (buckets.empty())
+    auto& db = app.getDatabase();
+    if (db.canUsePool())
     {
-        CLOG(INFO, "Bucket") << "CheckDB found no buckets, returning";
-        return;
+        mSession = make_unique<soci::session>(db.getPool());
+        mTx = make_unique<soci::transaction>(*mSession);
+        if (!db.isSqlite())
+        {
+            *mSession << "SET TRANSACTION READ ONLY";
+        }
+        // Both PostgreSQL and SQLite take the snapshot a transaction reads
+        // from at its first read: do one now, while the database and the
+        // buckets collected above are at the same ledger.
+        int n = 0;
+        *mSession << "SELECT COUNT(*) FROM storestate", soci::into(n);
+    }
+
+    mCompared.set_count(0);
+    mMismatches.set_count(0);
+    mRunning.inc();
+}
+
+BucketDBChecker::~BucketDBChecker()
+{
+    mRunning.dec();
+}
+
+bool
+BucketDBChecker::canRunInBackground() const
+{
+    return mSession != nullptr;
+}
+
+soci::session&
+BucketDBChecker::getSession()
+{
+    return mSession ? *mSession : mApp.getDatabase().getSession();
+}
+
+void
+BucketDBChecker::resolveMerges()
+{
+    for (auto& m : mMerging)
+    {
+        CLOG(INFO, "Bucket") << "CheckDB waiting for a running merge";
+        mBuckets[m.first] = m.second.resolve();
+    }
+    mMerging.clear();
+}
+
+void
+BucketDBChecker::reportMismatch(std::string const& what)
+{
+    CLOG(ERROR, "Bucket") << "CheckDB mismatch: " << what;
+    mMismatches.inc();
+}
+
+void
+BucketDBChecker::compareBatch(LedgerEntryType type,
+                              std::vector<LedgerEntry> const& entries)
+{
+    using xdr::operator==;
+    std::map<LedgerKey, LedgerEntry const*, LedgerEntryIdCmp> expected;
+    std::vector<LedgerKey> keys;
+    keys.reserve(entries.size());
+    for (auto const& e : entries)
+    {
+        keys.emplace_back(LedgerEntryKey(e));
+        expected.emplace(keys.back(), &e);
+    }
+
+    auto check = [&](LedgerEntry const& fromDb) {
+        auto i = expected.find(LedgerEntryKey(fromDb));
+        if (i == expected.end())
+        {
+            // TrustFrame::loadEntries and DataFrame::loadEntries select by
+            // account only, so they also return the other trust lines and
+            // data entries of the accounts in the batch; those are checked
+            // with the batch holding them.
+            return;
+        }
+        if (!(fromDb == *i->second))
+        {
+            reportMismatch(xdr::xdr_to_string(fromDb, "db") +
+                           xdr::xdr_to_string(*i->second, "bucketlist"));
+        }
+        expected.erase(i);
+    };
+
+    auto& sess = getSession();
+    switch (type)
+    {
+    case ACCOUNT:
+        AccountFrame::loadEntries(sess, keys, check);
+        break;
+    case TRUSTLINE:
+        TrustFrame::loadEntries(sess, keys, check);
+        break;
+    case OFFER:
+        OfferFrame::loadEntries(sess, keys, check);
+        break;
+    case DATA:
+        DataFrame::loadEntries(sess, keys, check);
+        break;
+    }
+
+    for (auto const& kv : expected)
+    {
+        reportMismatch("missing from db: " +
+                       xdr::xdr_to_string(*kv.second, "bucketlist"));
     }
 
-    // Step 2: merge all buckets into a single super-bucket.
-    auto i = buckets.begin();
-    assert(i != buckets.end());
-    std::shared_ptr<Bucket> superBucket = *i;
-    while (++i != buckets.end())
+    mCompareMeter.Mark(entries.size());
+    mCompared.inc(entries.size());
+    if ((mCompared.count() & 0xffff) < entries.size())
     {
-        auto mergeTimer =
-            metrics.NewTimer({"bucket", "checkdb", "merge"}).TimeScope();
-        assert(superBucket);
-        assert(*i);
-        superBucket = Bucket::merge(bucketManager, *i, superBucket);
-        assert(superBucket);
+        CLOG(INFO, "Bucket") << "CheckDB compared " << mCompared.count()
+                             << " objects";
     }
+}
+
+void
+BucketDBChecker::compareCount(std::string const& objType, uint64_t inDatabase,
+                              uint64_t inBucketList)
+{
+    if (inDatabase != inBucketList)
+    {
+        reportMismatch(fmt::format(
+            "{} object count mismatch: DB has {}, BucketList has {}", objType,
+            inDatabase, inBucketList));
+    }
+}
 
-    CLOG(INFO, "Bucket") << "CheckDB starting object comparison";
+void
+BucketDBChecker::compare()
+{
+    auto& bm = mApp.getBucketManager();
+    std::vector<std::unique_ptr<Bucket::InputIterator>> iters;
+    for (auto const& b : mBuckets)
+    {
+        iters.emplace_back(make_unique<Bucket::InputIterator>(
+            b, bm.getReadBlockSize(), bm.getReadUseMmap()));
+    }
 
-    // Step 3: scan the superbucket, checking each object against the DB and
-    // counting objects along the way.
-    uint64_t nAccounts = 0, nTrustLines = 0, nOffers = 0, nData = 0;
+    BucketEntryIdCmp cmp;
+    std::map<LedgerEntryType, std::vector<LedgerEntry>> batches;
+    std::map<LedgerEntryType, uint64_t> counts;
+    while (!mApp.isStopping())
     {
-        auto& meter = metrics.NewMeter({"bucket", "checkdb", "object-compare"},
-                                       "comparison");
-        auto compareTimer =
-            metrics.NewTimer({"bucket", "checkdb", "compare"}).TimeScope();
-        for (Bucket::InputIterator iter(superBucket); iter; ++iter)
+        Bucket::InputIterator* newest = nullptr;
+        for (auto& i : iters)
         {
-            meter.Mark();
-            auto& e = *iter;
-            if (e.type() == LIVEENTRY)
+            if (*i && (!newest || cmp(**i, **newest)))
             {
-                switch (e.liveEntry().data.type())
-                {
-                case ACCOUNT:
-                    ++nAccounts;
-                    break;
-                case TRUSTLINE:
-                    ++nTrustLines;
-                    break;
-                case OFFER:
-                    ++nOffers;
-                    break;
-                case DATA:
-                    ++nData;
-                    break;
-                }
-                EntryFrame::checkAgainstDatabase(e.liveEntry(), db);
-                if (meter.count() % 100 == 0)
-                {
-                    CLOG(INFO, "Bucket") << "CheckDB compared " << meter.count()
-                                         << " objects";
-                }
+                newest = i.get();
             }
         }
+        if (!newest)
+        {
+            break;
+        }
+
+        BucketEntry e = **newest;
+        for (auto& i : iters)
+        {
+            if (*i && !cmp(e, **i) && !cmp(**i, e))
+            {
+                ++(*i);
+            }
+        }
+        if (e.type() != LIVEENTRY)
+        {
+            continue;
+        }
+
+        auto type = e.liveEntry().data.type();
+        ++counts[type];
+        auto& batch = batches[type];
+        batch.emplace_back(e.liveEntry());
+        if (batch.size() == kBatchSize)
+        {
+            compareBatch(type, batch);
+            batch.clear();
+        }
+    }
+    if (mApp.isStopping())
+    {
+        CLOG(INFO, "Bucket") << "CheckDB interrupted by shutdown";
+        return;
     }
 
-    // Step 4: confirm size of datasets matches size of datasets in DB.
-    soci::session& sess = db.getSession();
-    compareSizes("account", AccountFrame::countObjects(sess), nAccounts);
-    compareSizes("trustline", TrustFrame::countObjects(sess), nTrustLines);
-    compareSizes("offer", OfferFrame::countObjects(sess), nOffers);
-    compareSizes("data", DataFrame::countObjects(sess), nData);
+    for (auto const& kv : batches)
+    {
+        if (!kv.second.empty())
+        {
+            compareBatch(kv.first, kv.second);
+        }
+    }
+
+    auto& sess = getSession();
+    compareCount("account", AccountFrame::countObjects(sess), counts[ACCOUNT]);
+    compareCount("trustline", TrustFrame::countObjects(sess),
+                 counts[TRUSTLINE]);
+    compareCount("offer", OfferFrame::countObjects(sess), counts[OFFER]);
+    compareCount("data", DataFrame::countObjects(sess), counts[DATA]);
+}
+
+uint64_t
+BucketDBChecker::run()
+{
+    CLOG(INFO, "Bucket") << "CheckDB starting, "
+                         << (canRunInBackground() ? "in the background"
+                                                  : "on the main thread");
+    {
+        auto execTimer = mExecTimer.TimeScope();
+        try
+        {
+            resolveMerges();
+            compare();
+        }
+        catch (std::exception& e)
+        {
+            CLOG(ERROR, "Bucket") << "CheckDB failed: " << e.what();
+        }
+    }
+    auto mismatches = mMismatches.count();
+    CLOG(INFO, "Bucket") << "CheckDB done: compared " << mCompared.count()
+                         << " objects, found " << mismatches << " mismatches";
+    return mismatches;
 }
 }
@@ -4,13 +4,25 @@
 // under the Apache License, Version 2.0. See the COPYING file at the root
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
+#include "bucket/FutureBucket.h"
 #include "overlay/StellarXDR.h"
 #include "util/NonCopyable.h"
+#include <memory>
+#include <mutex>
 #include <string>
 
 namespace medida
 {
+class Counter;
+class Meter;
 class MetricsRegistry;
+class Timer;
+}
+
+namespace soci
+{
+class session;
+class transaction;
 }
 
 namespace stellar
@@ -27,6 +39,8 @@ namespace stellar
  * merged in sorted order, and all elements are hashed while being added.
  */
 
+class Application;
+class BucketIndex;
 class BucketManager;
 class BucketList;
 class Database;
@@ -39,6 +53,10 @@ class Bucket : public std::enable_shared_from_this<Bucket>,
     Hash const mHash;
     bool mRetain{false};
 
+    // Sparse key index, loaded (or rebuilt) on first use by `getIndex`.
+    mutable std::mutex mIndexMutex;
+    mutable std::shared_ptr<BucketIndex const> mIndex;
+
   public:
     // Helper class that reads through the entries in a bucket, used internally
     // during merging.
@@ -72,6 +90,20 @@ class Bucket : public std::enable_shared_from_this<Bucket>,
     // be retained.
     void setRetain(bool r);
 
+    // Name of the file holding the BucketIndex of the bucket in
+    // `bucketFilename`.
+    static std::string indexFilename(std::string const& bucketFilename);
+
+    // Return the sparse key index of the bucket, loading it from its index
+    // file or, if that is missing, rebuilding it by scanning the bucket.
+    // Returns nullptr for the empty bucket.
+    std::shared_ptr<BucketIndex const> getIndex() const;
+
+    // Look up the entry for `key` using the bucket's index, reading at most
+    // one index page from disk. Returns true and sets `out` if the bucket
+    // holds an entry (live or dead) for `key`.
+    bool getBucketEntry(LedgerKey const& key, BucketEntry& out) const;
+
     // Returns true if a BucketEntry that is key-wise identical to the given
     // BucketEntry exists in the bucket. For testing.
     bool containsBucketIdentity(BucketEntry const& id) const;
@@ -107,7 +139,62 @@ class Bucket : public std::enable_shared_from_this<Bucket>,
           bool keepDeadEntries = true);
 };
 
-void checkDBAgainstBuckets(medida::MetricsRegistry& metrics,
-                           BucketManager& bucketManager, Database& db,
-                           BucketList& bl);
+/**
+ * BucketDBChecker checks that the ledger entries stored in the database are
+ * exactly the live entries of the bucket list.
+ *
+ * Construction, which must happen on the main thread, captures the buckets of
+ * the bucket list. Merges still running are not waited for there, but at the
+ * start of `run`, so that they don't hold up the main thread. When the
+ * database can hand out extra connections, it also opens a read-only snapshot
+ * transaction on a connection of its own, pinned to the same ledger as those
+ * buckets. `run` can then proceed on a worker thread while the node keeps
+ * closing ledgers. Otherwise `run` reads through the main connection and must
+ * be called on the main thread.
+ *
+ * `run` streams a k-way merge of the buckets, where the newest entry for a
+ * key wins, without writing out any merged bucket. It checks the live entries
+ * against the database with one SELECT per batch of kBatchSize entries of a
+ * type, then checks the number of rows of each type. Progress and mismatches
+ * are reported through the "bucket.checkdb" metrics, and mismatches are
+ * logged.
+ */
+class BucketDBChecker : public NonMovableOrCopyable
+{
+    Application& mApp;
+    std::vector<std::shared_ptr<Bucket>> mBuckets;
+    // Merges that were running at construction, with the index in mBuckets
+    // of the bucket they produce.
+    std::vector<std::pair<size_t, FutureBucket>> mMerging;
+    std::unique_ptr<soci::session> mSession;
+    std::unique_ptr<soci::transaction> mTx;
+
+    medida::Timer& mExecTimer;
+    medida::Meter& mCompareMeter;
+    medida::Counter& mCompared;
+    medida::Counter& mMismatches;
+    medida::Counter& mRunning;
+
+    soci::session& getSession();
+    void resolveMerges();
+    void reportMismatch(std::string const& what);
+    void compareBatch(LedgerEntryType type,
+                      std::vector<LedgerEntry> const& entries);
+    void compareCount(std::string const& objType, uint64_t inDatabase,
+                      uint64_t inBucketList);
+    void compare();
+
+  public:
+    // Entries per SELECT; SQLite accepts at most 999 parameters by default.
+    static const size_t kBatchSize = 500;
+
+    explicit BucketDBChecker(Application& app);
+    ~BucketDBChecker();
+
+    // Whether `run` may be called on a worker thread.
+    bool canRunInBackground() const;
+
+    // Run the check, returning the number of mismatches found.
+    uint64_t run();
+};
 }
@@ -5,59 +5,172 @@
 #include "util/asio.h"
 #include "bucket/Bucket.h"
 #include "bucket/BucketApplicator.h"
-#include "ledger/LedgerDelta.h"
+#include "ledger/AccountFrame.h"
+#include "ledger/DataFrame.h"
+#include "ledger/OfferFrame.h"
+#include "ledger/TrustFrame.h"
 #include "util/Logging.h"
 
 namespace stellar
 {
 
 BucketApplicator::BucketApplicator(Database& db,
-                                   std::shared_ptr<const Bucket> bucket)
-    : mDb(db), mBucket(bucket)
+                                   std::shared_ptr<const Bucket> bucket,
+                                   size_t blockSize, bool useMmap)
+    : mDb(db)
+    , mBucket(bucket)
+    , mIn(0, blockSize, useMmap)
+    , mStart(std::chrono::steady_clock::now())
 {
     if (!bucket->getFilename().empty())
     {
         mIn.open(bucket->getFilename());
     }
+    if (mIn)
+    {
+        mReader = std::thread([this]() { readBatches(); });
+    }
+    else
+    {
+        mReadDone = true;
+    }
+}
+
+BucketApplicator::~BucketApplicator()
+{
+    if (mReader.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mStopping = true;
+        }
+        mCond.notify_all();
+        mReader.join();
+    }
 }
 
 BucketApplicator::operator bool() const
 {
-    return (bool)mIn;
+    std::lock_guard<std::mutex> lock(mMutex);
+    return !mReady.empty() || !mReadDone || mReadError;
+}
+
+void
+BucketApplicator::readBatches()
+{
+    try
+    {
+        BucketEntry entry;
+        bool eof = false;
+        while (!eof)
+        {
+            Batch batch;
+            while (batch.mCount < kBulkBatchSize)
+            {
+                if (!mIn.readOne(entry))
+                {
+                    eof = true;
+                    break;
+                }
+                if (entry.type() == LIVEENTRY)
+                {
+                    auto type = entry.liveEntry().data.type();
+                    batch.mKeys[type].emplace_back(
+                        LedgerEntryKey(entry.liveEntry()));
+                    batch.mLive[type].emplace_back(entry.liveEntry());
+                }
+                else
+                {
+                    batch.mKeys[entry.deadEntry().type()].emplace_back(
+                        entry.deadEntry());
+                }
+                ++batch.mCount;
+            }
+
+            std::unique_lock<std::mutex> lock(mMutex);
+            mCond.wait(lock, [this]() {
+                return mStopping || mReady.size() < kPipelineDepth;
+            });
+            if (mStopping)
+            {
+                return;
+            }
+            if (batch.mCount != 0)
+            {
+                mReady.emplace_back(std::move(batch));
+            }
+            mReadDone = eof;
+            mCond.notify_all();
+        }
+    }
+    catch (...)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mReadError = std::current_exception();
+        mReadDone = true;
+        mCond.notify_all();
+    }
 }
 
 void
 BucketApplicator::advance()
 {
-    soci::transaction sqlTx(mDb.getSession());
-    BucketEntry entry;
-    while (mIn && mIn.readOne(entry))
+    Batch batch;
     {
-        LedgerHeader lh;
-        LedgerDelta delta(lh, mDb, false);
-        if (entry.type() == LIVEENTRY)
+        std::unique_lock<std::mutex> lock(mMutex);
+        mCond.wait(lock, [this]() { return !mReady.empty() || mReadDone; });
+        if (mReadError)
         {
-            EntryFrame::pointer ep = EntryFrame::FromXDR(entry.liveEntry());
-            ep->storeAddOrChange(delta, mDb);
+            std::rethrow_exception(mReadError);
         }
-        else
+        if (mReady.empty())
         {
-            EntryFrame::storeDelete(delta, mDb, entry.deadEntry());
+            return;
         }
-        // No-op, just to avoid needless rollback.
-        delta.commit();
-        if ((++mSize & 0xff) == 0xff)
+        batch = std::move(mReady.front());
+        mReady.pop_front();
+    }
+    mCond.notify_all();
+
+    static std::vector<LedgerEntry> const noLive;
+    soci::transaction sqlTx(mDb.getSession());
+    for (auto const& kv : batch.mKeys)
+    {
+        auto const& keys = kv.second;
+        auto i = batch.mLive.find(kv.first);
+        auto const& live = (i == batch.mLive.end()) ? noLive : i->second;
+        switch (kv.first)
         {
+        case ACCOUNT:
+            AccountFrame::storeDeleteBulk(mDb, keys);
+            AccountFrame::storeAddBulk(mDb, live);
+            break;
+        case TRUSTLINE:
+            TrustFrame::storeDeleteBulk(mDb, keys);
+            TrustFrame::storeAddBulk(mDb, live);
+            break;
+        case OFFER:
+            OfferFrame::storeDeleteBulk(mDb, keys);
+            OfferFrame::storeAddBulk(mDb, live);
+            break;
+        case DATA:
+            DataFrame::storeDeleteBulk(mDb, keys);
+            DataFrame::storeAddBulk(mDb, live);
             break;
         }
     }
     sqlTx.commit();
-    mDb.clearPreparedStatementCache();
+    mSize += batch.mCount;
 
-    if (!mIn || (mSize & 0xfff) == 0xfff)
+    if (!*this || mSize - mLoggedSize >= 0x1000)
     {
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - mStart;
+        double rate = elapsed.count() > 0 ? mSize / elapsed.count() : 0;
         CLOG(INFO, "Bucket") << "Bucket-apply: committed " << mSize
-                             << " entries";
+                             << " entries (" << static_cast<uint64_t>(rate)
+                             << " entries/s)";
+        mLoggedSize = mSize;
     }
 }
 }
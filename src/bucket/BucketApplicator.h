@@ -7,7 +7,14 @@
 #include "bucket/Bucket.h"
 #include "database/Database.h"
 #include "util/XDRStream.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <thread>
 
 namespace stellar
 {
@@ -17,16 +24,53 @@ class Database;
 // Class that represents a single apply-bucket-to-database operation in
 // progress. Used during history catchup to split up the task of applying
 // bucket into scheduler-friendly, bite-sized pieces.
+//
+// Entries are applied in bulk: each step takes a batch of entries, grouped by
+// type, and for each type deletes the rows of every entry in the batch and
+// re-inserts the live ones, one prepared statement per table. Batches are read
+// and decoded from the bucket file by a dedicated reader thread, which stays
+// at most kPipelineDepth batches ahead of the (main) thread writing them to
+// the database.
 
 class BucketApplicator
 {
+    struct Batch
+    {
+        size_t mCount{0};
+        // Keys of all the entries of each type, and the live entries.
+        std::map<LedgerEntryType, std::vector<LedgerKey>> mKeys;
+        std::map<LedgerEntryType, std::vector<LedgerEntry>> mLive;
+    };
+
     Database& mDb;
     std::shared_ptr<const Bucket> mBucket;
     XDRInputFileStream mIn;
     size_t mSize{0};
+    size_t mLoggedSize{0};
+    std::chrono::steady_clock::time_point const mStart;
+
+    // Shared with the reader thread, under mMutex.
+    mutable std::mutex mMutex;
+    std::condition_variable mCond;
+    std::deque<Batch> mReady;
+    bool mReadDone{false};
+    bool mStopping{false};
+    std::exception_ptr mReadError;
+    std::thread mReader;
+
+    void readBatches();
 
   public:
-    BucketApplicator(Database& db, std::shared_ptr<const Bucket> bucket);
+    // Number of entries applied per step.
+    static const size_t kBulkBatchSize = 1024;
+    // Number of decoded batches the reader thread may queue up.
+    static const size_t kPipelineDepth = 4;
+
+    BucketApplicator(
+        Database& db, std::shared_ptr<const Bucket> bucket,
+        size_t blockSize = XDRInputFileStream::kDefaultBlockSize,
+        bool useMmap = false);
+    ~BucketApplicator();
     operator bool() const;
     void advance();
 };
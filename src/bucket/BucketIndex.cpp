@@ -0,0 +1,265 @@
+// Copyright 2017 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "bucket/BucketIndex.h"
+#include "bucket/LedgerCmp.h"
+#include "util/Fs.h"
+#include "util/Logging.h"
+#include "util/make_unique.h"
+#include "xdrpp/marshal.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+
+namespace stellar
+{
+
+static const uint32_t kIndexMagic = 0x53424958; // "SBIX"
+static const uint32_t kIndexVersion = 2;
+static const size_t kBloomBitsPerKey = 10;
+static const size_t kBloomHashes = 7;
+
+// 64-bit FNV-1a over the XDR form of the key. The index never leaves this
+// node, so this only needs to be cheap and stable across restarts.
+static uint64_t
+hashKey(LedgerKey const& key)
+{
+    auto bytes = xdr::xdr_to_opaque(key);
+    uint64_t h = 14695981039346656037ULL;
+    for (auto b : bytes)
+    {
+        h ^= b;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+template <typename F>
+static void
+forEachBloomBit(LedgerKey const& key, size_t nBits, F f)
+{
+    uint64_t h = hashKey(key);
+    uint32_t h1 = static_cast<uint32_t>(h);
+    uint32_t h2 = static_cast<uint32_t>(h >> 32) | 1;
+    for (size_t i = 0; i < kBloomHashes; ++i)
+    {
+        f((h1 + i * h2) % nBits);
+    }
+}
+
+BucketIndex::BucketIndex(size_t pageSize) : mPageSize(pageSize)
+{
+    assert(mPageSize > 0);
+}
+
+size_t
+BucketIndex::bloomBits() const
+{
+    return ((mPageSize * kBloomBitsPerKey + 63) / 64) * 64;
+}
+
+void
+BucketIndex::addEntry(LedgerKey const& key, uint64_t offset)
+{
+    if (mEntries % mPageSize == 0)
+    {
+        Page p;
+        p.mFirstKey = key;
+        p.mOffset = offset;
+        p.mBloom.resize(bloomBits() / 64, 0);
+        mPages.emplace_back(std::move(p));
+    }
+    auto& bloom = mPages.back().mBloom;
+    forEachBloomBit(key, bloomBits(), [&bloom](size_t bit) {
+        bloom[bit / 64] |= (uint64_t(1) << (bit % 64));
+    });
+    mLastKey = key;
+    ++mEntries;
+}
+
+void
+BucketIndex::append(BucketIndex const& other, uint64_t offset)
+{
+    assert(other.mPageSize == mPageSize);
+    for (auto const& p : other.mPages)
+    {
+        mPages.push_back(p);
+        mPages.back().mOffset += offset;
+    }
+    if (!other.mPages.empty())
+    {
+        mLastKey = other.mLastKey;
+    }
+    mEntries += other.mEntries;
+}
+
+BucketIndex::Page const*
+BucketIndex::findPage(LedgerKey const& key) const
+{
+    LedgerEntryIdCmp cmp;
+    if (mPages.empty() || cmp(mLastKey, key))
+    {
+        return nullptr;
+    }
+    auto i = std::upper_bound(
+        mPages.begin(), mPages.end(), key,
+        [&cmp](LedgerKey const& k, Page const& p) {
+            return cmp(k, p.mFirstKey);
+        });
+    if (i == mPages.begin())
+    {
+        return nullptr;
+    }
+    --i;
+    bool maybe = true;
+    auto const& bloom = i->mBloom;
+    forEachBloomBit(key, bloomBits(), [&](size_t bit) {
+        if (!(bloom[bit / 64] & (uint64_t(1) << (bit % 64))))
+        {
+            maybe = false;
+        }
+    });
+    return maybe ? &(*i) : nullptr;
+}
+
+size_t
+BucketIndex::getPageSize() const
+{
+    return mPageSize;
+}
+
+size_t
+BucketIndex::getEntryCount() const
+{
+    return mEntries;
+}
+
+std::vector<BucketIndex::Page> const&
+BucketIndex::getPages() const
+{
+    return mPages;
+}
+
+static void
+putU32(std::ostream& out, uint32_t v)
+{
+    char buf[4] = {static_cast<char>(v >> 24), static_cast<char>(v >> 16),
+                   static_cast<char>(v >> 8), static_cast<char>(v)};
+    out.write(buf, 4);
+}
+
+static void
+putU64(std::ostream& out, uint64_t v)
+{
+    putU32(out, static_cast<uint32_t>(v >> 32));
+    putU32(out, static_cast<uint32_t>(v));
+}
+
+static uint32_t
+getU32(std::istream& in)
+{
+    unsigned char buf[4];
+    if (!in.read(reinterpret_cast<char*>(buf), 4))
+    {
+        throw std::runtime_error("truncated bucket index");
+    }
+    return (uint32_t(buf[0]) << 24) | (uint32_t(buf[1]) << 16) |
+           (uint32_t(buf[2]) << 8) | uint32_t(buf[3]);
+}
+
+static uint64_t
+getU64(std::istream& in)
+{
+    uint64_t hi = getU32(in);
+    return (hi << 32) | getU32(in);
+}
+
+void
+BucketIndex::save(std::string const& filename) const
+{
+    std::ofstream out(filename, std::ofstream::binary | std::ofstream::trunc);
+    putU32(out, kIndexMagic);
+    putU32(out, kIndexVersion);
+    putU32(out, static_cast<uint32_t>(mPageSize));
+    putU64(out, mEntries);
+    putU64(out, mPages.size());
+    auto lastKey = xdr::xdr_to_opaque(mLastKey);
+    putU32(out, static_cast<uint32_t>(lastKey.size()));
+    out.write(reinterpret_cast<char const*>(lastKey.data()), lastKey.size());
+    for (auto const& p : mPages)
+    {
+        auto key = xdr::xdr_to_opaque(p.mFirstKey);
+        putU64(out, p.mOffset);
+        putU32(out, static_cast<uint32_t>(key.size()));
+        out.write(reinterpret_cast<char const*>(key.data()), key.size());
+        for (auto w : p.mBloom)
+        {
+            putU64(out, w);
+        }
+    }
+    if (!out)
+    {
+        CLOG(WARNING, "Bucket") << "Failed to write bucket index " << filename;
+        out.close();
+        std::remove(filename.c_str());
+    }
+}
+
+std::unique_ptr<BucketIndex>
+BucketIndex::load(std::string const& filename)
+{
+    if (!fs::exists(filename))
+    {
+        return nullptr;
+    }
+    try
+    {
+        std::ifstream in(filename, std::ifstream::binary);
+        if (getU32(in) != kIndexMagic || getU32(in) != kIndexVersion)
+        {
+            return nullptr;
+        }
+        uint32_t pageSize = getU32(in);
+        if (pageSize == 0)
+        {
+            return nullptr;
+        }
+        auto index = make_unique<BucketIndex>(pageSize);
+        index->mEntries = getU64(in);
+        uint64_t nPages = getU64(in);
+        std::vector<uint8_t> lastKey(getU32(in));
+        if (!in.read(reinterpret_cast<char*>(lastKey.data()), lastKey.size()))
+        {
+            return nullptr;
+        }
+        xdr::xdr_from_opaque(lastKey, index->mLastKey);
+        size_t words = index->bloomBits() / 64;
+        for (uint64_t i = 0; i < nPages; ++i)
+        {
+            Page p;
+            p.mOffset = getU64(in);
+            std::vector<uint8_t> key(getU32(in));
+            if (!in.read(reinterpret_cast<char*>(key.data()), key.size()))
+            {
+                return nullptr;
+            }
+            xdr::xdr_from_opaque(key, p.mFirstKey);
+            p.mBloom.resize(words);
+            for (auto& w : p.mBloom)
+            {
+                w = getU64(in);
+            }
+            index->mPages.emplace_back(std::move(p));
+        }
+        return index;
+    }
+    catch (std::exception& e)
+    {
+        CLOG(WARNING, "Bucket") << "Ignoring unreadable bucket index "
+                                << filename << ": " << e.what();
+        return nullptr;
+    }
+}
+}
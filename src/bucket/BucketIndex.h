@@ -0,0 +1,79 @@
+#pragma once
+
+// Copyright 2017 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "overlay/StellarXDR.h"
+#include "util/NonCopyable.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace stellar
+{
+
+/**
+ * BucketIndex is a sparse index over the entries of a single bucket file,
+ * used to find an entry by key without scanning the whole bucket.
+ *
+ * The bucket is cut into "pages" of a fixed number of consecutive entries.
+ * For each page the index records the key of its first entry, the byte offset
+ * of that entry in the bucket file, and a small bloom filter over the keys of
+ * all the entries in the page. A lookup binary-searches the first keys to find
+ * the single page that could hold a key, consults that page's bloom filter,
+ * and only then reads the page from disk. The index also records the last key
+ * of the bucket, so keys outside the bucket's key range are rejected outright.
+ *
+ * Indexes are built by Bucket::OutputIterator as the bucket is written, and
+ * saved in a file next to the bucket file (see Bucket::indexFilename). They
+ * are purely local acceleration structures: they are not hashed, published
+ * or compared with peers, and can always be rebuilt from the bucket.
+ */
+class BucketIndex : public NonMovableOrCopyable
+{
+  public:
+    struct Page
+    {
+        LedgerKey mFirstKey;
+        uint64_t mOffset;
+        std::vector<uint64_t> mBloom;
+    };
+
+    // Number of entries per page, unless otherwise specified.
+    static const size_t kDefaultPageSize = 256;
+
+  private:
+    size_t const mPageSize;
+    size_t mEntries{0};
+    std::vector<Page> mPages;
+    LedgerKey mLastKey;
+
+    size_t bloomBits() const;
+
+  public:
+    explicit BucketIndex(size_t pageSize = kDefaultPageSize);
+
+    // Record an entry with key `key`, starting at byte `offset` of the bucket
+    // file. Entries must be added in bucket order.
+    void addEntry(LedgerKey const& key, uint64_t offset);
+
+    // Append the pages of `other`, an index of entries that follow this
+    // index's entries in the bucket file, starting at byte `offset`. The last
+    // page of this index may end up short; no entries may be added after.
+    void append(BucketIndex const& other, uint64_t offset);
+
+    // Return the page that would contain `key` if it were in the bucket, or
+    // nullptr if the bucket definitely does not contain `key`.
+    Page const* findPage(LedgerKey const& key) const;
+
+    size_t getPageSize() const;
+    size_t getEntryCount() const;
+    std::vector<Page> const& getPages() const;
+
+    // Write the index to `filename`, or read it back. `load` returns nullptr
+    // if the file does not exist or is not a readable index.
+    void save(std::string const& filename) const;
+    static std::unique_ptr<BucketIndex> load(std::string const& filename);
+};
+}
@@ -7,6 +7,7 @@
 #include "bucket/Bucket.h"
 #include "overlay/StellarXDR.h"
 #include "util/NonCopyable.h"
+#include <functional>
 #include <memory>
 
 #include "medida/timer_context.h"
@@ -56,6 +57,40 @@ class BucketManager : NonMovableOrCopyable
 
     virtual medida::Timer& getMergeTimer() = 0;
 
+    // Lookups of merge candidates in shadow buckets that were answered from
+    // the shadow's index summary without reading it, and those that were not.
+    virtual medida::Meter& getShadowReadsAvoidedMeter() = 0;
+    virtual medida::Meter& getShadowReadsMeter() = 0;
+
+    // Size of the blocks to read from bucket files when iterating over them.
+    virtual size_t getReadBlockSize() const = 0;
+
+    // Whether bucket files should be memory-mapped rather than read in blocks
+    // when iterating over them.
+    virtual bool getReadUseMmap() const = 0;
+
+    // Number of key ranges to merge in parallel when merging buckets whose
+    // files total `inputBytes`; 1 for an ordinary, serial merge.
+    virtual size_t getMergePartitions(uint64_t inputBytes) const = 0;
+
+    // Whether new bucket files should be written block-compressed.
+    virtual bool getCompressBuckets() const = 0;
+
+    // Queue a bucket merge for BucketList level `level` on the BucketManager's
+    // dedicated merge threads. Queued merges for shallower levels run before
+    // those for deeper levels, since the next ledger close is most likely to
+    // block on them; merges for the same level run in the order posted.
+    //
+    // Threadsafe; normally called from the main thread.
+    virtual void postMerge(uint32_t level, std::function<void()> merge) = 0;
+
+    // Block until no merges are queued or running. For testing.
+    virtual void waitForMerges() = 0;
+
+    // Run any queued merges to completion and join the merge threads. Called
+    // while the Application is shutting down, along with its worker threads.
+    virtual void shutdown() = 0;
+
     // Get a reference to a persistent bucket (in the BucketManager's bucket
     // directory), from the BucketManager's shared bucket-set.
     //
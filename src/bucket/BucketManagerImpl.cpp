@@ -14,6 +14,7 @@
 #include "util/TmpDir.h"
 #include "util/make_unique.h"
 #include "util/types.h"
+#include <algorithm>
 #include <fstream>
 #include <map>
 #include <set>
@@ -62,10 +63,129 @@ BucketManagerImpl::BucketManagerImpl(Application& app)
           app.getMetrics().NewMeter({"bucket", "byte", "insert"}, "byte"))
     , mBucketAddBatch(app.getMetrics().NewTimer({"bucket", "batch", "add"}))
     , mBucketSnapMerge(app.getMetrics().NewTimer({"bucket", "snap", "merge"}))
+    , mShadowReadsAvoided(app.getMetrics().NewMeter(
+          {"bucket", "merge", "shadow-reads-avoided"}, "entry"))
+    , mShadowReads(app.getMetrics().NewMeter(
+          {"bucket", "merge", "shadow-reads"}, "entry"))
     , mSharedBucketsSize(
           app.getMetrics().NewCounter({"bucket", "memory", "shared"}))
+    , mMergeQueueDepth(
+          app.getMetrics().NewCounter({"bucket", "merge", "queue-depth"}))
 
 {
+    for (size_t i = 0; i < BucketList::kNumLevels; ++i)
+    {
+        mMergeLevelTimers.push_back(&app.getMetrics().NewTimer(
+            {"bucket", "merge-time", "level-" + std::to_string(i)}));
+    }
+
+    size_t nThreads = app.getConfig().BUCKET_MERGE_THREADS;
+    if (nThreads == 0)
+    {
+        nThreads = std::max(1u, std::thread::hardware_concurrency() / 2);
+    }
+    CLOG(DEBUG, "Bucket") << "Starting " << nThreads << " merge threads";
+    for (size_t i = 0; i < nThreads; ++i)
+    {
+        mMergeThreads.emplace_back([this]() { runMergeThread(); });
+    }
+}
+
+bool
+BucketManagerImpl::PendingMergeCmp::
+operator()(PendingMerge const& a, PendingMerge const& b) const
+{
+    // std::priority_queue pops the greatest element, so "less" here means
+    // "runs later": deeper levels, then later-posted merges.
+    if (a.mLevel != b.mLevel)
+    {
+        return a.mLevel > b.mLevel;
+    }
+    return a.mSeq > b.mSeq;
+}
+
+void
+BucketManagerImpl::postMerge(uint32_t level, std::function<void()> merge)
+{
+    assert(level < BucketList::kNumLevels);
+    {
+        std::lock_guard<std::mutex> lock(mMergeMutex);
+        if (mMergeShutdown)
+        {
+            throw std::runtime_error("merge posted after shutdown");
+        }
+        mPendingMerges.push(PendingMerge{level, mMergeSeq++, merge});
+        mMergeQueueDepth.set_count(mPendingMerges.size());
+    }
+    mMergeQueued.notify_one();
+}
+
+void
+BucketManagerImpl::runMergeThread()
+{
+    for (;;)
+    {
+        PendingMerge next;
+        {
+            std::unique_lock<std::mutex> lock(mMergeMutex);
+            mMergeQueued.wait(lock, [this]() {
+                return mMergeShutdown || !mPendingMerges.empty();
+            });
+            if (mPendingMerges.empty())
+            {
+                // Shutting down and nothing left to do.
+                return;
+            }
+            next = mPendingMerges.top();
+            mPendingMerges.pop();
+            mMergeQueueDepth.set_count(mPendingMerges.size());
+            ++mRunningMerges;
+        }
+
+        {
+            auto timer = mMergeLevelTimers.at(next.mLevel)->TimeScope();
+            next.mMerge();
+        }
+        // Drop the merge (and the buckets it captured) before reporting it
+        // done, so waiters see the buckets released.
+        next.mMerge = nullptr;
+
+        {
+            std::lock_guard<std::mutex> lock(mMergeMutex);
+            --mRunningMerges;
+        }
+        mMergeDone.notify_all();
+    }
+}
+
+void
+BucketManagerImpl::waitForMerges()
+{
+    std::unique_lock<std::mutex> lock(mMergeMutex);
+    mMergeDone.wait(lock, [this]() {
+        return mPendingMerges.empty() && mRunningMerges == 0;
+    });
+}
+
+void
+BucketManagerImpl::shutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMergeMutex);
+        if (mMergeShutdown)
+        {
+            return;
+        }
+        mMergeShutdown = true;
+    }
+    mMergeQueued.notify_all();
+    CLOG(DEBUG, "Bucket") << "Joining " << mMergeThreads.size()
+                          << " merge threads";
+    for (auto& t : mMergeThreads)
+    {
+        t.join();
+    }
+    mMergeThreads.clear();
 }
 
 const std::string BucketManagerImpl::kLockFilename = "stellar-core.lock";
@@ -123,6 +243,8 @@ BucketManagerImpl::getBucketDir()
 
 BucketManagerImpl::~BucketManagerImpl()
 {
+    shutdown();
+
     if (mLockedBucketDir)
     {
         std::string d = mApp.getConfig().BUCKET_DIR_PATH;
@@ -144,6 +266,48 @@ BucketManagerImpl::getMergeTimer()
     return mBucketSnapMerge;
 }
 
+medida::Meter&
+BucketManagerImpl::getShadowReadsAvoidedMeter()
+{
+    return mShadowReadsAvoided;
+}
+
+medida::Meter&
+BucketManagerImpl::getShadowReadsMeter()
+{
+    return mShadowReads;
+}
+
+size_t
+BucketManagerImpl::getReadBlockSize() const
+{
+    return mApp.getConfig().BUCKET_READ_BLOCK_SIZE;
+}
+
+bool
+BucketManagerImpl::getReadUseMmap() const
+{
+    return mApp.getConfig().BUCKET_READ_USE_MMAP;
+}
+
+size_t
+BucketManagerImpl::getMergePartitions(uint64_t inputBytes) const
+{
+    auto const& cfg = mApp.getConfig();
+    if (cfg.BUCKET_PARTITIONED_MERGE_MIN_BYTES == 0 ||
+        inputBytes < cfg.BUCKET_PARTITIONED_MERGE_MIN_BYTES)
+    {
+        return 1;
+    }
+    return cfg.BUCKET_MERGE_PARTITIONS;
+}
+
+bool
+BucketManagerImpl::getCompressBuckets() const
+{
+    return mApp.getConfig().BUCKET_COMPRESSION;
+}
+
 std::shared_ptr<Bucket>
 BucketManagerImpl::adoptFileAsBucket(std::string const& filename,
                                      uint256 const& hash, size_t nObjects,
@@ -157,6 +321,7 @@ BucketManagerImpl::adoptFileAsBucket(std::string const& filename,
         CLOG(DEBUG, "Bucket") << "Deleting bucket file " << filename
                               << " that is redundant with existing bucket";
         std::remove(filename.c_str());
+        std::remove(Bucket::indexFilename(filename).c_str());
     }
     else
     {
@@ -172,6 +337,16 @@ BucketManagerImpl::adoptFileAsBucket(std::string const& filename,
             throw std::runtime_error(err);
         }
 
+        // The index is only an accelerator; if it is missing or cannot be
+        // moved the bucket will rebuild it on first use.
+        std::string indexName = Bucket::indexFilename(filename);
+        std::string canonicalIndexName = Bucket::indexFilename(canonicalName);
+        if (fs::exists(indexName) &&
+            rename(indexName.c_str(), canonicalIndexName.c_str()) != 0)
+        {
+            std::remove(indexName.c_str());
+        }
+
         b = std::make_shared<Bucket>(canonicalName, hash);
         {
             mSharedBuckets.insert(std::make_pair(hash, b));
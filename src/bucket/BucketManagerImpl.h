@@ -4,10 +4,15 @@
 #include "bucket/BucketManager.h"
 #include "overlay/StellarXDR.h"
 
+#include <condition_variable>
+#include <functional>
 #include <map>
 #include <memory>
 #include <mutex>
+#include <queue>
 #include <string>
+#include <thread>
+#include <vector>
 
 // Copyright 2015 Stellar Development Foundation and contributors. Licensed
 // under the Apache License, Version 2.0. See the COPYING file at the root
@@ -43,8 +48,37 @@ class BucketManagerImpl : public BucketManager
     medida::Meter& mBucketByteInsert;
     medida::Timer& mBucketAddBatch;
     medida::Timer& mBucketSnapMerge;
+    medida::Meter& mShadowReadsAvoided;
+    medida::Meter& mShadowReads;
     medida::Counter& mSharedBucketsSize;
 
+    // Merges waiting for a merge thread, ordered by level (shallowest first)
+    // and then by posting order.
+    struct PendingMerge
+    {
+        uint32_t mLevel;
+        uint64_t mSeq;
+        std::function<void()> mMerge;
+    };
+    struct PendingMergeCmp
+    {
+        bool operator()(PendingMerge const& a, PendingMerge const& b) const;
+    };
+    std::priority_queue<PendingMerge, std::vector<PendingMerge>,
+                        PendingMergeCmp>
+        mPendingMerges;
+    std::mutex mMergeMutex;
+    std::condition_variable mMergeQueued;
+    std::condition_variable mMergeDone;
+    std::vector<std::thread> mMergeThreads;
+    uint64_t mMergeSeq{0};
+    size_t mRunningMerges{0};
+    bool mMergeShutdown{false};
+    medida::Counter& mMergeQueueDepth;
+    std::vector<medida::Timer*> mMergeLevelTimers;
+
+    void runMergeThread();
+
   protected:
     void calculateSkipValues(LedgerHeader& currentHeader);
     std::string bucketFilename(std::string const& bucketHexHash);
@@ -57,6 +91,15 @@ class BucketManagerImpl : public BucketManager
     std::string const& getBucketDir() override;
     BucketList& getBucketList() override;
     medida::Timer& getMergeTimer() override;
+    medida::Meter& getShadowReadsAvoidedMeter() override;
+    medida::Meter& getShadowReadsMeter() override;
+    size_t getReadBlockSize() const override;
+    bool getReadUseMmap() const override;
+    size_t getMergePartitions(uint64_t inputBytes) const override;
+    bool getCompressBuckets() const override;
+    void postMerge(uint32_t level, std::function<void()> merge) override;
+    void waitForMerges() override;
+    void shutdown() override;
     std::shared_ptr<Bucket> adoptFileAsBucket(std::string const& filename,
                                               uint256 const& hash,
                                               size_t nObjects,
@@ -8,6 +8,8 @@
 #include "util/asio.h"
 
 #include "bucket/Bucket.h"
+#include "bucket/BucketApplicator.h"
+#include "bucket/BucketIndex.h"
 #include "bucket/BucketList.h"
 #include "bucket/BucketManager.h"
 #include "bucket/BucketManagerImpl.h"
@@ -23,14 +25,20 @@
 #include "medida/metrics_registry.h"
 #include "medida/timer.h"
 #include "test/test.h"
+#include "util/BlockCompression.h"
 #include "util/Fs.h"
 #include "util/Logging.h"
+#include "util/Math.h"
 #include "util/Timer.h"
 #include "util/TmpDir.h"
+#include "util/XDRStream.h"
 #include "util/types.h"
 #include "xdrpp/autocheck.h"
 #include <algorithm>
+#include <chrono>
 #include <future>
+#include <iterator>
+#include <set>
 
 using namespace stellar;
 
@@ -432,6 +440,384 @@ TEST_CASE("file-backed buckets", "[bucket][bucketbench]")
     CLOG(DEBUG, "Bucket") << "Spill file size: " << fileSize(b1->getFilename());
 }
 
+TEST_CASE("mmap bucket reads match block reads", "[bucket]")
+{
+    std::vector<LedgerEntry> live1(1000), live2(1000);
+    std::vector<LedgerKey> dead(100);
+    autocheck::generator<LedgerKey> deadGen;
+    for (auto& e : live1)
+        e = LedgerTestUtils::generateValidLedgerEntry(3);
+    for (auto& e : live2)
+        e = LedgerTestUtils::generateValidLedgerEntry(3);
+    for (auto& e : dead)
+        e = deadGen(3);
+
+    Hash mergedHash[2];
+    for (int useMmap = 0; useMmap < 2; ++useMmap)
+    {
+        VirtualClock clock;
+        Config cfg(getTestConfig());
+        cfg.BUCKET_READ_USE_MMAP = (useMmap != 0);
+        Application::pointer app = Application::create(clock, cfg);
+        auto b1 = Bucket::fresh(app->getBucketManager(), live1, dead);
+        auto b2 = Bucket::fresh(app->getBucketManager(), live2, {});
+        auto merged = Bucket::merge(app->getBucketManager(), b1, b2, {b1});
+        mergedHash[useMmap] = merged->getHash();
+
+        XDRInputFileStream blockIn, mapIn(0, 4096, true);
+        blockIn.open(merged->getFilename());
+        mapIn.open(merged->getFilename());
+        BucketEntry e1, e2;
+        size_t n = 0;
+        while (blockIn.readOne(e1))
+        {
+            REQUIRE(mapIn.readOne(e2));
+            REQUIRE(xdr::xdr_to_opaque(e1) == xdr::xdr_to_opaque(e2));
+            ++n;
+        }
+        REQUIRE(!mapIn.readOne(e2));
+        REQUIRE(n == countEntries(merged));
+    }
+    REQUIRE(mergedHash[0] == mergedHash[1]);
+}
+
+TEST_CASE("partitioned merge matches serial merge", "[bucket]")
+{
+    // Enough entries for several index pages per bucket, with overlapping
+    // keys between old, new, dead and shadow entries.
+    std::vector<LedgerEntry> live1(3000), live2;
+    std::vector<LedgerKey> dead, shadowed;
+    for (auto& e : live1)
+        e = LedgerTestUtils::generateValidLedgerEntry(3);
+    for (size_t i = 0; i < live1.size(); ++i)
+    {
+        if (i % 3 == 0)
+        {
+            live2.push_back(live1[i]);
+            live2.back().lastModifiedLedgerSeq++;
+        }
+        else if (i % 7 == 0)
+        {
+            dead.push_back(LedgerEntryKey(live1[i]));
+        }
+        else if (i % 11 == 0)
+        {
+            shadowed.push_back(LedgerEntryKey(live1[i]));
+        }
+    }
+    for (size_t i = 0; i < 1000; ++i)
+        live2.push_back(LedgerTestUtils::generateValidLedgerEntry(3));
+
+    auto readFile = [](std::string const& name) {
+        std::ifstream in(name, std::ifstream::binary);
+        return std::string(std::istreambuf_iterator<char>(in),
+                           std::istreambuf_iterator<char>());
+    };
+
+    for (bool keepDead : {true, false})
+    {
+        Hash mergedHash[2];
+        std::string mergedBytes[2];
+        for (int partitioned = 0; partitioned < 2; ++partitioned)
+        {
+            VirtualClock clock;
+            Config cfg(getTestConfig());
+            if (partitioned)
+            {
+                cfg.BUCKET_PARTITIONED_MERGE_MIN_BYTES = 1;
+                cfg.BUCKET_MERGE_PARTITIONS = 4;
+            }
+            Application::pointer app = Application::create(clock, cfg);
+            auto& bm = app->getBucketManager();
+            auto b1 = Bucket::fresh(bm, live1, {});
+            auto b2 = Bucket::fresh(bm, live2, dead);
+            auto shadow = Bucket::fresh(bm, {}, shadowed);
+            auto merged = Bucket::merge(bm, b1, b2, {shadow}, keepDead);
+            mergedHash[partitioned] = merged->getHash();
+            mergedBytes[partitioned] = readFile(merged->getFilename());
+            REQUIRE(mergedBytes[partitioned].size() > 0);
+
+            // The index stitched together from the partitions must still
+            // find every entry.
+            BucketEntry e;
+            e.type(LIVEENTRY);
+            for (auto const& le : live2)
+            {
+                e.liveEntry() = le;
+                REQUIRE(merged->containsBucketIdentity(e));
+            }
+        }
+        REQUIRE(mergedHash[0] == mergedHash[1]);
+        REQUIRE(mergedBytes[0] == mergedBytes[1]);
+    }
+}
+
+#ifdef USE_ZLIB
+TEST_CASE("compressed buckets match uncompressed buckets", "[bucket]")
+{
+    std::vector<LedgerEntry> live1(3000), live2(1000);
+    std::vector<LedgerKey> dead;
+    for (auto& e : live1)
+        e = LedgerTestUtils::generateValidLedgerEntry(3);
+    for (auto& e : live2)
+        e = LedgerTestUtils::generateValidLedgerEntry(3);
+    for (size_t i = 0; i < live1.size(); i += 10)
+        dead.push_back(LedgerEntryKey(live1[i]));
+
+    Hash mergedHash[2];
+    size_t mergedSize[2];
+    std::vector<BucketEntry> mergedEntries[2];
+    for (int compressed = 0; compressed < 2; ++compressed)
+    {
+        VirtualClock clock;
+        Config cfg(getTestConfig());
+        cfg.BUCKET_COMPRESSION = (compressed != 0);
+        Application::pointer app = Application::create(clock, cfg);
+        auto& bm = app->getBucketManager();
+        auto b1 = Bucket::fresh(bm, live1, {});
+        auto b2 = Bucket::fresh(bm, live2, dead);
+        auto merged = Bucket::merge(bm, b1, b2);
+        REQUIRE(isBlockCompressedFile(merged->getFilename()) ==
+                (compressed != 0));
+        mergedHash[compressed] = merged->getHash();
+        mergedSize[compressed] =
+            static_cast<size_t>(fileSize(merged->getFilename()));
+
+        XDRInputFileStream in;
+        in.open(merged->getFilename());
+        BucketEntry e;
+        while (in.readOne(e))
+        {
+            mergedEntries[compressed].push_back(e);
+        }
+
+        // Indexed lookups seek into the middle of compressed blocks.
+        for (auto const& be : mergedEntries[compressed])
+        {
+            REQUIRE(merged->containsBucketIdentity(be));
+        }
+    }
+    REQUIRE(mergedHash[0] == mergedHash[1]);
+    REQUIRE(mergedSize[1] < mergedSize[0]);
+    REQUIRE(mergedEntries[0].size() == mergedEntries[1].size());
+    for (size_t i = 0; i < mergedEntries[0].size(); ++i)
+    {
+        REQUIRE(xdr::xdr_to_opaque(mergedEntries[0][i]) ==
+                xdr::xdr_to_opaque(mergedEntries[1][i]));
+    }
+}
+#endif
+
+TEST_CASE("bucket read throughput", "[bucket][bucketbench][hide]")
+{
+    size_t const nEntries = 200000;
+    autocheck::generator<LedgerKey> deadGen;
+    CLOG(INFO, "Bucket") << "Generating " << 2 * nEntries
+                         << " random ledger entries";
+    std::vector<LedgerEntry> live1(nEntries), live2(nEntries);
+    std::vector<LedgerKey> dead(nEntries / 10);
+    for (auto& e : live1)
+        e = LedgerTestUtils::generateValidLedgerEntry(3);
+    for (auto& e : live2)
+        e = LedgerTestUtils::generateValidLedgerEntry(3);
+    for (auto& e : dead)
+        e = deadGen(3);
+
+    auto report = [](std::string const& what, size_t blockSize, bool mmap,
+                     size_t records, size_t bytes,
+                     std::chrono::steady_clock::duration d) {
+        double secs = std::chrono::duration<double>(d).count();
+        CLOG(INFO, "Bucket")
+            << what << " ("
+            << (mmap ? std::string("mmap")
+                     : "block size " + std::to_string(blockSize))
+            << "): " << records << " records, " << bytes << " bytes in "
+            << secs << "s = " << (bytes / secs) / (1024 * 1024) << " MB/s, "
+            << records / secs << " records/s";
+    };
+
+    std::vector<std::pair<size_t, bool>> modes = {{4096, false},
+                                                  {1024 * 1024, false},
+                                                  {8 * 1024 * 1024, false},
+                                                  {1024 * 1024, true}};
+    for (auto const& mode : modes)
+    {
+        size_t blockSize = mode.first;
+        bool useMmap = mode.second;
+        VirtualClock clock;
+        Config cfg(getTestConfig());
+        cfg.BUCKET_READ_BLOCK_SIZE = blockSize;
+        cfg.BUCKET_READ_USE_MMAP = useMmap;
+        Application::pointer app = Application::create(clock, cfg);
+
+        auto b1 = Bucket::fresh(app->getBucketManager(), live1, dead);
+        auto b2 = Bucket::fresh(app->getBucketManager(), live2, {});
+        size_t inBytes = static_cast<size_t>(fileSize(b1->getFilename())) +
+                         static_cast<size_t>(fileSize(b2->getFilename()));
+        size_t inRecords = countEntries(b1) + countEntries(b2);
+
+        auto start = std::chrono::steady_clock::now();
+        auto merged = Bucket::merge(app->getBucketManager(), b1, b2);
+        report("merge", blockSize, useMmap, inRecords, inBytes,
+               std::chrono::steady_clock::now() - start);
+
+        std::string const& filename = merged->getFilename();
+        size_t bytes = static_cast<size_t>(fileSize(filename));
+
+        if (blockSize == 4096 && !useMmap)
+        {
+            // Baseline: the previous reader, two std::ifstream reads per
+            // record.
+            start = std::chrono::steady_clock::now();
+            std::ifstream in(filename, std::ifstream::binary);
+            std::vector<char> buf;
+            BucketEntry e;
+            size_t records = 0;
+            char szBuf[4];
+            while (in.read(szBuf, 4))
+            {
+                uint32_t sz = ((static_cast<uint8_t>(szBuf[0]) & 0x7f) << 24) |
+                              (static_cast<uint8_t>(szBuf[1]) << 16) |
+                              (static_cast<uint8_t>(szBuf[2]) << 8) |
+                              static_cast<uint8_t>(szBuf[3]);
+                buf.resize(sz);
+                REQUIRE(in.read(buf.data(), sz));
+                xdr::xdr_from_opaque(buf, e);
+                ++records;
+            }
+            report("iterate (unbuffered ifstream)", 0, false, records, bytes,
+                   std::chrono::steady_clock::now() - start);
+        }
+
+        start = std::chrono::steady_clock::now();
+        XDRInputFileStream in(0, blockSize, useMmap);
+        in.open(filename);
+        BucketEntry e;
+        size_t records = 0;
+        while (in && in.readOne(e))
+        {
+            ++records;
+        }
+        report("iterate", blockSize, useMmap, records, bytes,
+               std::chrono::steady_clock::now() - start);
+    }
+}
+
+TEST_CASE("bucket index lookups", "[bucket][bucketindex]")
+{
+    VirtualClock clock;
+    Config const& cfg = getTestConfig();
+    Application::pointer app = Application::create(clock, cfg);
+
+    autocheck::generator<LedgerKey> keyGen;
+    std::vector<LedgerEntry> live(2000);
+    std::vector<LedgerKey> dead(200);
+    for (auto& e : live)
+        e = LedgerTestUtils::generateValidLedgerEntry(3);
+    for (auto& e : dead)
+        e = keyGen(3);
+    auto b = Bucket::fresh(app->getBucketManager(), live, dead);
+
+    std::set<LedgerKey, LedgerEntryIdCmp> deadKeys(dead.begin(), dead.end());
+    std::set<LedgerKey, LedgerEntryIdCmp> allKeys(dead.begin(), dead.end());
+    for (auto const& e : live)
+    {
+        allKeys.insert(LedgerEntryKey(e));
+    }
+
+    auto checkAll = [&]() {
+        BucketEntry out;
+        for (auto const& k : allKeys)
+        {
+            bool isDead = deadKeys.find(k) != deadKeys.end();
+            REQUIRE(b->getBucketEntry(k, out));
+            REQUIRE(out.type() == (isDead ? DEADENTRY : LIVEENTRY));
+        }
+        for (size_t i = 0; i < 1000; ++i)
+        {
+            BucketEntry be;
+            be.type(DEADENTRY);
+            be.deadEntry() = keyGen(3);
+            bool expected = allKeys.find(be.deadEntry()) != allKeys.end();
+            REQUIRE(b->containsBucketIdentity(be) == expected);
+        }
+    };
+
+    SECTION("index written alongside bucket")
+    {
+        REQUIRE(fs::exists(Bucket::indexFilename(b->getFilename())));
+        auto index = b->getIndex();
+        REQUIRE(index);
+        REQUIRE(index->getEntryCount() == countEntries(b));
+        checkAll();
+    }
+
+    SECTION("index rebuilt when index file is missing")
+    {
+        std::remove(Bucket::indexFilename(b->getFilename()).c_str());
+        auto index = b->getIndex();
+        REQUIRE(index);
+        REQUIRE(index->getEntryCount() == countEntries(b));
+        checkAll();
+    }
+}
+
+TEST_CASE("bucket index lookup bench", "[bucket][bucketbench][hide]")
+{
+    VirtualClock clock;
+    Config const& cfg = getTestConfig();
+    Application::pointer app = Application::create(clock, cfg);
+
+    size_t const nEntries = 200000, nLookups = 10000;
+    std::vector<LedgerEntry> live(nEntries);
+    for (auto& e : live)
+        e = LedgerTestUtils::generateValidLedgerEntry(3);
+    auto b = Bucket::fresh(app->getBucketManager(), live, {});
+    b->getIndex();
+
+    std::vector<LedgerKey> keys;
+    for (size_t i = 0; i < nLookups; ++i)
+    {
+        keys.emplace_back(LedgerEntryKey(live[rand_uniform<size_t>(
+            0, live.size() - 1)]));
+    }
+
+    auto report = [&](std::string const& what, size_t n,
+                      std::chrono::steady_clock::duration d) {
+        double secs = std::chrono::duration<double>(d).count();
+        CLOG(INFO, "Bucket") << what << ": " << n << " lookups in " << secs
+                             << "s = " << n / secs << " lookups/s";
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    BucketEntry out;
+    for (auto const& k : keys)
+    {
+        REQUIRE(b->getBucketEntry(k, out));
+    }
+    report("indexed lookup", keys.size(),
+           std::chrono::steady_clock::now() - start);
+
+    // Baseline: the linear scan containsBucketIdentity used to do. Far slower,
+    // so run fewer lookups.
+    size_t nScans = 100;
+    start = std::chrono::steady_clock::now();
+    LedgerEntryIdCmp cmp;
+    for (size_t i = 0; i < nScans; ++i)
+    {
+        XDRInputFileStream in;
+        in.open(b->getFilename());
+        bool found = false;
+        while (!found && in.readOne(out))
+        {
+            found = !(cmp(out.liveEntry(), keys[i]) ||
+                      cmp(keys[i], out.liveEntry()));
+        }
+        REQUIRE(found);
+    }
+    report("linear scan", nScans, std::chrono::steady_clock::now() - start);
+}
+
 TEST_CASE("merging bucket entries", "[bucket]")
 {
     VirtualClock clock;
@@ -545,33 +931,72 @@ clearFutures(Application::pointer app, BucketList& bl)
         bl.getLevel(i).getNext().clear();
     }
 
-    // Then go through all the _worker threads_ and mop up any work they
-    // might still be doing (that might be "dropping a shared_ptr<Bucket>").
+    // Then wait for the merge threads to mop up any work they might still be
+    // doing (that might be "dropping a shared_ptr<Bucket>").
+    app->getBucketManager().waitForMerges();
+}
 
-    size_t n = std::thread::hardware_concurrency();
-    std::mutex mutex;
-    std::condition_variable cv, cv2;
-    size_t waiting = 0, finished = 0;
-    for (size_t i = 0; i < n; ++i)
+TEST_CASE("merge skips shadows using index summaries", "[bucket]")
+{
+    VirtualClock clock;
+    Config const& cfg = getTestConfig();
+    Application::pointer app = Application::create(clock, cfg);
+    auto& bm = app->getBucketManager();
+
+    std::vector<LedgerEntry> live(2000);
+    std::vector<LedgerKey> shadowed;
+    for (auto& e : live)
+        e = LedgerTestUtils::generateValidLedgerEntry(3);
+    for (size_t i = 0; i < live.size(); i += 50)
+        shadowed.push_back(LedgerEntryKey(live[i]));
+
+    auto b1 = Bucket::fresh(bm, live, {});
+    auto shadow = Bucket::fresh(bm, {}, shadowed);
+    auto merged =
+        Bucket::merge(bm, b1, std::make_shared<Bucket>(), {shadow}, false);
+
+    // Shadowed entries are gone, everything else survives.
+    BucketEntry e;
+    e.type(LIVEENTRY);
+    for (size_t i = 0; i < live.size(); ++i)
     {
-        app->getWorkerIOService().post([&] {
-            std::unique_lock<std::mutex> lock(mutex);
-            if (++waiting == n)
-            {
-                cv.notify_all();
-            }
-            else
-            {
-                cv.wait(lock, [&] { return waiting == n; });
-            }
-            ++finished;
-            cv2.notify_one();
-        });
+        e.liveEntry() = live[i];
+        REQUIRE(merged->containsBucketIdentity(e) == (i % 50 != 0));
     }
+
+    // Each candidate is looked up in the shadow at most once, and most are
+    // skipped: the shadow only holds one key in 50.
+    auto& reads = app->getMetrics().NewMeter(
+        {"bucket", "merge", "shadow-reads"}, "entry");
+    auto& avoided = app->getMetrics().NewMeter(
+        {"bucket", "merge", "shadow-reads-avoided"}, "entry");
+    REQUIRE(reads.count() + avoided.count() <= live.size());
+    REQUIRE(reads.count() >= shadowed.size());
+    REQUIRE(avoided.count() > live.size() / 2);
+}
+
+TEST_CASE("bucket merges run shallowest level first", "[bucket]")
+{
+    VirtualClock clock;
+    Config cfg(getTestConfig());
+    cfg.BUCKET_MERGE_THREADS = 1;
+    Application::pointer app = Application::create(clock, cfg);
+    auto& bm = app->getBucketManager();
+
+    // Park the single merge thread so the remaining merges queue up behind
+    // it, then check they drain in (level, posting order) order.
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    bm.postMerge(BucketList::kNumLevels - 1, [released]() { released.wait(); });
+
+    std::vector<uint32_t> order;
+    for (uint32_t level : {5u, 2u, 9u, 0u, 2u})
     {
-        std::unique_lock<std::mutex> lock(mutex);
-        cv2.wait(lock, [&] { return finished == n; });
+        bm.postMerge(level, [&order, level]() { order.push_back(level); });
     }
+    release.set_value();
+    bm.waitForMerges();
+    REQUIRE(order == std::vector<uint32_t>({0, 2, 2, 5, 9}));
 }
 
 TEST_CASE("bucketmanager ownership", "[bucket]")
@@ -862,6 +1287,8 @@ TEST_CASE("checkdb succeeding", "[bucket][checkdb]")
         REQUIRE(
             m.NewMeter({"bucket", "checkdb", "object-compare"}, "comparison")
                 .count() >= 10);
+        REQUIRE(m.NewCounter({"bucket", "checkdb", "mismatches"}).count() ==
+                0);
     }
 
     SECTION("failing checkdb")
@@ -870,8 +1297,42 @@ TEST_CASE("checkdb succeeding", "[bucket][checkdb]")
         app->getDatabase().getSession()
             << ("UPDATE accounts SET balance = balance * 2"
                 " WHERE accountid = (SELECT accountid FROM accounts LIMIT 1);");
-        REQUIRE_THROWS(clock.crank(false));
+        while (m.NewTimer({"bucket", "checkdb", "execute"}).count() == 0)
+        {
+            clock.crank(false);
+        }
+        REQUIRE(m.NewCounter({"bucket", "checkdb", "mismatches"}).count() ==
+                1);
+    }
+}
+
+TEST_CASE("checkdb in the background", "[bucket][checkdb]")
+{
+    VirtualClock clock;
+    Config cfg(getTestConfig(0, Config::TESTDB_ON_DISK_SQLITE));
+    cfg.ARTIFICIALLY_GENERATE_LOAD_FOR_TESTING = true;
+    Application::pointer app = Application::create(clock, cfg);
+    app->start();
+
+    app->generateLoad(1000, 1000, 1000, false);
+    auto& m = app->getMetrics();
+    while (m.NewMeter({"loadgen", "run", "complete"}, "run").count() == 0)
+    {
+        clock.crank(false);
+    }
+
+    // The check reads a snapshot taken when it starts, so changes made to
+    // the database afterwards are not mismatches.
+    app->checkDB();
+    app->getDatabase().getSession()
+        << ("UPDATE accounts SET balance = balance * 2"
+            " WHERE accountid = (SELECT accountid FROM accounts LIMIT 1);");
+    while (m.NewTimer({"bucket", "checkdb", "execute"}).count() == 0)
+    {
+        clock.crank(false);
     }
+    REQUIRE(m.NewCounter({"bucket", "checkdb", "compared"}).count() >= 10);
+    REQUIRE(m.NewCounter({"bucket", "checkdb", "mismatches"}).count() == 0);
 }
 
 TEST_CASE("bucket apply", "[bucket]")
@@ -915,6 +1376,106 @@ TEST_CASE("bucket apply", "[bucket]")
     REQUIRE(count == 1);
 }
 
+TEST_CASE("bulk bucket apply stores deletes and changes", "[bucket]")
+{
+    std::vector<LedgerEntry> live;
+    std::set<LedgerKey, LedgerEntryIdCmp> seen;
+    for (auto const& e : LedgerTestUtils::generateValidLedgerEntries(1000))
+    {
+        if (seen.insert(LedgerEntryKey(e)).second)
+        {
+            live.emplace_back(e);
+        }
+    }
+
+    // A second bucket deletes the first quarter of the entries and changes
+    // the second quarter, dropping a signer from accounts that have some.
+    size_t quarter = live.size() / 4;
+    std::vector<LedgerEntry> changed, noLive;
+    std::vector<LedgerKey> dead, noDead;
+    for (size_t i = 0; i < quarter; ++i)
+    {
+        dead.emplace_back(LedgerEntryKey(live[i]));
+    }
+    for (size_t i = quarter; i < 2 * quarter; ++i)
+    {
+        auto e = live[i];
+        ++e.lastModifiedLedgerSeq;
+        if (e.data.type() == ACCOUNT && !e.data.account().signers.empty())
+        {
+            e.data.account().signers.pop_back();
+        }
+        changed.emplace_back(e);
+    }
+
+    VirtualClock clock;
+    Config cfg(getTestConfig());
+    Application::pointer app = Application::create(clock, cfg);
+    app->start();
+    auto& db = app->getDatabase();
+
+    auto first = Bucket::fresh(app->getBucketManager(), live, noDead);
+    auto second = Bucket::fresh(app->getBucketManager(), changed, dead);
+    for (auto const& b : {first, second})
+    {
+        BucketApplicator applicator(db, b);
+        while (applicator)
+        {
+            applicator.advance();
+        }
+    }
+
+    for (auto const& k : dead)
+    {
+        REQUIRE(!EntryFrame::exists(db, k));
+    }
+    for (auto const& e : changed)
+    {
+        REQUIRE_NOTHROW(EntryFrame::checkAgainstDatabase(e, db));
+    }
+    for (size_t i = 2 * quarter; i < live.size(); ++i)
+    {
+        REQUIRE_NOTHROW(EntryFrame::checkAgainstDatabase(live[i], db));
+    }
+}
+
+TEST_CASE("bucket applicator can be abandoned part-way", "[bucket]")
+{
+    VirtualClock clock;
+    Config cfg(getTestConfig());
+    Application::pointer app = Application::create(clock, cfg);
+    app->start();
+
+    size_t n = BucketApplicator::kBulkBatchSize *
+               (BucketApplicator::kPipelineDepth + 4);
+    std::vector<LedgerEntry> live(n);
+    std::vector<LedgerKey> noDead;
+    for (auto& e : live)
+    {
+        e.data.type(ACCOUNT);
+        e.data.account() = LedgerTestUtils::generateValidAccountEntry(5);
+    }
+    auto birth = Bucket::fresh(app->getBucketManager(), live, noDead);
+    auto& db = app->getDatabase();
+
+    {
+        // Stop after one batch, with the reader thread blocked on a full
+        // queue, as when the apply work is reset.
+        BucketApplicator applicator(db, birth);
+        applicator.advance();
+        REQUIRE(applicator);
+        REQUIRE(AccountFrame::countObjects(db.getSession()) ==
+                BucketApplicator::kBulkBatchSize + 1);
+    }
+
+    BucketApplicator applicator(db, birth);
+    while (applicator)
+    {
+        applicator.advance();
+    }
+    REQUIRE(AccountFrame::countObjects(db.getSession()) == n + 1);
+}
+
 #ifdef USE_POSTGRES
 TEST_CASE("bucket apply bench", "[bucketbench][hide]")
 {
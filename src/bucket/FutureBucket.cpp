@@ -23,7 +23,7 @@ FutureBucket::FutureBucket(Application& app,
                            std::shared_ptr<Bucket> const& curr,
                            std::shared_ptr<Bucket> const& snap,
                            std::vector<std::shared_ptr<Bucket>> const& shadows,
-                           bool keepDeadEntries)
+                           bool keepDeadEntries, uint32_t level)
     : mState(FB_LIVE_INPUTS)
     , mInputCurrBucket(curr)
     , mInputSnapBucket(snap)
@@ -41,7 +41,7 @@ FutureBucket::FutureBucket(Application& app,
     {
         mInputShadowBucketHashes.push_back(binToHex(b->getHash()));
     }
-    startMerge(app);
+    startMerge(app, level);
 }
 
 void
@@ -250,7 +250,7 @@ FutureBucket::getOutputHash() const
 }
 
 void
-FutureBucket::startMerge(Application& app)
+FutureBucket::startMerge(Application& app, uint32_t level)
 {
     // NB: startMerge starts with FutureBucket in a half-valid state; the inputs
     // are live but the merge is not yet running. So you can't call checkState()
@@ -299,12 +299,12 @@ FutureBucket::startMerge(Application& app)
         });
 
     mOutputBucket = task->get_future().share();
-    app.getWorkerIOService().post(bind(&task_t::operator(), task));
+    bm.postMerge(level, [task]() { (*task)(); });
     checkState();
 }
 
 void
-FutureBucket::makeLive(Application& app)
+FutureBucket::makeLive(Application& app, uint32_t level)
 {
     checkState();
     assert(!isLive());
@@ -330,7 +330,7 @@ FutureBucket::makeLive(Application& app)
             mInputShadowBuckets.push_back(b);
         }
         mState = FB_LIVE_INPUTS;
-        startMerge(app);
+        startMerge(app, level);
         assert(isLive());
     }
 }
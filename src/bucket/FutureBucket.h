@@ -74,17 +74,20 @@ class FutureBucket
 
     void checkHashesMatch() const;
     void checkState() const;
-    void startMerge(Application& app);
+    void startMerge(Application& app, uint32_t level);
 
     void clearInputs();
     void clearOutput();
     void setLiveOutput(std::shared_ptr<Bucket> b);
 
   public:
+    // Start merging `curr` and `snap` into a new bucket for BucketList level
+    // `level`; the level sets the merge's priority (see
+    // BucketManager::postMerge).
     FutureBucket(Application& app, std::shared_ptr<Bucket> const& curr,
                  std::shared_ptr<Bucket> const& snap,
                  std::vector<std::shared_ptr<Bucket>> const& shadows,
-                 bool keepDeadEntries);
+                 bool keepDeadEntries, uint32_t level);
 
     FutureBucket(std::shared_ptr<Bucket> output);
 
@@ -117,8 +120,9 @@ class FutureBucket
     // Precondition: isLive(); waits-for and resolves to merged bucket.
     std::shared_ptr<Bucket> resolve();
 
-    // Precondition: !isLive(); transitions from FB_HASH_FOO to FB_LIVE_FOO
-    void makeLive(Application& app);
+    // Precondition: !isLive(); transitions from FB_HASH_FOO to FB_LIVE_FOO,
+    // restarting the merge (if any) for BucketList level `level`.
+    void makeLive(Application& app, uint32_t level);
 
     // Return all hashes referenced by this future.
     std::vector<std::string> getHashes() const;
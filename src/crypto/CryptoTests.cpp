@@ -13,6 +13,8 @@
 #include "util/Logging.h"
 #include "util/basen.h"
 #include <autocheck/autocheck.hpp>
+#include <chrono>
+#include <future>
 #include <map>
 #include <regex>
 #include <sodium.h>
@@ -206,6 +208,138 @@ TEST_CASE("sign and verify benchmarking", "[crypto-bench][bench][hide]")
     }
 }
 
+TEST_CASE("batch signature verification", "[crypto]")
+{
+    size_t n = 200;
+    std::vector<SignVerifyTestcase> cases;
+    for (size_t i = 0; i < n; ++i)
+    {
+        cases.push_back(SignVerifyTestcase::create());
+        cases.back().sign();
+        if (i % 3 == 0)
+        {
+            cases.back().sig[4] ^= 1;
+        }
+    }
+    std::vector<PubKeyUtils::SigToVerify> sigs;
+    for (auto const& c : cases)
+    {
+        sigs.push_back(PubKeyUtils::SigToVerify{c.pub, c.sig, c.msg});
+    }
+
+    PubKeyUtils::clearVerifySigCache();
+    uint64_t hits, misses, ignores;
+    PubKeyUtils::flushVerifySigCacheCounts(hits, misses, ignores);
+
+    PubKeyUtils::verifySigs(sigs, 4);
+    PubKeyUtils::flushVerifySigCacheCounts(hits, misses, ignores);
+    REQUIRE(hits == 0);
+    REQUIRE(misses == n);
+
+    // every signature is now answered by the cache, with the result of a
+    // serial verification
+    for (size_t i = 0; i < n; ++i)
+    {
+        REQUIRE(PubKeyUtils::verifySig(cases[i].pub, cases[i].sig,
+                                       cases[i].msg) == (i % 3 != 0));
+    }
+    PubKeyUtils::flushVerifySigCacheCounts(hits, misses, ignores);
+    REQUIRE(hits == n);
+    REQUIRE(misses == 0);
+}
+
+TEST_CASE("signature verification cache size set once", "[crypto]")
+{
+    // whichever call came first in the process, later ones change nothing
+    size_t size = PubKeyUtils::setVerifySigCacheSize(0xffff);
+    REQUIRE(PubKeyUtils::setVerifySigCacheSize(size + 1) == size);
+    REQUIRE(PubKeyUtils::setVerifySigCacheSize(1) == size);
+}
+
+TEST_CASE("signature verification from several threads", "[crypto]")
+{
+    size_t n = 100;
+    std::vector<SignVerifyTestcase> cases;
+    for (size_t i = 0; i < n; ++i)
+    {
+        cases.push_back(SignVerifyTestcase::create());
+        cases.back().sign();
+        if (i % 2 == 0)
+        {
+            cases.back().msg.push_back(0);
+        }
+    }
+
+    PubKeyUtils::clearVerifySigCache();
+    uint64_t hits, misses, ignores;
+    PubKeyUtils::flushVerifySigCacheCounts(hits, misses, ignores);
+
+    size_t const nThreads = 4;
+    auto verifyAll = [&cases]() {
+        size_t valid = 0;
+        for (auto const& c : cases)
+        {
+            valid += PubKeyUtils::verifySig(c.pub, c.sig, c.msg) ? 1 : 0;
+        }
+        return valid;
+    };
+    std::vector<std::future<size_t>> futures;
+    for (size_t t = 0; t < nThreads; ++t)
+    {
+        futures.emplace_back(std::async(std::launch::async, verifyAll));
+    }
+    for (auto& f : futures)
+    {
+        REQUIRE(f.get() == n / 2);
+    }
+
+    // threads may race to verify the same signature first, but never lose
+    // a count
+    PubKeyUtils::flushVerifySigCacheCounts(hits, misses, ignores);
+    REQUIRE(hits + misses == nThreads * n);
+    REQUIRE(misses >= n);
+}
+
+TEST_CASE("batch verification benchmarking", "[crypto-bench][bench][hide]")
+{
+    size_t n = 10000;
+    std::vector<SignVerifyTestcase> cases;
+    std::vector<PubKeyUtils::SigToVerify> sigs;
+    for (size_t i = 0; i < n; ++i)
+    {
+        cases.push_back(SignVerifyTestcase::create());
+        cases.back().sign();
+    }
+    for (auto const& c : cases)
+    {
+        sigs.push_back(PubKeyUtils::SigToVerify{c.pub, c.sig, c.msg});
+    }
+
+    auto perSecond = [n](std::chrono::steady_clock::duration d) {
+        return n * 1000000 /
+               std::chrono::duration_cast<std::chrono::microseconds>(d)
+                   .count();
+    };
+    for (int i = 0; i < 3; ++i)
+    {
+        PubKeyUtils::clearVerifySigCache();
+        auto start = std::chrono::steady_clock::now();
+        for (auto& c : cases)
+        {
+            c.verify();
+        }
+        auto serial = std::chrono::steady_clock::now() - start;
+
+        PubKeyUtils::clearVerifySigCache();
+        start = std::chrono::steady_clock::now();
+        PubKeyUtils::verifySigs(sigs, 0);
+        auto batch = std::chrono::steady_clock::now() - start;
+
+        LOG(INFO) << "Verified " << n << " signatures: " << perSecond(serial)
+                  << "/s serially, " << perSecond(batch) << "/s in a batch";
+    }
+}
+
 TEST_CASE("StrKey tests", "[crypto]")
 {
     std::regex b32("^([A-Z2-7])+$");
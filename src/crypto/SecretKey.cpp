@@ -12,9 +12,14 @@
 #include "util/HashOfHash.h"
 #include "util/lrucache.hpp"
 #include "util/make_unique.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <future>
 #include <memory>
 #include <mutex>
 #include <sodium.h>
+#include <thread>
 #include <type_traits>
 
 namespace stellar
@@ -26,13 +31,27 @@ namespace stellar
 // to the state of the process; caching its results centrally
 // makes all signature-verification in the program faster and
 // has no effect on correctness.
+//
+// The cache is split in shards, picked by the first byte of the cache key,
+// each behind its own lock: threads verifying signatures at the same time
+// rarely wait on each other.
+
+namespace
+{
+struct VerifySigCacheShard
+{
+    std::mutex mMutex;
+    std::unique_ptr<cache::lru_cache<Hash, bool>> mCache;
+};
+}
 
-static std::mutex gVerifySigCacheMutex;
-static cache::lru_cache<Hash, bool> gVerifySigCache(0xffff);
-static std::unique_ptr<SHA256> gHasher = SHA256::create();
-static uint64_t gVerifyCacheHit = 0;
-static uint64_t gVerifyCacheMiss = 0;
-static uint64_t gVerifyCacheIgnore = 0;
+static size_t const kVerifySigCacheShards = 16;
+static std::array<VerifySigCacheShard, kVerifySigCacheShards> gVerifySigCache;
+static std::atomic<size_t> gVerifySigCacheSize(0xffff);
+static std::once_flag gVerifySigCacheSizeSet;
+static std::atomic<uint64_t> gVerifyCacheHit(0);
+static std::atomic<uint64_t> gVerifyCacheMiss(0);
+static std::atomic<uint64_t> gVerifyCacheIgnore(0);
 
 static bool
 shouldCacheVerifySig(PublicKey const& key, Signature const& signature,
@@ -47,11 +66,31 @@ verifySigCacheKey(PublicKey const& key, Signature const& signature,
 {
     assert(key.type() == PUBLIC_KEY_TYPE_ED25519);
 
-    gHasher->reset();
-    gHasher->add(key.ed25519());
-    gHasher->add(signature);
-    gHasher->add(bin);
-    return gHasher->finish();
+    static thread_local std::unique_ptr<SHA256> hasher = SHA256::create();
+    hasher->reset();
+    hasher->add(key.ed25519());
+    hasher->add(signature);
+    hasher->add(bin);
+    return hasher->finish();
+}
+
+static VerifySigCacheShard&
+getVerifySigCacheShard(Hash const& cacheKey)
+{
+    return gVerifySigCache[cacheKey[0] % kVerifySigCacheShards];
+}
+
+// Call with the lock of `shard` held.
+static cache::lru_cache<Hash, bool>&
+getVerifySigCache(VerifySigCacheShard& shard)
+{
+    if (!shard.mCache)
+    {
+        size_t size = std::max<size_t>(
+            1, gVerifySigCacheSize.load() / kVerifySigCacheShards);
+        shard.mCache = make_unique<cache::lru_cache<Hash, bool>>(size);
+    }
+    return *shard.mCache;
 }
 
 SecretKey::SecretKey() : mKeyType(PUBLIC_KEY_TYPE_ED25519)
@@ -206,21 +245,34 @@ SecretKey::fromStrKeySeed(std::string const& strKeySeed)
 void
 PubKeyUtils::clearVerifySigCache()
 {
-    std::lock_guard<std::mutex> guard(gVerifySigCacheMutex);
-    gVerifySigCache.clear();
+    for (auto& shard : gVerifySigCache)
+    {
+        std::lock_guard<std::mutex> guard(shard.mMutex);
+        shard.mCache.reset();
+    }
+}
+
+size_t
+PubKeyUtils::setVerifySigCacheSize(size_t size)
+{
+    // only the first call sets it: resizing clears the cache, under the
+    // applications already relying on it
+    std::call_once(gVerifySigCacheSizeSet, [size]() {
+        if (gVerifySigCacheSize.exchange(size) != size)
+        {
+            clearVerifySigCache();
+        }
+    });
+    return gVerifySigCacheSize.load();
 }
 
 void
 PubKeyUtils::flushVerifySigCacheCounts(uint64_t& hits, uint64_t& misses,
                                        uint64_t& ignores)
 {
-    std::lock_guard<std::mutex> guard(gVerifySigCacheMutex);
-    hits = gVerifyCacheHit;
-    misses = gVerifyCacheMiss;
-    ignores = gVerifyCacheIgnore;
-    gVerifyCacheHit = 0;
-    gVerifyCacheMiss = 0;
-    gVerifyCacheIgnore = 0;
+    hits = gVerifyCacheHit.exchange(0);
+    misses = gVerifyCacheMiss.exchange(0);
+    ignores = gVerifyCacheIgnore.exchange(0);
 }
 
 std::string
@@ -302,11 +354,13 @@ PubKeyUtils::verifySig(PublicKey const& key, Signature const& signature,
     if (shouldCache)
     {
         cacheKey = verifySigCacheKey(key, signature, bin);
-        std::lock_guard<std::mutex> guard(gVerifySigCacheMutex);
-        if (gVerifySigCache.exists(cacheKey))
+        auto& shard = getVerifySigCacheShard(cacheKey);
+        std::lock_guard<std::mutex> guard(shard.mMutex);
+        auto& cache = getVerifySigCache(shard);
+        if (cache.exists(cacheKey))
         {
             ++gVerifyCacheHit;
-            return gVerifySigCache.get(cacheKey);
+            return cache.get(cacheKey);
         }
         ++gVerifyCacheMiss;
     }
@@ -320,12 +374,47 @@ PubKeyUtils::verifySig(PublicKey const& key, Signature const& signature,
                                      key.ed25519().data()) == 0);
     if (shouldCache)
     {
-        std::lock_guard<std::mutex> guard(gVerifySigCacheMutex);
-        gVerifySigCache.put(cacheKey, ok);
+        auto& shard = getVerifySigCacheShard(cacheKey);
+        std::lock_guard<std::mutex> guard(shard.mMutex);
+        getVerifySigCache(shard).put(cacheKey, ok);
     }
     return ok;
 }
 
+void
+PubKeyUtils::verifySigs(std::vector<SigToVerify> const& sigs, size_t nThreads)
+{
+    auto verifyRange = [&sigs](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+        {
+            verifySig(sigs[i].mKey, sigs[i].mSignature, sigs[i].mBin);
+        }
+    };
+
+    if (nThreads == 0)
+    {
+        nThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    // starting a thread costs about as much as a few verifications
+    size_t const minPerThread = 16;
+    nThreads =
+        std::max<size_t>(1, std::min(nThreads, sigs.size() / minPerThread));
+    size_t perThread = (sigs.size() + nThreads - 1) / nThreads;
+
+    std::vector<std::future<void>> futures;
+    for (size_t t = 1; t < nThreads; ++t)
+    {
+        futures.emplace_back(
+            std::async(std::launch::async, verifyRange, t * perThread,
+                       std::min(sigs.size(), (t + 1) * perThread)));
+    }
+    verifyRange(0, std::min(sigs.size(), perThread));
+    for (auto& f : futures)
+    {
+        f.get();
+    }
+}
+
 PublicKey
 PubKeyUtils::random()
 {
@@ -4,19 +4,20 @@
 // under the Apache License, Version 2.0. See the COPYING file at the root
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
+#include "crypto/ByteSlice.h"
 #include "crypto/KeyUtils.h"
 #include "xdr/Stellar-types.h"
 
 #include <array>
 #include <functional>
 #include <ostream>
+#include <vector>
 
 namespace stellar
 {
 
 using xdr::operator==;
 
-class ByteSlice;
 struct SignerKey;
 
 class SecretKey
@@ -100,7 +101,23 @@ namespace PubKeyUtils
 bool verifySig(PublicKey const& key, Signature const& signature,
                ByteSlice const& bin);
 
+// A signature for verifySigs to check. The bytes `mBin` points to must
+// outlive the call.
+struct SigToVerify
+{
+    PublicKey mKey;
+    Signature mSignature;
+    ByteSlice mBin;
+};
+
+// Verify all of `sigs`, on up to `nThreads` threads (0 meaning one per
+// core), so that a later verifySig of any of them is a cache hit.
+void verifySigs(std::vector<SigToVerify> const& sigs, size_t nThreads);
+
 void clearVerifySigCache();
+// Set the number of verification results the cache of the process keeps.
+// Only the first call has an effect; returns the size in effect.
+size_t setVerifySigCacheSize(size_t size);
 void flushVerifySigCacheCounts(uint64_t& hits, uint64_t& misses,
                                uint64_t& ignores);
 
@@ -30,7 +30,10 @@
 #include "medida/counter.h"
 #include "medida/metrics_registry.h"
 #include "medida/timer.h"
+#include "util/basen.h"
+#include <sodium.h>
 
+#include <algorithm>
 #include <sstream>
 #include <stdexcept>
 #include <thread>
@@ -62,6 +65,104 @@ setSerializable(soci::session& sess)
             "SERIALIZABLE";
 }
 
+// The XDR blob columns of the history tables, and their other columns.
+struct HistoryTable
+{
+    std::string mName;
+    std::vector<std::string> mColumns;
+    std::vector<std::string> mBlobColumns;
+};
+
+static std::vector<HistoryTable> const kHistoryTables = {
+    {"txhistory",
+     {"txid", "ledgerseq", "txindex"},
+     {"txbody", "txresult", "txmeta"}},
+    {"txfeehistory", {"txid", "ledgerseq", "txindex"}, {"txchanges"}},
+    {"scphistory", {"nodeid", "ledgerseq"}, {"envelope"}},
+    {"ledgerheaders",
+     {"ledgerhash", "prevhash", "bucketlisthash", "ledgerseq", "closetime"},
+     {"data"}}};
+
+// postgres' base64 has line breaks
+static std::string
+pgBase64(std::string const& column)
+{
+    return "translate(encode(" + column + ", 'base64'), E'\\n', '')";
+}
+
+HistoryBlob::HistoryBlob(Database& db, soci::session& sess)
+    : HistoryBlob(db, sess, db.hasBinaryHistory())
+{
+}
+
+HistoryBlob::HistoryBlob(Database& db, soci::session& sess, bool binary)
+    : mBinary(binary), mSqlite(db.isSqlite())
+{
+    if (mBinary && mSqlite)
+    {
+        mBlob = make_unique<soci::blob>(sess);
+    }
+}
+
+void
+HistoryBlob::set(std::vector<uint8_t> const& bin)
+{
+    if (!mBinary)
+    {
+        mText = bn::encode_b64(bin);
+    }
+    else if (mSqlite)
+    {
+        mBlob->trim(0);
+        mBlob->write(0, reinterpret_cast<char const*>(bin.data()),
+                     bin.size());
+    }
+    else
+    {
+        mText = "\\x" + binToHex(bin);
+    }
+}
+
+void
+HistoryBlob::get(std::vector<uint8_t>& bin)
+{
+    if (!mBinary)
+    {
+        bn::decode_b64(mText, bin);
+    }
+    else if (mSqlite)
+    {
+        bin.resize(mBlob->get_len());
+        mBlob->read(0, reinterpret_cast<char*>(bin.data()), bin.size());
+    }
+    else
+    {
+        // bytea_output = 'hex', the default
+        if (mText.compare(0, 2, "\\x") != 0)
+        {
+            throw std::runtime_error("unexpected bytea format");
+        }
+        bin.resize((mText.size() - 2) / 2);
+        if (sodium_hex2bin(bin.data(), bin.size(), mText.data() + 2,
+                           mText.size() - 2, NULL, NULL, NULL) != 0)
+        {
+            throw std::runtime_error("invalid bytea");
+        }
+    }
+}
+
+soci::details::use_type_ptr
+HistoryBlob::use()
+{
+    return mBlob ? soci::use(*mBlob) : soci::use(mText);
+}
+
+soci::details::into_type_ptr
+HistoryBlob::into()
+{
+    return mBlob ? soci::into(*mBlob) : soci::into(mText);
+}
+
 void
 Database::registerDrivers()
 {
@@ -81,7 +182,12 @@ Database::Database(Application& app)
           app.getMetrics().NewMeter({"database", "query", "exec"}, "query"))
     , mStatementsSize(
           app.getMetrics().NewCounter({"database", "memory", "statements"}))
-    , mEntryCache(4096)
+    , mEntryCache(app.getMetrics(),
+                  static_cast<size_t>(app.getConfig().ENTRY_CACHE_BYTES))
+    , mOrderBooks(app.getMetrics())
+    , mInflationTally(app.getMetrics())
+    , mHistoryFormatKnown(false)
+    , mBinaryHistory(false)
     , mExcludedQueryTime(0)
     , mExcludedTotalTime(0)
     , mLastIdleQueryTime(0)
@@ -167,6 +273,194 @@ Database::upgradeToCurrentSchema()
         putSchemaVersion(vers);
     }
     assert(vers == SCHEMA_VERSION);
+    upgradeHistoryFormat();
+}
+
+bool
+Database::hasBinaryHistory()
+{
+    if (!mHistoryFormatKnown)
+    {
+        mBinaryHistory = mApp.getPersistentState().getState(
+                             PersistentState::kHistoryFormat) == "binary";
+        mHistoryFormatKnown = true;
+    }
+    return mBinaryHistory;
+}
+
+void
+Database::upgradeHistoryFormat()
+{
+    bool binary = mApp.getConfig().BINARY_HISTORY;
+    if (hasBinaryHistory() == binary)
+    {
+        return;
+    }
+    CLOG(INFO, "Database") << "Converting history to "
+                           << (binary ? "binary" : "base64");
+
+    clearPreparedStatementCache();
+    soci::transaction tx(mSession);
+    if (isSqlite())
+    {
+        // the columns are declared TEXT, but SQLite stores BLOB values in
+        // them as they are
+        convertSqliteHistory(binary);
+    }
+    else
+    {
+        if (!binary)
+        {
+            dropHistoryViews();
+        }
+        for (auto const& table : kHistoryTables)
+        {
+            for (auto const& column : table.mBlobColumns)
+            {
+                std::string type =
+                    binary ? "BYTEA USING decode(" + column + ", 'base64')"
+                           : "TEXT USING " + pgBase64(column);
+                mSession << "ALTER TABLE " << table.mName << " ALTER COLUMN "
+                         << column << " TYPE " << type;
+            }
+        }
+        if (binary)
+        {
+            createHistoryViews();
+        }
+    }
+    mApp.getPersistentState().setState(PersistentState::kHistoryFormat,
+                                       binary ? "binary" : "base64");
+    tx.commit();
+    mBinaryHistory = binary;
+}
+
+void
+Database::convertSqliteHistory(bool binary)
+{
+    // a batch of rows at a time, by rowid
+    long long const batchSize = 1000;
+    long long const logInterval = 100 * batchSize;
+    for (auto const& table : kHistoryTables)
+    {
+        auto const& columns = table.mBlobColumns;
+        std::string select = "SELECT rowid";
+        std::string update = "UPDATE " + table.mName + " SET ";
+        for (size_t i = 0; i < columns.size(); ++i)
+        {
+            select += ", " + columns[i];
+            update += (i == 0 ? "" : ", ") + columns[i] + " = :v" +
+                      std::to_string(i);
+        }
+        select += " FROM " + table.mName +
+                  " WHERE rowid > :r ORDER BY rowid LIMIT " +
+                  std::to_string(batchSize);
+        update += " WHERE rowid = :r";
+
+        long long total = 0;
+        mSession << "SELECT COUNT(*) FROM " << table.mName, into(total);
+        CLOG(INFO, "Database") << "Converting " << total << " rows of "
+                               << table.mName;
+
+        std::vector<HistoryBlob> from, to;
+        for (size_t i = 0; i < columns.size(); ++i)
+        {
+            from.emplace_back(*this, mSession, !binary);
+            to.emplace_back(*this, mSession, binary);
+        }
+        std::vector<uint8_t> bin;
+        long long lastRowID = -1;
+        long long converted = 0;
+        long long n;
+        do
+        {
+            std::vector<long long> rowIDs;
+            std::vector<std::vector<std::vector<uint8_t>>> rows;
+            {
+                long long rowID;
+                auto prep = getPreparedStatement(select);
+                auto& st = prep.statement();
+                st.exchange(into(rowID));
+                for (auto& v : from)
+                {
+                    st.exchange(v.into());
+                }
+                st.exchange(use(lastRowID));
+                st.define_and_bind();
+                st.execute(true);
+                while (st.got_data())
+                {
+                    rowIDs.push_back(rowID);
+                    rows.emplace_back(from.size());
+                    for (size_t i = 0; i < from.size(); ++i)
+                    {
+                        from[i].get(rows.back()[i]);
+                    }
+                    st.fetch();
+                }
+            }
+            n = static_cast<long long>(rowIDs.size());
+
+            for (size_t r = 0; r < rowIDs.size(); ++r)
+            {
+                for (size_t i = 0; i < to.size(); ++i)
+                {
+                    to[i].set(rows[r][i]);
+                }
+                auto prep = getPreparedStatement(update);
+                auto& st = prep.statement();
+                for (auto& v : to)
+                {
+                    st.exchange(v.use());
+                }
+                st.exchange(use(rowIDs[r]));
+                st.define_and_bind();
+                st.execute(true);
+                if (st.get_affected_rows() != 1)
+                {
+                    throw std::runtime_error("Could not update data in SQL");
+                }
+                lastRowID = rowIDs[r];
+            }
+
+            converted += n;
+            if (converted % logInterval == 0 && n != 0)
+            {
+                CLOG(INFO, "Database") << "Converted " << converted << " of "
+                                       << total << " rows of " << table.mName;
+            }
+        } while (n == batchSize);
+    }
+}
+
+void
+Database::createHistoryViews()
+{
+    // the binary tables as they would be in base64, for external readers
+    for (auto const& table : kHistoryTables)
+    {
+        std::string columns;
+        for (auto const& column : table.mColumns)
+        {
+            columns += column + ", ";
+        }
+        for (auto const& column : table.mBlobColumns)
+        {
+            columns += pgBase64(column) + " AS " + column + ", ";
+        }
+        columns.resize(columns.size() - 2);
+        mSession << "CREATE VIEW " << table.mName << "_base64 AS SELECT "
+                 << columns << " FROM " << table.mName;
+    }
+}
+
+void
+Database::dropHistoryViews()
+{
+    for (auto const& table : kHistoryTables)
+    {
+        mSession << "DROP VIEW IF EXISTS " << table.mName << "_base64";
+    }
 }
 
 void
@@ -267,6 +561,12 @@ Database::canUsePool() const
     return !(mApp.getConfig().DATABASE.value == ("sqlite3://:memory:"));
 }
 
+bool
+Database::deferLedgerWrites() const
+{
+    return mApp.getConfig().DEFERRED_LEDGER_WRITES;
+}
+
 void
 Database::clearPreparedStatementCache()
 {
@@ -280,6 +580,15 @@ Database::clearPreparedStatementCache()
     mStatementsSize.set_count(mStatements.size());
 }
 
+void
+Database::releasePreparedStatements()
+{
+    if (isSqlite())
+    {
+        clearPreparedStatementCache();
+    }
+}
+
 void
 Database::initialize()
 {
@@ -289,6 +598,7 @@ Database::initialize()
 
     // only time this section should be modified is when
     // consolidating changes found in applySchemaUpgrade here
+    dropHistoryViews();
     AccountFrame::dropAll(*this);
     OfferFrame::dropAll(*this);
     TrustFrame::dropAll(*this);
@@ -300,6 +610,9 @@ Database::initialize()
     HistoryManager::dropAll(*this);
     BucketManager::dropAll(mApp);
     putSchemaVersion(1);
+    // the new history tables are in base64, until upgradeHistoryFormat
+    mHistoryFormatKnown = true;
+    mBinaryHistory = false;
 }
 
 soci::session&
@@ -341,12 +654,24 @@ Database::getPool()
     return *mPool;
 }
 
-cache::lru_cache<std::string, std::shared_ptr<LedgerEntry const>>&
+Database::EntryCache&
 Database::getEntryCache()
 {
     return mEntryCache;
 }
 
+OrderBookCache&
+Database::getOrderBooks()
+{
+    return mOrderBooks;
+}
+
+InflationTally&
+Database::getInflationTally()
+{
+    return mInflationTally;
+}
+
 class SQLLogContext : NonCopyable
 {
     std::string mName;
@@ -404,6 +729,84 @@ Database::getPreparedStatement(std::string const& query)
     return sc;
 }
 
+StatementContext
+Database::getStatement(soci::session& sess, std::string const& query)
+{
+    auto p = std::make_shared<soci::statement>(sess);
+    p->alloc();
+    p->prepare(query);
+    StatementContext sc(p);
+    return sc;
+}
+
+std::string
+Database::getPlaceholders(size_t n)
+{
+    std::ostringstream out;
+    for (size_t i = 0; i < n; ++i)
+    {
+        out << (i == 0 ? ":v" : ", :v") << i;
+    }
+    return out.str();
+}
+
+std::string
+Database::getPlaceholders(size_t n, std::string const& pattern,
+                          std::string const& separator)
+{
+    std::ostringstream out;
+    size_t v = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+        if (i != 0)
+        {
+            out << separator;
+        }
+        for (auto c : pattern)
+        {
+            if (c == '?')
+            {
+                out << ":v" << v++;
+            }
+            else
+            {
+                out << c;
+            }
+        }
+    }
+    return out.str();
+}
+
+long long
+Database::executeBulk(
+    size_t rows, size_t columns,
+    std::function<std::string(size_t n)> const& makeQuery,
+    std::function<void(soci::statement& st, size_t row)> const& bindRow)
+{
+    // SQLite refuses statements with more than 999 bound values by default,
+    // postgres with more than 65535
+    size_t maxValues = isSqlite() ? 999 : 32767;
+    size_t chunk =
+        std::max<size_t>(1, maxValues / std::max<size_t>(columns, 1));
+    long long affected = 0;
+    for (size_t begin = 0; begin < rows; begin += chunk)
+    {
+        size_t n = std::min(chunk, rows - begin);
+        // a partial chunk only happens once per call, don't cache it
+        auto prep = n == chunk ? getPreparedStatement(makeQuery(n))
+                               : getStatement(mSession, makeQuery(n));
+        auto& st = prep.statement();
+        for (size_t row = begin; row < begin + n; ++row)
+        {
+            bindRow(st, row);
+        }
+        st.define_and_bind();
+        st.execute(true);
+        affected += st.get_affected_rows();
+    }
+    return affected;
+}
+
 std::shared_ptr<SQLLogContext>
 Database::captureAndLogSQL(std::string contextName)
 {
@@ -4,14 +4,18 @@
 // under the Apache License, Version 2.0. See the COPYING file at the root
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
+#include "ledger/InflationTally.h"
+#include "ledger/LedgerEntryCache.h"
+#include "ledger/OrderBookCache.h"
 #include "medida/timer_context.h"
 #include "overlay/StellarXDR.h"
 #include "util/NonCopyable.h"
 #include "util/SociNoWarnings.h"
 #include "util/Timer.h"
-#include "util/lrucache.hpp"
+#include <functional>
 #include <set>
 #include <string>
+#include <vector>
 
 namespace medida
 {
@@ -23,6 +27,7 @@ class Counter;
 namespace stellar
 {
 class Application;
+class Database;
 class SQLLogContext;
 
 /**
@@ -58,6 +63,36 @@ class StatementContext : NonCopyable
     }
 };
 
+/**
+ * The value of a history blob column (see Database::hasBinaryHistory), to
+ * bind to a statement with use() or into(), and set or get as bytes.
+ *
+ * In binary, SQLite gets and returns the bytes themselves, as a BLOB
+ * (soci::blob). SOCI passes every postgres parameter and result as text, so
+ * there the value is the bytea text form ("\x" and the hex of the bytes),
+ * which postgres parses into and formats from the stored bytes. In base64,
+ * the value is the base64 text.
+ */
+class HistoryBlob
+{
+    bool mBinary;
+    bool mSqlite;
+    std::unique_ptr<soci::blob> mBlob;
+    std::string mText;
+
+  public:
+    // In the format `db` stores the history in, or in binary if `binary`,
+    // for statements of session `sess`.
+    HistoryBlob(Database& db, soci::session& sess);
+    HistoryBlob(Database& db, soci::session& sess, bool binary);
+
+    void set(std::vector<uint8_t> const& bin);
+    void get(std::vector<uint8_t>& bin);
+
+    soci::details::use_type_ptr use();
+    soci::details::into_type_ptr into();
+};
+
 /**
  * Object that owns the database connection(s) that an application
  * uses to store the current ledger and other persistent state in.
@@ -92,8 +127,13 @@ class Database : NonMovableOrCopyable
     std::map<std::string, std::shared_ptr<soci::statement>> mStatements;
     medida::Counter& mStatementsSize;
 
-    cache::lru_cache<std::string, std::shared_ptr<LedgerEntry const>>
-        mEntryCache;
+    LedgerEntryCache mEntryCache;
+    OrderBookCache mOrderBooks;
+    InflationTally mInflationTally;
+
+    // see hasBinaryHistory
+    bool mHistoryFormatKnown;
+    bool mBinaryHistory;
 
     // Helpers for maintaining the total query time and calculating
     // idle percentage.
@@ -107,6 +147,13 @@ class Database : NonMovableOrCopyable
     static void registerDrivers();
     void applySchemaUpgrade(unsigned long vers);
 
+    // Convert the history blobs to the format of BINARY_HISTORY, if they
+    // aren't in it yet.
+    void upgradeHistoryFormat();
+    void convertSqliteHistory(bool binary);
+    void createHistoryViews();
+    void dropHistoryViews();
+
   public:
     // Instantiate object and connect to app.getConfig().DATABASE;
     // if there is a connection error, this will throw.
@@ -142,10 +189,43 @@ class Database : NonMovableOrCopyable
     // when the statement context is destroyed.
     StatementContext getPreparedStatement(std::string const& query);
 
+    // Return a helper for a one-off statement for the provided query on
+    // `sess`, which may be a connection other than the main one. Unlike those
+    // of getPreparedStatement, the statement is not cached.
+    static StatementContext getStatement(soci::session& sess,
+                                         std::string const& query);
+
+    // Return `n` comma-separated placeholders ":v0, :v1, ...", to build an
+    // "IN (...)" clause matching a batch of values.
+    static std::string getPlaceholders(size_t n);
+
+    // Return `n` copies of `pattern` joined by `separator`, with each "?" of
+    // the copies replaced by the next placeholder ":v0", ":v1", ... -- e.g.
+    // the rows "(?, ?)" of a multi-row "INSERT ... VALUES".
+    static std::string getPlaceholders(size_t n, std::string const& pattern,
+                                       std::string const& separator);
+
+    // Execute, for `rows` rows of `columns` values each, the statements
+    // `makeQuery(n)` over as few chunks of n rows as the backend's limit on
+    // bound values allows, calling `bindRow(st, row)` to bind the values of
+    // each row in order. Statements of full chunks are prepared once and
+    // cached. Returns the total number of affected rows.
+    long long executeBulk(
+        size_t rows, size_t columns,
+        std::function<std::string(size_t n)> const& makeQuery,
+        std::function<void(soci::statement& st, size_t row)> const& bindRow);
+
     // Purge all cached prepared statements, closing their handles with the
     // database.
     void clearPreparedStatementCache();
 
+    // Release what the cached prepared statements hold in the database, so
+    // that they don't outlive the transaction about to be committed. On
+    // SQLite, a statement not stepped through all its rows keeps a read
+    // transaction open, and SOCI can't reset one, so they are all purged;
+    // postgres statements hold no such state and are kept.
+    void releasePreparedStatements();
+
     // Return metric-gathering timers for various families of SQL operation.
     // These timers automatically count the time they are alive for,
     // so only acquire them immediately before executing an SQL statement.
@@ -166,6 +246,10 @@ class Database : NonMovableOrCopyable
     // to read from the database through, otherwise false.
     bool canUsePool() const;
 
+    // Return true if ledger entry writes are kept pending in the entry cache
+    // until the ledger is committed, see DEFERRED_LEDGER_WRITES.
+    bool deferLedgerWrites() const;
+
     // Drop and recreate all tables in the database target. This is called
     // by the --newdb command-line flag on stellar-core.
     void initialize();
@@ -179,9 +263,16 @@ class Database : NonMovableOrCopyable
     // Get current schema version of running application.
     unsigned long getAppSchemaVersion();
 
-    // Check schema version and apply any upgrades if necessary.
+    // Check schema version and apply any upgrades if necessary, then convert
+    // the history blobs to the format of BINARY_HISTORY.
     void upgradeToCurrentSchema();
 
+    // Return true if the XDR blobs of the history tables (txhistory,
+    // txfeehistory, scphistory and ledgerheaders) are stored in binary, false
+    // if they are stored as base64 text. The first call reads the format
+    // from the database, and has to be made on the main thread.
+    bool hasBinaryHistory();
+
     // Access the underlying SOCI session object
     soci::session& getSession();
 
@@ -192,9 +283,15 @@ class Database : NonMovableOrCopyable
     // Access the LedgerEntry cache. Note: clients are responsible for
     // invalidating entries in this cache as they perform statements
     // against the database. It's kept here only for ease of access.
-    typedef cache::lru_cache<std::string, std::shared_ptr<LedgerEntry const>>
-        EntryCache;
+    typedef LedgerEntryCache EntryCache;
     EntryCache& getEntryCache();
+
+    // Access the in-memory order books. Like the entry cache, it's kept
+    // coherent by the code writing offers, see OrderBookCache.
+    OrderBookCache& getOrderBooks();
+
+    // Access the tally of inflation votes, see InflationTally.
+    InflationTally& getInflationTally();
 };
 
 class DBTimeExcluder : NonCopyable
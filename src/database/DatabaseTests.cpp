@@ -5,6 +5,10 @@
 #include "util/asio.h"
 #include "database/Database.h"
 #include "crypto/Hex.h"
+#include "ledger/AccountFrame.h"
+#include "ledger/LedgerDelta.h"
+#include "ledger/LedgerManager.h"
+#include "ledger/LedgerTestUtils.h"
 #include "lib/catch.hpp"
 #include "main/Application.h"
 #include "main/Config.h"
@@ -12,6 +16,7 @@
 #include "util/Logging.h"
 #include "util/Timer.h"
 #include "util/TmpDir.h"
+#include <chrono>
 #include <random>
 
 using namespace stellar;
@@ -339,3 +344,187 @@ TEST_CASE("schema test", "[db]")
     auto av = db.getAppSchemaVersion();
     REQUIRE(dbv == av);
 }
+
+void
+checkPreparedStatementsRelease(Config const& cfg)
+{
+    VirtualClock clock;
+    Application::pointer app = Application::create(clock, cfg);
+    app->start();
+
+    auto& db = app->getDatabase();
+    auto& session = db.getSession();
+    session << "DROP TABLE IF EXISTS test";
+    session << "CREATE TABLE test (x INTEGER)";
+    session << "INSERT INTO test VALUES (1)";
+    session << "INSERT INTO test VALUES (2)";
+
+    // only steps to the first of the two rows
+    auto selectFirst = [&](soci::statement*& handle) {
+        int x = 0;
+        auto prep = db.getPreparedStatement("SELECT x FROM test ORDER BY x");
+        auto& st = prep.statement();
+        st.exchange(soci::into(x));
+        st.define_and_bind();
+        st.execute(true);
+        handle = &st;
+        return x;
+    };
+
+    soci::statement* first = nullptr;
+    soci::statement* second = nullptr;
+    REQUIRE(selectFirst(first) == 1);
+    db.releasePreparedStatements();
+    REQUIRE(selectFirst(second) == 1);
+    if (!db.isSqlite())
+    {
+        // postgres statements are kept
+        REQUIRE(first == second);
+    }
+
+    // SQLite refuses to drop a table a statement is still reading
+    db.releasePreparedStatements();
+    REQUIRE_NOTHROW(session << "DROP TABLE test");
+}
+
+TEST_CASE("sqlite prepared statements release", "[db]")
+{
+    checkPreparedStatementsRelease(
+        getTestConfig(0, Config::TESTDB_IN_MEMORY_SQLITE));
+}
+
+#ifdef USE_POSTGRES
+TEST_CASE("postgres prepared statements release", "[db]")
+{
+    checkPreparedStatementsRelease(
+        getTestConfig(0, Config::TESTDB_POSTGRESQL));
+}
+#endif
+
+TEST_CASE("bulk statements", "[db]")
+{
+    REQUIRE(Database::getPlaceholders(2, "(?, ?)", ", ") ==
+            "(:v0, :v1), (:v2, :v3)");
+    REQUIRE(Database::getPlaceholders(1, "(a = ? AND b = ?)", " OR ") ==
+            "(a = :v0 AND b = :v1)");
+
+    Config const& cfg = getTestConfig(0, Config::TESTDB_IN_MEMORY_SQLITE);
+
+    VirtualClock clock;
+    Application::pointer app = Application::create(clock, cfg);
+    app->start();
+
+    auto& db = app->getDatabase();
+    auto& session = db.getSession();
+    auto countRows = [&](std::string const& table) {
+        int n = 0;
+        session << "SELECT COUNT(*) FROM " + table, soci::into(n);
+        return n;
+    };
+    int accounts0 = countRows("accounts");
+    int signers0 = countRows("signers");
+
+    // enough rows for several full chunks and a partial one
+    size_t const nbAccounts = 1000;
+    std::vector<LedgerEntry> accounts;
+    std::vector<LedgerKey> keys;
+    int nbSigners = 0;
+    for (auto const& a :
+         LedgerTestUtils::generateValidAccountEntries(nbAccounts))
+    {
+        LedgerEntry le;
+        le.data.type(ACCOUNT);
+        le.data.account() = a;
+        accounts.emplace_back(le);
+        keys.emplace_back(LedgerEntryKey(le));
+        nbSigners += static_cast<int>(a.signers.size());
+    }
+    AccountFrame::storeAddBulk(db, accounts);
+    REQUIRE(countRows("accounts") == accounts0 + int(nbAccounts));
+    REQUIRE(countRows("signers") == signers0 + nbSigners);
+
+    auto const& a = accounts[nbAccounts / 2].data.account();
+    auto loaded = AccountFrame::loadAccount(a.accountID, db);
+    REQUIRE(loaded);
+    REQUIRE(loaded->getBalance() == a.balance);
+    REQUIRE(loaded->getSeqNum() == a.seqNum);
+    REQUIRE(loaded->getAccount().signers.size() == a.signers.size());
+
+    AccountFrame::storeDeleteBulk(db, keys);
+    REQUIRE(countRows("accounts") == accounts0);
+    REQUIRE(countRows("signers") == signers0);
+}
+
+#ifdef USE_POSTGRES
+TEST_CASE("prepared statement reuse bench", "[db][bench][hide]")
+{
+    // SQLite statements are purged at each commit either way
+    Config const& cfg = getTestConfig(0, Config::TESTDB_POSTGRESQL);
+
+    VirtualClock clock;
+    Application::pointer app = Application::create(clock, cfg);
+    app->start();
+
+    auto& db = app->getDatabase();
+    size_t const nbAccounts = 10000;
+    std::vector<LedgerEntry> accounts;
+    for (auto const& a :
+         LedgerTestUtils::generateValidAccountEntries(nbAccounts))
+    {
+        LedgerEntry le;
+        le.data.type(ACCOUNT);
+        le.data.account() = a;
+        accounts.emplace_back(le);
+    }
+    AccountFrame::storeAddBulk(db, accounts);
+
+    // loads and updates accounts in ledgers of 100, dropping the prepared
+    // statements at each ledger close or keeping them
+    size_t next = 0;
+    auto closeLedgers = [&](bool keepStatements) {
+        size_t const nbLedgers = 100;
+        size_t const nbOps = 100;
+        std::chrono::nanoseconds selectTime(0);
+        std::chrono::nanoseconds updateTime(0);
+        for (size_t l = 0; l < nbLedgers; ++l)
+        {
+            soci::transaction sqlTx(db.getSession());
+            LedgerDelta delta(app->getLedgerManager().getCurrentLedgerHeader(),
+                              db);
+            for (size_t i = 0; i < nbOps; ++i)
+            {
+                auto const& id =
+                    accounts[next++ % nbAccounts].data.account().accountID;
+                db.getEntryCache().clear();
+                auto start = std::chrono::steady_clock::now();
+                auto account = AccountFrame::loadAccount(id, db);
+                auto loaded = std::chrono::steady_clock::now();
+                account->storeChange(delta, db);
+                updateTime += std::chrono::steady_clock::now() - loaded;
+                selectTime += loaded - start;
+            }
+            delta.commit();
+            if (keepStatements)
+            {
+                db.releasePreparedStatements();
+            }
+            else
+            {
+                db.clearPreparedStatementCache();
+            }
+            sqlTx.commit();
+        }
+        LOG(INFO) << (keepStatements ? "Keeping" : "Dropping")
+                  << " prepared statements: SELECT "
+                  << selectTime.count() / (nbLedgers * nbOps)
+                  << "ns, UPDATE "
+                  << updateTime.count() / (nbLedgers * nbOps) << "ns";
+    };
+
+    for (int i = 0; i < 3; ++i)
+    {
+        closeLedgers(false);
+        closeLedgers(true);
+    }
+}
+#endif
@@ -103,6 +103,18 @@ class Herder
     virtual bool recvTxSet(Hash const& hash, TxSetFrame const& txset) = 0;
     // We are learning about a new transaction.
     virtual TransactionSubmitStatus recvTransaction(TransactionFramePtr tx) = 0;
+    // Same as recvTransaction, for transactions received from peers: the
+    // hashes, signatures and source accounts of `tx` are checked on a worker
+    // thread first, then `handler` gets the status of recvTransaction on the
+    // main thread. The transactions of a source account get there in the
+    // order they were received. Returns false, without taking `tx`, if
+    // TX_ADMISSION_QUEUE_SIZE transactions are already being checked.
+    virtual bool recvTransactionAsync(
+        TransactionFramePtr tx,
+        std::function<void(TransactionSubmitStatus)> handler) = 0;
+    // Call `f` on the main thread once recvTransactionAsync has room for
+    // another transaction.
+    virtual void waitForTxAdmission(std::function<void()> f) = 0;
     virtual void peerDoesntHave(stellar::MessageType type,
                                 uint256 const& itemID, PeerPtr peer) = 0;
     virtual TxSetFramePtr getTxSet(Hash const& hash) = 0;
@@ -6,9 +6,12 @@
 #include "crypto/Hex.h"
 #include "crypto/KeyUtils.h"
 #include "crypto/SHA.h"
+#include "crypto/SecretKey.h"
+#include "database/Database.h"
 #include "herder/HerderUtils.h"
 #include "herder/LedgerCloseData.h"
 #include "herder/TxSetFrame.h"
+#include "ledger/AccountFrame.h"
 #include "ledger/LedgerManager.h"
 #include "lib/json/json.h"
 #include "main/Application.h"
@@ -28,6 +31,7 @@
 #include "util/basen.h"
 #include "xdrpp/marshal.h"
 
+#include <algorithm>
 #include <ctime>
 
 using namespace std;
@@ -97,13 +101,17 @@ HerderImpl::SCPMetrics::SCPMetrics(Application& app)
           app.getMetrics().NewCounter({"herder", "pending-txs", "age2"}))
     , mHerderPendingTxs3(
           app.getMetrics().NewCounter({"herder", "pending-txs", "age3"}))
+    , mTxAdmissionQueue(
+          app.getMetrics().NewCounter({"herder", "tx-admission", "queue"}))
+    , mTxAdmissionFull(app.getMetrics().NewMeter(
+          {"herder", "tx-admission", "full"}, "transaction"))
 {
 }
 
 HerderImpl::HerderImpl(Application& app)
     : mSCP(*this, app.getConfig().NODE_SEED, app.getConfig().NODE_IS_VALIDATOR,
            app.getConfig().QUORUM_SET)
-    , mPendingTransactions(4)
+    , mTxSetValiditySlot(0)
     , mPendingEnvelopes(app, *this)
     , mLastSlotSaved(0)
     , mLastStateChange(app.getClock().now())
@@ -111,6 +119,7 @@ HerderImpl::HerderImpl(Application& app)
     , mLastTrigger(app.getClock().now())
     , mTriggerTimer(app)
     , mRebroadcastTimer(app)
+    , mTxAdmissions(std::make_shared<TxAdmissions>())
     , mApp(app)
     , mLedgerManager(app.getLedgerManager())
     , mSCPMetrics(app)
@@ -263,7 +272,7 @@ HerderImpl::validateValueHelper(uint64 slotIndex, StellarValue const& b)
 
         res = SCPDriver::kInvalidValue;
     }
-    else if (!txSet->checkValid(mApp))
+    else if (!checkTxSetValid(slotIndex, txSetHash, *txSet))
     {
         if (Logging::logDebug("Herder"))
             CLOG(DEBUG, "Herder") << "HerderImpl::validateValue"
@@ -283,6 +292,25 @@ HerderImpl::validateValueHelper(uint64 slotIndex, StellarValue const& b)
     return res;
 }
 
+bool
+HerderImpl::checkTxSetValid(uint64 slotIndex, Hash const& txSetHash,
+                            TxSetFrame const& txSet)
+{
+    if (mTxSetValiditySlot != slotIndex)
+    {
+        mTxSetValidity.clear();
+        mTxSetValiditySlot = slotIndex;
+    }
+    auto it = mTxSetValidity.find(txSetHash);
+    if (it != mTxSetValidity.end())
+    {
+        return it->second;
+    }
+    bool valid = txSet.checkValid(mApp, &mTxValidity);
+    mTxSetValidity.emplace(txSetHash, valid);
+    return valid;
+}
+
 bool
 HerderImpl::validateUpgradeStep(uint64 slotIndex, UpgradeType const& upgrade,
                                 LedgerUpgradeType& upgradeType)
@@ -489,34 +517,6 @@ HerderImpl::updateSCPCounters()
         mSCP.getCumulativeStatemtCount());
 }
 
-static uint64_t
-countTxs(HerderImpl::AccountTxMap const& acc)
-{
-    uint64_t sz = 0;
-    for (auto const& a : acc)
-    {
-        sz += a.second->mTransactions.size();
-    }
-    return sz;
-}
-
-static std::shared_ptr<HerderImpl::TxMap>
-findOrAdd(HerderImpl::AccountTxMap& acc, AccountID const& aid)
-{
-    std::shared_ptr<HerderImpl::TxMap> txmap = nullptr;
-    auto i = acc.find(aid);
-    if (i == acc.end())
-    {
-        txmap = std::make_shared<HerderImpl::TxMap>();
-        acc.insert(std::make_pair(aid, txmap));
-    }
-    else
-    {
-        txmap = i->second;
-    }
-    return txmap;
-}
-
 void
 HerderImpl::logQuorumInformation(uint64 index)
 {
@@ -736,8 +736,8 @@ HerderImpl::combineCandidates(uint64 slotIndex,
     // take the txSet with the highest number of transactions,
     // highest xored hash that we have
     TxSetFramePtr bestTxSet;
+    Hash highest;
     {
-        Hash highest;
         TxSetFramePtr highestTxSet;
         for (auto const& sv : candidateValues)
         {
@@ -769,8 +769,12 @@ HerderImpl::combineCandidates(uint64 slotIndex,
 
     std::vector<TransactionFramePtr> removed;
 
-    // just to be sure
-    bestTxSet->trimInvalid(mApp, removed);
+    // just to be sure; the candidates were validated for this slot already,
+    // so this is normally remembered
+    if (!checkTxSetValid(slotIndex, highest, *bestTxSet))
+    {
+        bestTxSet->trimInvalid(mApp, removed);
+    }
     comp.txSetHash = bestTxSet->getContentsHash();
 
     if (removed.size() != 0)
@@ -870,31 +874,6 @@ HerderImpl::emitEnvelope(SCPEnvelope const& envelope)
     startRebroadcastTimer();
 }
 
-void
-HerderImpl::TxMap::addTx(TransactionFramePtr tx)
-{
-    auto const& h = tx->getFullHash();
-    if (mTransactions.find(h) != mTransactions.end())
-    {
-        return;
-    }
-    mTransactions.insert(std::make_pair(h, tx));
-    mMaxSeq = std::max(tx->getSeqNum(), mMaxSeq);
-    mTotalFees += tx->getFee();
-}
-
-void
-HerderImpl::TxMap::recalculate()
-{
-    mMaxSeq = 0;
-    mTotalFees = 0;
-    for (auto const& pair : mTransactions)
-    {
-        mMaxSeq = std::max(pair.second->getSeqNum(), mMaxSeq);
-        mTotalFees += pair.second->getFee();
-    }
-}
-
 Herder::TransactionSubmitStatus
 HerderImpl::recvTransaction(TransactionFramePtr tx)
 {
@@ -906,24 +885,12 @@ HerderImpl::recvTransaction(TransactionFramePtr tx)
 
     // determine if we have seen this tx before and if not if it has the right
     // seq num
-    int64_t totFee = tx->getFee();
-    SequenceNumber highSeq = 0;
-
-    for (auto& map : mPendingTransactions)
+    if (mPendingTransactions.contains(tx))
     {
-        auto i = map.find(acc);
-        if (i != map.end())
-        {
-            auto& txmap = i->second;
-            auto j = txmap->mTransactions.find(txID);
-            if (j != txmap->mTransactions.end())
-            {
-                return TX_STATUS_DUPLICATE;
-            }
-            totFee += txmap->mTotalFees;
-            highSeq = std::max(highSeq, txmap->mMaxSeq);
-        }
+        return TX_STATUS_DUPLICATE;
     }
+    int64_t totFee = tx->getFee() + mPendingTransactions.getTotalFees(acc);
+    SequenceNumber highSeq = mPendingTransactions.getMaxSeq(acc);
 
     if (!tx->checkValid(mApp, highSeq))
     {
@@ -940,12 +907,194 @@ HerderImpl::recvTransaction(TransactionFramePtr tx)
         CLOG(TRACE, "Herder") << "recv transaction " << hexAbbrev(txID)
                               << " for " << KeyUtils::toShortString(acc);
 
-    auto txmap = findOrAdd(mPendingTransactions[0], acc);
-    txmap->addTx(tx);
+    mPendingTransactions.add(tx, tx->getFeeRatio(mLedgerManager));
 
     return TX_STATUS_PENDING;
 }
 
+// Runs on a worker thread before a transaction from a peer is admitted.
+// Warms the hash cache of `tx` and the signature verification cache, so that
+// recvTransaction finds them. Through `pool`, when there is one, it also
+// loads the source accounts as last committed, to know their signers and to
+// reject a transaction whose sequence number is already used. Returns
+// txSUCCESS if `tx` can go on to recvTransaction.
+static TransactionResultCode
+checkTxAdmission(TransactionFramePtr const& tx, soci::connection_pool* pool,
+                 bool isSqlite)
+{
+    tx->getFullHash();
+
+    std::vector<AccountEntry> accounts;
+    bool loaded = false;
+    if (pool)
+    {
+        try
+        {
+            soci::session sess(*pool);
+            soci::transaction sqlTx(sess);
+            if (!isSqlite)
+            {
+                sess << "SET TRANSACTION READ ONLY";
+            }
+            std::vector<LedgerKey> keys;
+            for (auto const& accountID : tx->getSourceAccountIDs())
+            {
+                LedgerKey key;
+                key.type(ACCOUNT);
+                key.account().accountID = accountID;
+                keys.emplace_back(key);
+            }
+            AccountFrame::loadEntries(
+                sess, keys, [&accounts](LedgerEntry const& le) {
+                    accounts.emplace_back(le.data.account());
+                });
+            loaded = true;
+        }
+        catch (std::exception& e)
+        {
+            // recvTransaction checks the transaction anyway
+            CLOG(WARNING, "Herder")
+                << "Could not load the source accounts of a transaction: "
+                << e.what();
+        }
+    }
+
+    std::vector<PubKeyUtils::SigToVerify> sigs;
+    tx->insertSignaturesToVerify(accounts, sigs);
+    for (auto const& sig : sigs)
+    {
+        PubKeyUtils::verifySig(sig.mKey, sig.mSignature, sig.mBin);
+    }
+
+    if (!loaded)
+    {
+        return txSUCCESS;
+    }
+    auto source = std::find_if(accounts.begin(), accounts.end(),
+                               [&tx](AccountEntry const& account) {
+                                   return account.accountID ==
+                                          tx->getSourceID();
+                               });
+    if (source == accounts.end())
+    {
+        return txNO_ACCOUNT;
+    }
+    // sequence numbers only grow: the transaction can't become valid later
+    if (tx->getSeqNum() <= source->seqNum)
+    {
+        return txBAD_SEQ;
+    }
+    return txSUCCESS;
+}
+
+bool
+HerderImpl::recvTransactionAsync(
+    TransactionFramePtr tx,
+    std::function<void(TransactionSubmitStatus)> handler)
+{
+    auto maxAdmissions = mApp.getConfig().TX_ADMISSION_QUEUE_SIZE;
+    if (maxAdmissions == 0)
+    {
+        handler(recvTransaction(tx));
+        return true;
+    }
+    auto& admissions = *mTxAdmissions;
+    if (admissions.mSize >= maxAdmissions)
+    {
+        mSCPMetrics.mTxAdmissionFull.Mark();
+        return false;
+    }
+    auto admission = std::make_shared<TxAdmission>();
+    admission->mTx = tx;
+    admission->mHandler = handler;
+    admissions.mQueues[tx->getSourceID()].push_back(admission);
+    ++admissions.mSize;
+    mSCPMetrics.mTxAdmissionQueue.set_count(admissions.mSize);
+
+    // the pool is created when first used, which must be on the main thread
+    auto& db = mApp.getDatabase();
+    soci::connection_pool* pool = db.canUsePool() ? &db.getPool() : nullptr;
+    bool isSqlite = db.isSqlite();
+
+    std::weak_ptr<TxAdmissions> weak = mTxAdmissions;
+    auto& mainIO = mApp.getClock().getIOService();
+    mApp.getWorkerIOService().post(
+        [this, tx, pool, isSqlite, admission, weak, &mainIO]() {
+            auto error = checkTxAdmission(tx, pool, isSqlite);
+            mainIO.post([this, admission, error, weak]() {
+                if (weak.expired())
+                {
+                    return;
+                }
+                admission->mChecked = true;
+                admission->mError = error;
+                admitTxs(admission->mTx->getSourceID());
+            });
+        });
+    return true;
+}
+
+void
+HerderImpl::admitTxs(AccountID const& accountID)
+{
+    auto& admissions = *mTxAdmissions;
+    auto queue = admissions.mQueues.find(accountID);
+    if (queue == admissions.mQueues.end())
+    {
+        return;
+    }
+
+    // taken out first, as the handlers may receive more transactions
+    std::vector<TxAdmissionPtr> ready;
+    auto& txs = queue->second;
+    while (!txs.empty() && txs.front()->mChecked)
+    {
+        ready.push_back(txs.front());
+        txs.pop_front();
+    }
+    if (txs.empty())
+    {
+        admissions.mQueues.erase(queue);
+    }
+    admissions.mSize -= ready.size();
+    mSCPMetrics.mTxAdmissionQueue.set_count(admissions.mSize);
+
+    for (auto const& admission : ready)
+    {
+        TransactionSubmitStatus status;
+        if (admission->mError != txSUCCESS)
+        {
+            admission->mTx->getResult().result.code(admission->mError);
+            status = TX_STATUS_ERROR;
+        }
+        else
+        {
+            status = recvTransaction(admission->mTx);
+        }
+        admission->mHandler(status);
+
+        if (!admissions.mWaiting.empty())
+        {
+            mApp.getClock().getIOService().post(admissions.mWaiting.front());
+            admissions.mWaiting.pop_front();
+        }
+    }
+}
+
+void
+HerderImpl::waitForTxAdmission(std::function<void()> f)
+{
+    auto maxAdmissions = mApp.getConfig().TX_ADMISSION_QUEUE_SIZE;
+    if (maxAdmissions == 0 || mTxAdmissions->mSize < maxAdmissions)
+    {
+        mApp.getClock().getIOService().post(f);
+    }
+    else
+    {
+        mTxAdmissions->mWaiting.push_back(f);
+    }
+}
+
 Herder::EnvelopeStatus
 HerderImpl::recvSCPEnvelope(SCPEnvelope const& envelope)
 {
@@ -1174,49 +1323,6 @@ HerderImpl::ledgerClosed()
                                  &VirtualTimer::onFailureNoop);
 }
 
-void
-HerderImpl::removeReceivedTxs(std::vector<TransactionFramePtr> const& dropTxs)
-{
-    for (auto& m : mPendingTransactions)
-    {
-        if (m.empty())
-        {
-            continue;
-        }
-
-        std::set<std::shared_ptr<TxMap>> toRecalculate;
-
-        for (auto const& tx : dropTxs)
-        {
-            auto const& acc = tx->getSourceID();
-            auto const& txID = tx->getFullHash();
-            auto i = m.find(acc);
-            if (i != m.end())
-            {
-                auto& txs = i->second->mTransactions;
-                auto j = txs.find(txID);
-                if (j != txs.end())
-                {
-                    txs.erase(j);
-                    if (txs.empty())
-                    {
-                        m.erase(i);
-                    }
-                    else
-                    {
-                        toRecalculate.insert(i->second);
-                    }
-                }
-            }
-        }
-
-        for (auto txm : toRecalculate)
-        {
-            txm->recalculate();
-        }
-    }
-}
-
 bool
 HerderImpl::recvSCPQuorumSet(Hash const& hash, const SCPQuorumSet& qset)
 {
@@ -1268,17 +1374,7 @@ HerderImpl::getCurrentLedgerSeq() const
 SequenceNumber
 HerderImpl::getMaxSeqInPendingTxs(AccountID const& acc)
 {
-    SequenceNumber highSeq = 0;
-    for (auto const& m : mPendingTransactions)
-    {
-        auto i = m.find(acc);
-        if (i == m.end())
-        {
-            continue;
-        }
-        highSeq = std::max(i->second->mMaxSeq, highSeq);
-    }
-    return highSeq;
+    return mPendingTransactions.getMaxSeq(acc);
 }
 
 // called to take a position during the next round
@@ -1294,32 +1390,22 @@ HerderImpl::triggerNextLedger(uint32_t ledgerSeqToTrigger)
     }
     updateSCPCounters();
 
-    // our first choice for this round's set is all the tx we have collected
-    // during last ledger close
+    // our choice for this round's set is the valid tx we have collected that
+    // pay the most, as many as fit in a set
     auto const& lcl = mLedgerManager.getLastClosedLedgerHeader();
     TxSetFramePtr proposedSet = std::make_shared<TxSetFrame>(lcl.hash);
 
-    for (auto const& m : mPendingTransactions)
     {
-        for (auto const& pair : m)
-        {
-            for (auto const& tx : pair.second->mTransactions)
-            {
-                proposedSet->add(tx.second);
-            }
-        }
-    }
-
-    std::vector<TransactionFramePtr> removed;
-    proposedSet->trimInvalid(mApp, removed);
-    removeReceivedTxs(removed);
-
-    proposedSet->surgePricingFilter(mLedgerManager);
-
-    if (!proposedSet->checkValid(mApp))
-    {
-        throw std::runtime_error("wanting to emit an invalid txSet");
+        soci::transaction sqltx(mApp.getDatabase().getSession());
+        mApp.getDatabase().setCurrentTransactionReadOnly();
+        mPendingTransactions.fillTxSet(
+            *proposedSet, mLedgerManager.getMaxTxSetSize(),
+            [this](std::vector<TransactionFramePtr>& txs,
+                   std::vector<TransactionFramePtr>& trimmed) {
+                TxSetFrame::trimInvalidAccountTxs(mApp, txs, trimmed);
+            });
     }
+    proposedSet->sortForHash();
 
     auto txSetHash = proposedSet->getContentsHash();
 
@@ -1327,6 +1413,11 @@ HerderImpl::triggerNextLedger(uint32_t ledgerSeqToTrigger)
     // the last closed ledger stored in ledger manager
     uint32_t slotIndex = lcl.header.ledgerSeq + 1;
 
+    if (!checkTxSetValid(slotIndex, txSetHash, *proposedSet))
+    {
+        throw std::runtime_error("wanting to emit an invalid txSet");
+    }
+
     // Inform the item fetcher so queries from other peers about his txSet
     // can be answered. Note this can trigger SCP callbacks, externalize, etc
     // if we happen to build a txset that we were trying to download.
@@ -1644,30 +1735,19 @@ void
 HerderImpl::updatePendingTransactions(
     std::vector<TransactionFramePtr> const& applied)
 {
-    // remove all these tx from mPendingTransactions
-    removeReceivedTxs(applied);
-
-    // drop the highest level
-    mPendingTransactions.erase(--mPendingTransactions.end());
-
-    // shift entries up
-    mPendingTransactions.emplace_front();
+    // remove all these tx from mPendingTransactions, drop the oldest ones
+    // and age the others
+    mPendingTransactions.ledgerClosed(applied);
 
     // rebroadcast entries, sorted in apply-order to maximize chances of
     // propagation
     {
         Hash h;
         TxSetFrame toBroadcast(h);
-        for (auto const& l : mPendingTransactions)
-        {
-            for (auto const& pair : l)
-            {
-                for (auto const& tx : pair.second->mTransactions)
-                {
-                    toBroadcast.add(tx.second);
-                }
-            }
-        }
+        mPendingTransactions.forEach(
+            [&toBroadcast](TransactionFramePtr const& tx) {
+                toBroadcast.add(tx);
+            });
         for (auto tx : toBroadcast.sortForApply())
         {
             auto msg = tx->toStellarMessage();
@@ -1675,10 +1755,10 @@ HerderImpl::updatePendingTransactions(
         }
     }
 
-    mSCPMetrics.mHerderPendingTxs0.set_count(countTxs(mPendingTransactions[0]));
-    mSCPMetrics.mHerderPendingTxs1.set_count(countTxs(mPendingTransactions[1]));
-    mSCPMetrics.mHerderPendingTxs2.set_count(countTxs(mPendingTransactions[2]));
-    mSCPMetrics.mHerderPendingTxs3.set_count(countTxs(mPendingTransactions[3]));
+    mSCPMetrics.mHerderPendingTxs0.set_count(mPendingTransactions.size(0));
+    mSCPMetrics.mHerderPendingTxs1.set_count(mPendingTransactions.size(1));
+    mSCPMetrics.mHerderPendingTxs2.set_count(mPendingTransactions.size(2));
+    mSCPMetrics.mHerderPendingTxs3.set_count(mPendingTransactions.size(3));
 }
 
 void
@@ -1736,8 +1816,8 @@ HerderImpl::saveSCPHistory(uint64 index)
 
             auto envelopeBytes(xdr::xdr_to_opaque(e));
 
-            std::string envelopeEncoded;
-            envelopeEncoded = bn::encode_b64(envelopeBytes);
+            HistoryBlob envelopeEncoded(db, db.getSession());
+            envelopeEncoded.set(envelopeBytes);
 
             auto prepEnv =
                 db.getPreparedStatement("INSERT INTO scphistory "
@@ -1747,7 +1827,7 @@ HerderImpl::saveSCPHistory(uint64 index)
             auto& st = prepEnv.statement();
             st.exchange(use(nodeIDStrKey));
             st.exchange(use(seq));
-            st.exchange(use(envelopeEncoded));
+            st.exchange(envelopeEncoded.use());
             st.define_and_bind();
             {
                 auto timer = db.getInsertTimer("scphistory");
@@ -1834,14 +1914,14 @@ Herder::copySCPHistoryToStream(Database& db, soci::session& sess,
 
         // fetch SCP messages from history
         {
-            std::string envB64;
+            HistoryBlob envEncoded(db, sess);
 
             auto timer = db.getSelectTimer("scphistory");
 
             soci::statement st =
                 (sess.prepare << "SELECT envelope FROM scphistory "
                                  "WHERE ledgerseq = :cur ORDER BY nodeid",
-                 into(envB64), use(curLedgerSeq));
+                 envEncoded.into(), use(curLedgerSeq));
 
             st.execute(true);
 
@@ -1851,7 +1931,7 @@ Herder::copySCPHistoryToStream(Database& db, soci::session& sess,
                 auto& env = curEnvs.back();
 
                 std::vector<uint8_t> envBytes;
-                bn::decode_b64(envB64, envBytes);
+                envEncoded.get(envBytes);
 
                 xdr::xdr_get g1(&envBytes.front(), &envBytes.back() + 1);
                 xdr_argpack_archive(g1, env);
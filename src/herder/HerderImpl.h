@@ -6,6 +6,7 @@
 
 #include "PendingEnvelopes.h"
 #include "herder/Herder.h"
+#include "herder/PendingTransactions.h"
 #include "scp/SCP.h"
 #include "util/Timer.h"
 #include <deque>
@@ -95,6 +96,10 @@ class HerderImpl : public Herder, public SCPDriver
     void acceptedCommit(uint64 slotIndex, SCPBallot const& ballot) override;
 
     TransactionSubmitStatus recvTransaction(TransactionFramePtr tx) override;
+    bool recvTransactionAsync(
+        TransactionFramePtr tx,
+        std::function<void(TransactionSubmitStatus)> handler) override;
+    void waitForTxAdmission(std::function<void()> f) override;
 
     EnvelopeStatus recvSCPEnvelope(SCPEnvelope const& envelope) override;
 
@@ -121,20 +126,9 @@ class HerderImpl : public Herder, public SCPDriver
     void dumpQuorumInfo(Json::Value& ret, NodeID const& id, bool summary,
                         uint64 index) override;
 
-    struct TxMap
-    {
-        SequenceNumber mMaxSeq{0};
-        int64_t mTotalFees{0};
-        std::unordered_map<Hash, TransactionFramePtr> mTransactions;
-        void addTx(TransactionFramePtr);
-        void recalculate();
-    };
-    typedef std::unordered_map<AccountID, std::shared_ptr<TxMap>> AccountTxMap;
-
   private:
     void logQuorumInformation(uint64 index);
     void ledgerClosed();
-    void removeReceivedTxs(std::vector<TransactionFramePtr> const& txs);
 
     void saveSCPHistory(uint64 index);
 
@@ -144,6 +138,10 @@ class HerderImpl : public Herder, public SCPDriver
                              LedgerUpgradeType& upgradeType);
     SCPDriver::ValidationLevel validateValueHelper(uint64 slotIndex,
                                                    StellarValue const& sv);
+    // TxSetFrame::checkValid for the set with `txSetHash`, remembered for the
+    // rest of `slotIndex`
+    bool checkTxSetValid(uint64 slotIndex, Hash const& txSetHash,
+                         TxSetFrame const& txSet);
 
     void startRebroadcastTimer();
     void rebroadcast();
@@ -157,11 +155,15 @@ class HerderImpl : public Herder, public SCPDriver
     // this slot
     bool isSlotCompatibleWithCurrentState(uint64 slotIndex);
 
-    // 0- tx we got during ledger close
-    // 1- one ledger ago. rebroadcast
-    // 2- two ledgers ago. rebroadcast
-    // ...
-    std::deque<AccountTxMap> mPendingTransactions;
+    // transactions received, not yet in a ledger; those received one ledger
+    // ago or more are rebroadcast
+    PendingTransactions mPendingTransactions;
+
+    // transaction sets checked for mTxSetValiditySlot, and the transactions
+    // they held that were found valid
+    uint64 mTxSetValiditySlot;
+    std::unordered_map<Hash, bool> mTxSetValidity;
+    TxValidityCache mTxValidity;
 
     void
     updatePendingTransactions(std::vector<TransactionFramePtr> const& applied);
@@ -240,6 +242,35 @@ class HerderImpl : public Herder, public SCPDriver
     // indexed by slotIndex, timerID
     std::map<uint64, std::map<int, std::unique_ptr<VirtualTimer>>> mSCPTimers;
 
+    // A transaction given to recvTransactionAsync. It is checked on a
+    // worker thread, then waits for the transactions of the same source
+    // account received before it to be admitted.
+    struct TxAdmission
+    {
+        TransactionFramePtr mTx;
+        std::function<void(TransactionSubmitStatus)> mHandler;
+        bool mChecked{false};
+        // set by the check when the source account can't take `mTx`
+        TransactionResultCode mError{txSUCCESS};
+    };
+    typedef std::shared_ptr<TxAdmission> TxAdmissionPtr;
+
+    struct TxAdmissions
+    {
+        size_t mSize{0};
+        // in the order they were received, per source account
+        std::unordered_map<AccountID, std::deque<TxAdmissionPtr>> mQueues;
+        std::deque<std::function<void()>> mWaiting;
+    };
+
+    // The checks only hold a weak pointer to it, so that they are dropped
+    // once the herder is gone.
+    std::shared_ptr<TxAdmissions> mTxAdmissions;
+
+    // Admit, in order, the checked transactions at the front of the queue
+    // of `accountID`.
+    void admitTxs(AccountID const& accountID);
+
     Application& mApp;
     LedgerManager& mLedgerManager;
 
@@ -287,6 +318,10 @@ class HerderImpl : public Herder, public SCPDriver
         medida::Counter& mHerderPendingTxs2;
         medida::Counter& mHerderPendingTxs3;
 
+        // Transactions from peers being checked before recvTransaction
+        medida::Counter& mTxAdmissionQueue;
+        medida::Meter& mTxAdmissionFull;
+
         SCPMetrics(Application& app);
     };
 
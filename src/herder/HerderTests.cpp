@@ -3,8 +3,12 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "herder/HerderImpl.h"
+#include "herder/PendingTransactions.h"
 #include "main/Application.h"
 #include "main/Config.h"
+#include "medida/counter.h"
+#include "medida/meter.h"
+#include "medida/metrics_registry.h"
 #include "scp/SCP.h"
 #include "simulation/Simulation.h"
 #include "test/TestAccount.h"
@@ -19,6 +23,10 @@
 #include "overlay/OverlayManager.h"
 #include "simulation/Simulation.h"
 #include "test/TxTests.h"
+#include "util/Logging.h"
+#include "util/Math.h"
+#include <algorithm>
+#include <chrono>
 
 #include "xdrpp/marshal.h"
 
@@ -285,7 +293,7 @@ TEST_CASE("txset", "[herder]")
                 REQUIRE(txSet->checkValid(*app));
             }
         }
-        SECTION("insuficient balance")
+        SECTION("insufficient balance")
         {
             // extra transaction would push the account below the reserve
             txSet->add(createPaymentTx(networkID, sourceAccount, accounts[0],
@@ -299,6 +307,62 @@ TEST_CASE("txset", "[herder]")
             REQUIRE(txSet->checkValid(*app));
         }
     }
+    SECTION("contents hash")
+    {
+        auto hash = txSet->getContentsHash();
+        auto hasher = SHA256::create();
+        hasher->add(txSet->previousLedgerHash());
+        for (auto const& tx : txSet->mTransactions)
+        {
+            hasher->add(xdr::xdr_to_opaque(tx->getEnvelope()));
+        }
+        REQUIRE(hash == hasher->finish());
+    }
+    SECTION("validity cache")
+    {
+        txSet->sortForHash();
+        TxValidityCache cache;
+        REQUIRE(txSet->checkValid(*app, &cache));
+        REQUIRE(cache.size() == txSet->size());
+        REQUIRE(txSet->checkValid(*app, &cache));
+
+        SECTION("sequence gap")
+        {
+            // the cached transactions were only valid after the first one
+            auto first = std::min_element(
+                txSet->mTransactions.begin(), txSet->mTransactions.end(),
+                [](TransactionFramePtr const& a, TransactionFramePtr const& b) {
+                    return a->getSeqNum() < b->getSeqNum();
+                });
+            txSet->mTransactions.erase(first);
+            REQUIRE(!txSet->checkValid(*app, &cache));
+        }
+        SECTION("insufficient balance")
+        {
+            txSet->add(createPaymentTx(networkID, sourceAccount, accounts[0],
+                                       sourceAccount.nextSequenceNumber(),
+                                       paymentAmount));
+            txSet->sortForHash();
+            REQUIRE(!txSet->checkValid(*app, &cache));
+        }
+        SECTION("eviction")
+        {
+            // a full cache forgets the oldest half of its transactions
+            auto const& txs = txSet->mTransactions;
+            TxValidityCache small(4);
+            for (size_t i = 0; i < 5; ++i)
+            {
+                small.add(txs[i], TxValidityCache::ValidTx{0, 0});
+            }
+            REQUIRE(small.size() == 3);
+            REQUIRE(!small.contains(txs[0]));
+            REQUIRE(!small.contains(txs[1]));
+            for (size_t i = 2; i < 5; ++i)
+            {
+                REQUIRE(small.contains(txs[i]));
+            }
+        }
+    }
 }
 
 // under surge
@@ -429,6 +493,299 @@ TEST_CASE("surge", "[herder]")
     }
 }
 
+TEST_CASE("pending transactions", "[herder]")
+{
+    Hash networkID = sha256(getTestConfig().NETWORK_PASSPHRASE);
+    auto a = getAccount("a");
+    auto b = getAccount("b");
+    auto c = getAccount("c");
+    auto dest = getAccount("dest");
+
+    auto a1 = createPaymentTx(networkID, a, dest, 1, 1000);
+    auto a2 = createPaymentTx(networkID, a, dest, 2, 1000);
+    auto b1 = createPaymentTx(networkID, b, dest, 1, 1000);
+    auto c1 = createPaymentTx(networkID, c, dest, 1, 1000);
+    auto c2 = createPaymentTx(networkID, c, dest, 2, 1000);
+
+    PendingTransactions pending;
+    REQUIRE(pending.add(a1, 1.0));
+    REQUIRE(pending.add(a2, 1.0));
+    REQUIRE(pending.add(b1, 3.0));
+    REQUIRE(pending.add(c1, 2.0));
+    REQUIRE(pending.add(c2, 0.5));
+    REQUIRE(!pending.add(createPaymentTx(networkID, a, dest, 2, 2000), 1.0));
+
+    REQUIRE(pending.size() == 5);
+    REQUIRE(pending.size(0) == 5);
+    REQUIRE(pending.contains(a2));
+    REQUIRE(pending.getMaxSeq(a.getPublicKey()) == 2);
+    REQUIRE(pending.getMaxSeq(dest.getPublicKey()) == 0);
+    REQUIRE(pending.getTotalFees(c.getPublicKey()) ==
+            c1->getFee() + c2->getFee());
+
+    auto keepAll = [](std::vector<TransactionFramePtr>&,
+                      std::vector<TransactionFramePtr>&) {};
+    Hash h;
+
+    SECTION("accounts paying the most first")
+    {
+        TxSetFrame txSet(h);
+        pending.fillTxSet(txSet, 10, keepAll);
+        std::vector<TransactionFramePtr> expected{b1, a1, a2, c1, c2};
+        REQUIRE(txSet.mTransactions == expected);
+
+        TxSetFrame small(h);
+        pending.fillTxSet(small, 2, keepAll);
+        expected = {b1, a1};
+        REQUIRE(small.mTransactions == expected);
+    }
+
+    SECTION("trimmed transactions are removed")
+    {
+        TxSetFrame txSet(h);
+        pending.fillTxSet(txSet, 10,
+                          [&](std::vector<TransactionFramePtr>& txs,
+                              std::vector<TransactionFramePtr>& trimmed) {
+                              if (txs.front()->getSourceID() ==
+                                  a.getPublicKey())
+                              {
+                                  trimmed.insert(trimmed.end(), txs.begin(),
+                                                 txs.end());
+                                  txs.clear();
+                              }
+                          });
+        std::vector<TransactionFramePtr> expected{b1, c1, c2};
+        REQUIRE(txSet.mTransactions == expected);
+        REQUIRE(pending.size() == 3);
+        REQUIRE(!pending.contains(a1));
+        REQUIRE(pending.getTotalFees(a.getPublicKey()) == 0);
+    }
+
+    SECTION("ledger close")
+    {
+        // c2 is left, and now ranks c with its own fee ratio
+        pending.ledgerClosed({c1});
+        REQUIRE(pending.size() == 4);
+        REQUIRE(pending.size(0) == 0);
+        REQUIRE(pending.size(1) == 4);
+        REQUIRE(!pending.contains(c1));
+
+        // seq 2 of a is used up, taking a1 with it
+        pending.ledgerClosed({a2});
+        REQUIRE(pending.size() == 2);
+        REQUIRE(pending.size(2) == 2);
+        REQUIRE(pending.getMaxSeq(a.getPublicKey()) == 0);
+
+        auto a3 = createPaymentTx(networkID, a, dest, 3, 1000);
+        REQUIRE(pending.add(a3, 1.0));
+        pending.ledgerClosed({});
+        REQUIRE(pending.size(1) == 1);
+        REQUIRE(pending.size(3) == 2);
+
+        // the oldest transactions are dropped
+        pending.ledgerClosed({});
+        REQUIRE(pending.size() == 1);
+        REQUIRE(pending.contains(a3));
+        REQUIRE(pending.getMaxSeq(b.getPublicKey()) == 0);
+    }
+}
+
+TEST_CASE("pending transactions bench", "[herder][bench][hide]")
+{
+    const size_t nbAccounts = 10000;
+    const size_t nbTxPerAccount = 10;
+    const size_t maxTxs = 1000;
+
+    Config cfg(getTestConfig());
+    VirtualClock clock;
+    Application::pointer app = Application::create(clock, cfg);
+    app->start();
+
+    auto& lm = app->getLedgerManager();
+    lm.getCurrentLedgerHeader().maxTxSetSize = maxTxs;
+    Hash const& networkID = app->getNetworkID();
+    auto dest = getAccount("dest");
+
+    std::vector<TransactionFramePtr> txs;
+    for (size_t i = 0; i < nbAccounts; ++i)
+    {
+        auto source = SecretKey::random();
+        for (size_t j = 1; j <= nbTxPerAccount; ++j)
+        {
+            auto tx = createPaymentTx(networkID, source, dest, j, 1000);
+            tx->getEnvelope().tx.fee = rand_uniform<uint32_t>(100, 10000);
+            tx->clearCached();
+            txs.push_back(tx);
+        }
+    }
+    auto keepAll = [](std::vector<TransactionFramePtr>&,
+                      std::vector<TransactionFramePtr>&) {};
+    auto ms = [](std::chrono::steady_clock::duration d) {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(d)
+            .count();
+    };
+    Hash h;
+
+    for (int i = 0; i < 3; ++i)
+    {
+        auto start = std::chrono::steady_clock::now();
+        TxSetFrame all(h);
+        for (auto const& tx : txs)
+        {
+            all.add(tx);
+        }
+        all.surgePricingFilter(lm);
+        all.sortForHash();
+        auto filtered = std::chrono::steady_clock::now() - start;
+
+        PendingTransactions pending;
+        start = std::chrono::steady_clock::now();
+        for (auto const& tx : txs)
+        {
+            pending.add(tx, tx->getFeeRatio(lm));
+        }
+        auto added = std::chrono::steady_clock::now() - start;
+
+        start = std::chrono::steady_clock::now();
+        TxSetFrame best(h);
+        pending.fillTxSet(best, maxTxs, keepAll);
+        best.sortForHash();
+        auto filled = std::chrono::steady_clock::now() - start;
+
+        LOG(INFO) << "Built a set of " << maxTxs << " from " << txs.size()
+                  << " transactions: " << ms(filtered)
+                  << "ms with surgePricingFilter, " << ms(filled)
+                  << "ms from the pool (" << ms(added)
+                  << "ms to add them to it)";
+    }
+}
+
+TEST_CASE("transactions from peers are checked off the main thread",
+          "[herder]")
+{
+    Config cfg(getTestConfig());
+    cfg.TX_ADMISSION_QUEUE_SIZE = 2;
+
+    VirtualClock clock(VirtualClock::REAL_TIME);
+    Application::pointer app = Application::create(clock, cfg);
+
+    Hash const& networkID = app->getNetworkID();
+    app->start();
+
+    auto root = TestAccount::createRoot(*app);
+    auto destAccount = root.create("destAccount", 500000000);
+    auto accountB = root.create("accountB", 5000000000);
+    auto accountC = root.create("accountC", 5000000000);
+
+    auto& herder = app->getHerder();
+    auto& queue =
+        app->getMetrics().NewCounter({"herder", "tx-admission", "queue"});
+    auto& full = app->getMetrics().NewMeter({"herder", "tx-admission", "full"},
+                                            "transaction");
+
+    std::vector<Herder::TransactionSubmitStatus> statuses;
+    auto handler = [&statuses](Herder::TransactionSubmitStatus status) {
+        statuses.push_back(status);
+    };
+
+    REQUIRE(herder.recvTransactionAsync(
+        createPaymentTx(networkID, root, destAccount,
+                        root.nextSequenceNumber(), 1000),
+        handler));
+    REQUIRE(herder.recvTransactionAsync(
+        createPaymentTx(networkID, accountB, destAccount,
+                        accountB.nextSequenceNumber(), 1000),
+        handler));
+    REQUIRE(queue.count() == 2);
+
+    // the queue is full: retry once there is room
+    auto txC = createPaymentTx(networkID, accountC, destAccount,
+                               accountC.nextSequenceNumber(), 1000);
+    REQUIRE(!herder.recvTransactionAsync(txC, handler));
+    REQUIRE(full.count() == 1);
+    bool retried = false;
+    herder.waitForTxAdmission([&]() {
+        retried = true;
+        REQUIRE(herder.recvTransactionAsync(txC, handler));
+    });
+
+    while (statuses.size() < 3)
+    {
+        clock.crank(true);
+    }
+    REQUIRE(retried);
+    REQUIRE(statuses[0] == Herder::TX_STATUS_PENDING);
+    REQUIRE(statuses[1] == Herder::TX_STATUS_PENDING);
+    REQUIRE(statuses[2] == Herder::TX_STATUS_PENDING);
+    REQUIRE(queue.count() == 0);
+}
+
+TEST_CASE("transactions from peers are admitted in the order received",
+          "[herder]")
+{
+    // on disk, so that the source accounts are loaded through the pool
+    Config cfg(getTestConfig(0, Config::TESTDB_ON_DISK_SQLITE));
+    cfg.TX_ADMISSION_QUEUE_SIZE = 100;
+
+    VirtualClock clock(VirtualClock::REAL_TIME);
+    Application::pointer app = Application::create(clock, cfg);
+
+    Hash const& networkID = app->getNetworkID();
+    app->start();
+
+    auto root = TestAccount::createRoot(*app);
+    auto destAccount = root.create("destAccount", 500000000);
+    auto usedSeq = root.getLastSequenceNumber();
+
+    auto& herder = app->getHerder();
+    std::vector<TransactionFramePtr> txs;
+    // statuses in the order they are handed out, by transaction
+    std::vector<std::pair<size_t, Herder::TransactionSubmitStatus>> statuses;
+    auto submit = [&](TransactionFramePtr tx) {
+        auto i = txs.size();
+        txs.push_back(tx);
+        REQUIRE(herder.recvTransactionAsync(
+            tx, [&statuses, i](Herder::TransactionSubmitStatus status) {
+                statuses.emplace_back(i, status);
+            }));
+    };
+
+    // each transaction needs the previous one to be pending already
+    size_t const nbChained = 20;
+    for (size_t i = 0; i < nbChained; ++i)
+    {
+        submit(createPaymentTx(networkID, root, destAccount,
+                               root.nextSequenceNumber(), 1000));
+    }
+    submit(createPaymentTx(networkID, root, destAccount, usedSeq, 1000));
+    submit(createPaymentTx(networkID, getAccount("missing"), destAccount, 1,
+                           1000));
+
+    while (statuses.size() < txs.size())
+    {
+        clock.crank(true);
+    }
+    // the transaction of the missing account first, then those of root in
+    // the order they were handed out
+    auto missing = nbChained + 1;
+    std::stable_partition(
+        statuses.begin(), statuses.end(),
+        [missing](std::pair<size_t, Herder::TransactionSubmitStatus> const& s) {
+            return s.first == missing;
+        });
+    REQUIRE(statuses[0].first == missing);
+    REQUIRE(statuses[0].second == Herder::TX_STATUS_ERROR);
+    REQUIRE(txs[missing]->getResultCode() == txNO_ACCOUNT);
+    for (size_t i = 0; i < nbChained; ++i)
+    {
+        REQUIRE(statuses[i + 1].first == i);
+        REQUIRE(statuses[i + 1].second == Herder::TX_STATUS_PENDING);
+    }
+    REQUIRE(statuses[nbChained + 1].first == nbChained);
+    REQUIRE(statuses[nbChained + 1].second == Herder::TX_STATUS_ERROR);
+    REQUIRE(txs[nbChained]->getResultCode() == txBAD_SEQ);
+}
+
 TEST_CASE("SCP Driver", "[herder]")
 {
     Config cfg(getTestConfig());
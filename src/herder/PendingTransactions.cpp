@@ -0,0 +1,259 @@
+// Copyright 2017 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "herder/PendingTransactions.h"
+#include "herder/TxSetFrame.h"
+#include <algorithm>
+
+namespace stellar
+{
+
+const size_t PendingTransactions::AGES;
+
+bool
+PendingTransactions::RankCmp::operator()(Rank const& a, Rank const& b) const
+{
+    using xdr::operator<;
+    if (a.first != b.first)
+    {
+        return a.first > b.first;
+    }
+    return a.second < b.second;
+}
+
+PendingTransactions::PendingTransactions()
+    : mGenerations(AGES), mGeneration(0), mSize(0)
+{
+}
+
+void
+PendingTransactions::rank(AccountIt account)
+{
+    auto& txs = account->second;
+    txs.mFeeRatio = txs.mTxs.begin()->second.mFeeRatio;
+    for (auto const& e : txs.mTxs)
+    {
+        txs.mFeeRatio = std::min(txs.mFeeRatio, e.second.mFeeRatio);
+    }
+    mRanking.emplace(txs.mFeeRatio, account->first);
+}
+
+void
+PendingTransactions::unrank(AccountIt account)
+{
+    mRanking.erase(Rank(account->second.mFeeRatio, account->first));
+}
+
+void
+PendingTransactions::erase(AccountIt account, EntryIt entry)
+{
+    auto age = mGeneration - entry->second.mGeneration;
+    if (age < mGenerations.size())
+    {
+        --mGenerations[age].mCount;
+    }
+    account->second.mTotalFees -= entry->second.mTx->getFee();
+    account->second.mTxs.erase(entry);
+    --mSize;
+}
+
+void
+PendingTransactions::update(AccountIt account)
+{
+    if (account->second.mTxs.empty())
+    {
+        mAccounts.erase(account);
+    }
+    else
+    {
+        rank(account);
+    }
+}
+
+bool
+PendingTransactions::contains(TransactionFramePtr const& tx) const
+{
+    auto account = mAccounts.find(tx->getSourceID());
+    if (account == mAccounts.end())
+    {
+        return false;
+    }
+    auto entry = account->second.mTxs.find(tx->getSeqNum());
+    return entry != account->second.mTxs.end() &&
+           entry->second.mTx->getFullHash() == tx->getFullHash();
+}
+
+SequenceNumber
+PendingTransactions::getMaxSeq(AccountID const& accountID) const
+{
+    auto account = mAccounts.find(accountID);
+    if (account == mAccounts.end())
+    {
+        return 0;
+    }
+    return account->second.mTxs.rbegin()->first;
+}
+
+int64_t
+PendingTransactions::getTotalFees(AccountID const& accountID) const
+{
+    auto account = mAccounts.find(accountID);
+    if (account == mAccounts.end())
+    {
+        return 0;
+    }
+    return account->second.mTotalFees;
+}
+
+bool
+PendingTransactions::add(TransactionFramePtr tx, double feeRatio)
+{
+    auto account = mAccounts.find(tx->getSourceID());
+    if (account == mAccounts.end())
+    {
+        account = mAccounts.emplace(tx->getSourceID(), AccountTxs()).first;
+    }
+    else if (account->second.mTxs.find(tx->getSeqNum()) !=
+             account->second.mTxs.end())
+    {
+        return false;
+    }
+    else
+    {
+        unrank(account);
+    }
+
+    account->second.mTxs.emplace(tx->getSeqNum(),
+                                 Entry{tx, feeRatio, mGeneration});
+    account->second.mTotalFees += tx->getFee();
+    rank(account);
+
+    mGenerations.front().mTxs.push_back(tx);
+    ++mGenerations.front().mCount;
+    ++mSize;
+    return true;
+}
+
+void
+PendingTransactions::remove(std::vector<TransactionFramePtr> const& txs)
+{
+    for (auto const& tx : txs)
+    {
+        auto account = mAccounts.find(tx->getSourceID());
+        if (account == mAccounts.end())
+        {
+            continue;
+        }
+        auto entry = account->second.mTxs.find(tx->getSeqNum());
+        if (entry == account->second.mTxs.end() ||
+            entry->second.mTx->getFullHash() != tx->getFullHash())
+        {
+            continue;
+        }
+        unrank(account);
+        erase(account, entry);
+        update(account);
+    }
+}
+
+void
+PendingTransactions::ledgerClosed(
+    std::vector<TransactionFramePtr> const& applied)
+{
+    // the sequence numbers up to the applied ones are used up
+    for (auto const& tx : applied)
+    {
+        auto account = mAccounts.find(tx->getSourceID());
+        if (account == mAccounts.end())
+        {
+            continue;
+        }
+        unrank(account);
+        auto& txs = account->second.mTxs;
+        auto end = txs.upper_bound(tx->getSeqNum());
+        for (auto entry = txs.begin(); entry != end;)
+        {
+            erase(account, entry++);
+        }
+        update(account);
+    }
+
+    // drop the oldest generation
+    auto oldest = mGeneration - (mGenerations.size() - 1);
+    for (auto const& tx : mGenerations.back().mTxs)
+    {
+        auto account = mAccounts.find(tx->getSourceID());
+        if (account == mAccounts.end())
+        {
+            continue;
+        }
+        auto entry = account->second.mTxs.find(tx->getSeqNum());
+        if (entry == account->second.mTxs.end() ||
+            entry->second.mGeneration != oldest)
+        {
+            continue;
+        }
+        unrank(account);
+        erase(account, entry);
+        update(account);
+    }
+    mGenerations.pop_back();
+    mGenerations.emplace_front();
+    ++mGeneration;
+}
+
+void
+PendingTransactions::fillTxSet(TxSetFrame& txSet, size_t maxTxs,
+                               Trimmer const& trim)
+{
+    std::vector<TransactionFramePtr> trimmed;
+    for (auto it = mRanking.begin();
+         it != mRanking.end() && txSet.size() < maxTxs; ++it)
+    {
+        auto const& account = mAccounts.find(it->second)->second;
+        std::vector<TransactionFramePtr> txs;
+        txs.reserve(account.mTxs.size());
+        for (auto const& e : account.mTxs)
+        {
+            txs.push_back(e.second.mTx);
+        }
+        trim(txs, trimmed);
+        for (auto const& tx : txs)
+        {
+            if (txSet.size() >= maxTxs)
+            {
+                break;
+            }
+            txSet.add(tx);
+        }
+    }
+    // not while walking mRanking, which it changes
+    remove(trimmed);
+}
+
+void
+PendingTransactions::forEach(
+    std::function<void(TransactionFramePtr const&)> f) const
+{
+    for (auto const& account : mAccounts)
+    {
+        for (auto const& e : account.second.mTxs)
+        {
+            f(e.second.mTx);
+        }
+    }
+}
+
+size_t
+PendingTransactions::size() const
+{
+    return mSize;
+}
+
+size_t
+PendingTransactions::size(size_t age) const
+{
+    return age < mGenerations.size() ? mGenerations[age].mCount : 0;
+}
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+// Copyright 2017 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "crypto/SecretKey.h"
+#include "transactions/TransactionFrame.h"
+#include "util/NonCopyable.h"
+#include <deque>
+#include <functional>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+namespace stellar
+{
+class TxSetFrame;
+
+/**
+ * Transactions received by the herder that are not in a ledger yet.
+ *
+ * The transactions of each source account are kept ordered by sequence
+ * number, along with their total fee, so that checking a new transaction
+ * against the pending ones of its account doesn't look at any other. Accounts
+ * are ranked by the lowest fee ratio of their transactions, the way
+ * TxSetFrame::surgePricingFilter ranks them, so that the best transactions
+ * for the next transaction set are found without sorting the whole pool.
+ *
+ * Transactions are kept for AGES ledgers. Each ledger close removes the
+ * transactions that were applied, and the ones they made stale, and ages the
+ * others by one ledger.
+ */
+class PendingTransactions : NonMovableOrCopyable
+{
+  public:
+    static const size_t AGES = 4;
+
+    // Removes from the transactions of an account, given in sequence number
+    // order, the ones that can't be applied, and adds them to the second
+    // vector.
+    typedef std::function<void(std::vector<TransactionFramePtr>&,
+                               std::vector<TransactionFramePtr>&)>
+        Trimmer;
+
+  private:
+    struct Entry
+    {
+        TransactionFramePtr mTx;
+        // fee ratio when the transaction was added; a change of the base fee
+        // scales all of them alike
+        double mFeeRatio;
+        uint64 mGeneration;
+    };
+
+    struct AccountTxs
+    {
+        std::map<SequenceNumber, Entry> mTxs;
+        int64_t mTotalFees{0};
+        // lowest fee ratio of mTxs
+        double mFeeRatio{0};
+    };
+
+    typedef std::pair<double, AccountID> Rank; // fee ratio, account
+    struct RankCmp
+    {
+        bool operator()(Rank const& a, Rank const& b) const;
+    };
+
+    struct Generation
+    {
+        // transactions added in this generation, some of which may have
+        // been removed since
+        std::vector<TransactionFramePtr> mTxs;
+        size_t mCount{0};
+    };
+
+    std::unordered_map<AccountID, AccountTxs> mAccounts;
+    // best accounts first
+    std::set<Rank, RankCmp> mRanking;
+    // indexed by age, the current generation first
+    std::deque<Generation> mGenerations;
+    uint64 mGeneration;
+    size_t mSize;
+
+    typedef std::unordered_map<AccountID, AccountTxs>::iterator AccountIt;
+    typedef std::map<SequenceNumber, Entry>::iterator EntryIt;
+
+    void rank(AccountIt account);
+    void unrank(AccountIt account);
+    void erase(AccountIt account, EntryIt entry);
+    // removes `account` if it has no transactions left, ranks it otherwise
+    void update(AccountIt account);
+
+  public:
+    PendingTransactions();
+
+    bool contains(TransactionFramePtr const& tx) const;
+
+    // Highest sequence number and total fee of the pending transactions of
+    // `accountID`, 0 if it has none.
+    SequenceNumber getMaxSeq(AccountID const& accountID) const;
+    int64_t getTotalFees(AccountID const& accountID) const;
+
+    // Adds `tx`, ranked with `feeRatio`, to the current generation. Returns
+    // false if its account already has a pending transaction with the same
+    // sequence number.
+    bool add(TransactionFramePtr tx, double feeRatio);
+
+    // Removes `txs` from the pool, if they are pending.
+    void remove(std::vector<TransactionFramePtr> const& txs);
+
+    // Called when a ledger with `applied` is closed: removes the applied
+    // transactions and those with a sequence number they consumed, then
+    // drops the oldest generation and starts a new one.
+    void ledgerClosed(std::vector<TransactionFramePtr> const& applied);
+
+    // Adds to `txSet` up to `maxTxs` transactions, taking those of the best
+    // ranked accounts first. The transactions of each account are passed to
+    // `trim` before being added; the ones it trims are removed from the pool.
+    void fillTxSet(TxSetFrame& txSet, size_t maxTxs, Trimmer const& trim);
+
+    void forEach(std::function<void(TransactionFramePtr const&)> f) const;
+
+    size_t size() const;
+    // number of transactions added `age` ledgers ago
+    size_t size(size_t age) const;
+};
+}
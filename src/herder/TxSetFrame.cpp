@@ -6,6 +6,7 @@
 #include "TxSetFrame.h"
 #include "crypto/Hex.h"
 #include "crypto/SHA.h"
+#include "crypto/SecretKey.h"
 #include "database/Database.h"
 #include "main/Application.h"
 #include "main/Config.h"
@@ -23,6 +24,73 @@ using namespace std;
 using xdr::operator==;
 using xdr::operator<;
 
+const size_t TxValidityCache::MAX_SIZE;
+
+TxValidityCache::TxValidityCache(size_t maxSize) : mMaxSize(maxSize)
+{
+}
+
+void
+TxValidityCache::setLedger(uint32_t ledgerSeq)
+{
+    if (mLedgerSeq != ledgerSeq)
+    {
+        mValid.clear();
+        mOrder.clear();
+        mLedgerSeq = ledgerSeq;
+    }
+}
+
+bool
+TxValidityCache::contains(TransactionFramePtr const& tx) const
+{
+    return mValid.find(tx->getFullHash()) != mValid.end();
+}
+
+TxValidityCache::ValidTx const*
+TxValidityCache::find(TransactionFramePtr const& tx,
+                      SequenceNumber lastSeq) const
+{
+    auto it = mValid.find(tx->getFullHash());
+    if (it == mValid.end() || it->second.mLastSeq != lastSeq)
+    {
+        return nullptr;
+    }
+    return &it->second;
+}
+
+void
+TxValidityCache::add(TransactionFramePtr const& tx, ValidTx const& valid)
+{
+    auto const& hash = tx->getFullHash();
+    auto it = mValid.find(hash);
+    if (it != mValid.end())
+    {
+        it->second = valid;
+        return;
+    }
+
+    if (mValid.size() >= mMaxSize)
+    {
+        // the transactions of the sets nominated lately are the ones
+        // likely to be seen again
+        size_t evicted = std::max<size_t>(mValid.size() / 2, 1);
+        for (size_t i = 0; i < evicted; ++i)
+        {
+            mValid.erase(mOrder.front());
+            mOrder.pop_front();
+        }
+    }
+    mValid.emplace(hash, valid);
+    mOrder.push_back(hash);
+}
+
+size_t
+TxValidityCache::size() const
+{
+    return mValid.size();
+}
+
 TxSetFrame::TxSetFrame(Hash const& previousLedgerHash)
     : mHashIsValid(false), mPreviousLedgerHash(previousLedgerHash)
 {
@@ -208,45 +276,72 @@ TxSetFrame::trimInvalid(Application& app,
         // order by sequence number
         std::sort(item.second.begin(), item.second.end(), SeqSorter);
 
-        TransactionFramePtr lastTx;
-        SequenceNumber lastSeq = 0;
-        int64_t totFee = 0;
-        for (auto& tx : item.second)
+        std::vector<TransactionFramePtr> accountTrimmed;
+        trimInvalidAccountTxs(app, item.second, accountTrimmed);
+        for (auto& tx : accountTrimmed)
         {
-            if (!tx->checkValid(app, lastSeq))
-            {
-                trimmed.push_back(tx);
-                removeTx(tx);
-                continue;
-            }
-            totFee += tx->getFee();
+            trimmed.push_back(tx);
+            removeTx(tx);
+        }
+    }
+}
 
-            lastTx = tx;
-            lastSeq = tx->getSeqNum();
+void
+TxSetFrame::trimInvalidAccountTxs(Application& app,
+                                  std::vector<TransactionFramePtr>& txs,
+                                  std::vector<TransactionFramePtr>& trimmed)
+{
+    std::vector<TransactionFramePtr> valid;
+    SequenceNumber lastSeq = 0;
+    int64_t totFee = 0;
+    for (auto& tx : txs)
+    {
+        if (!tx->checkValid(app, lastSeq))
+        {
+            trimmed.push_back(tx);
+            continue;
         }
-        if (lastTx)
+        totFee += tx->getFee();
+
+        valid.push_back(tx);
+        lastSeq = tx->getSeqNum();
+    }
+    if (!valid.empty())
+    {
+        // make sure account can pay the fee for all these tx
+        auto& lastTx = valid.back();
+        int64_t newBalance = lastTx->getSourceAccount().getBalance() - totFee;
+        if (newBalance < lastTx->getSourceAccount().getMinimumBalance(
+                             app.getLedgerManager()))
         {
-            // make sure account can pay the fee for all these tx
-            int64_t newBalance =
-                lastTx->getSourceAccount().getBalance() - totFee;
-            if (newBalance < lastTx->getSourceAccount().getMinimumBalance(
-                                 app.getLedgerManager()))
-            {
-                for (auto& tx : item.second)
-                {
-                    trimmed.push_back(tx);
-                    removeTx(tx);
-                }
-            }
+            trimmed.insert(trimmed.end(), valid.begin(), valid.end());
+            valid.clear();
         }
     }
+    txs = std::move(valid);
+}
+
+void
+TxSetFrame::verifySignatures(Application& app,
+                             TxValidityCache const* cache) const
+{
+    std::vector<PubKeyUtils::SigToVerify> sigs;
+    for (auto const& tx : mTransactions)
+    {
+        if (cache && cache->contains(tx))
+        {
+            continue;
+        }
+        tx->insertSignaturesToVerify(app.getDatabase(), sigs);
+    }
+    PubKeyUtils::verifySigs(sigs, app.getConfig().SIGNATURE_VERIFY_THREADS);
 }
 
 // need to make sure every account that is submitting a tx has enough to pay
 // the fees of all the tx it has submitted in this set
 // check seq num
 bool
-TxSetFrame::checkValid(Application& app) const
+TxSetFrame::checkValid(Application& app, TxValidityCache* cache) const
 {
     // Establish read-only transaction for duration of checkValid.
     soci::transaction sqltx(app.getDatabase().getSession());
@@ -263,6 +358,10 @@ TxSetFrame::checkValid(Application& app) const
                    app.getLedgerManager().getLastClosedLedgerHeader().hash);
         return false;
     }
+    if (cache)
+    {
+        cache->setLedger(lcl.header.ledgerSeq);
+    }
 
     if (mTransactions.size() > lcl.header.maxTxSetSize)
     {
@@ -289,6 +388,8 @@ TxSetFrame::checkValid(Application& app) const
         lastHash = tx->getFullHash();
     }
 
+    verifySignatures(app, cache);
+
     for (auto& item : accountTxMap)
     {
         // order by sequence number
@@ -297,9 +398,16 @@ TxSetFrame::checkValid(Application& app) const
         TransactionFramePtr lastTx;
         SequenceNumber lastSeq = 0;
         int64_t totFee = 0;
+        // balance of the account above its reserve
+        int64_t available = 0;
         for (auto& tx : item.second)
         {
-            if (!tx->checkValid(app, lastSeq))
+            auto cached = cache ? cache->find(tx, lastSeq) : nullptr;
+            if (cached)
+            {
+                available = cached->mAvailable;
+            }
+            else if (!tx->checkValid(app, lastSeq))
             {
                 CLOG(DEBUG, "Herder")
                     << "bad txSet: " << hexAbbrev(mPreviousLedgerHash)
@@ -310,6 +418,17 @@ TxSetFrame::checkValid(Application& app) const
 
                 return false;
             }
+            else
+            {
+                auto& account = tx->getSourceAccount();
+                available = account.getBalance() -
+                            account.getMinimumBalance(app.getLedgerManager());
+                if (cache)
+                {
+                    cache->add(tx,
+                               TxValidityCache::ValidTx{lastSeq, available});
+                }
+            }
             totFee += tx->getFee();
 
             lastTx = tx;
@@ -318,10 +437,7 @@ TxSetFrame::checkValid(Application& app) const
         if (lastTx)
         {
             // make sure account can pay the fee for all these tx
-            int64_t newBalance =
-                lastTx->getSourceAccount().getBalance() - totFee;
-            if (newBalance < lastTx->getSourceAccount().getMinimumBalance(
-                                 app.getLedgerManager()))
+            if (available < totFee)
             {
                 CLOG(DEBUG, "Herder")
                     << "bad txSet: " << hexAbbrev(mPreviousLedgerHash)
@@ -352,9 +468,19 @@ TxSetFrame::getContentsHash()
         sortForHash();
         auto hasher = SHA256::create();
         hasher->add(mPreviousLedgerHash);
-        for (unsigned int n = 0; n < mTransactions.size(); n++)
+        // serialize all the envelopes in the same buffer
+        std::vector<char> buf;
+        for (auto const& tx : mTransactions)
         {
-            hasher->add(xdr::xdr_to_opaque(mTransactions[n]->getEnvelope()));
+            auto const& envelope = tx->getEnvelope();
+            size_t sz = xdr::xdr_size(envelope);
+            if (buf.size() < sz)
+            {
+                buf.resize(sz);
+            }
+            xdr::xdr_put p(buf.data(), buf.data() + sz);
+            xdr::xdr_argpack_archive(p, envelope);
+            hasher->add(ByteSlice(buf.data(), sz));
         }
         mHash = hasher->finish();
         mHashIsValid = true;
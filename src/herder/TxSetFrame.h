@@ -6,6 +6,8 @@
 
 #include "overlay/StellarXDR.h"
 #include "transactions/TransactionFrame.h"
+#include <deque>
+#include <unordered_map>
 
 namespace stellar
 {
@@ -14,6 +16,50 @@ class Application;
 class TxSetFrame;
 typedef std::shared_ptr<TxSetFrame> TxSetFramePtr;
 
+// Transactions TxSetFrame::checkValid found valid on top of the last closed
+// ledger, so that the sets nominated for the next ledger, which mostly hold
+// the same transactions, don't check each of them again.
+class TxValidityCache
+{
+  public:
+    struct ValidTx
+    {
+        // sequence number the transaction was checked after, 0 for the one
+        // of its account
+        SequenceNumber mLastSeq;
+        // balance of the source account above its reserve
+        int64_t mAvailable;
+    };
+
+    // The cache only holds transactions that are valid, but a set can hold
+    // any number of them from the same account, so its size is capped.
+    static const size_t MAX_SIZE = 100000;
+
+  private:
+    size_t mMaxSize;
+    uint32_t mLedgerSeq{0};
+    std::unordered_map<Hash, ValidTx> mValid;
+    // the keys of mValid, oldest first
+    std::deque<Hash> mOrder;
+
+  public:
+    explicit TxValidityCache(size_t maxSize = MAX_SIZE);
+
+    // Forgets the transactions found valid if the last closed ledger is no
+    // longer `ledgerSeq`.
+    void setLedger(uint32_t ledgerSeq);
+
+    bool contains(TransactionFramePtr const& tx) const;
+    // The result for `tx` checked after `lastSeq`, or null.
+    ValidTx const* find(TransactionFramePtr const& tx,
+                        SequenceNumber lastSeq) const;
+    // Adds `tx`, forgetting the oldest half of the transactions first if the
+    // cache is full.
+    void add(TransactionFramePtr const& tx, ValidTx const& valid);
+
+    size_t size() const;
+};
+
 class TxSetFrame
 {
     bool mHashIsValid;
@@ -41,9 +87,26 @@ class TxSetFrame
 
     std::vector<TransactionFramePtr> sortForApply();
 
-    bool checkValid(Application& app) const;
+    // With a `cache`, transactions it holds are not checked again, and the
+    // ones found valid are added to it.
+    bool checkValid(Application& app, TxValidityCache* cache = nullptr) const;
+
+    // Verify the signatures of all the transactions of the set at once, on
+    // SIGNATURE_VERIFY_THREADS threads, so that checking or applying the
+    // transactions one at a time finds them in the verification cache.
+    // Transactions in `cache` are skipped.
+    void verifySignatures(Application& app,
+                          TxValidityCache const* cache = nullptr) const;
+
     void trimInvalid(Application& app,
                      std::vector<TransactionFramePtr>& trimmed);
+    // Same as trimInvalid, for `txs`, the transactions of a single account
+    // ordered by sequence number. Must be called within a database
+    // transaction.
+    static void
+    trimInvalidAccountTxs(Application& app,
+                          std::vector<TransactionFramePtr>& txs,
+                          std::vector<TransactionFramePtr>& trimmed);
     void surgePricingFilter(LedgerManager const& lm);
 
     void removeTx(TransactionFramePtr tx);
@@ -5,26 +5,35 @@
 #include "bucket/BucketList.h"
 #include "bucket/BucketManager.h"
 #include "crypto/Hex.h"
+#include "database/Database.h"
 #include "herder/LedgerCloseData.h"
+#include "herder/TxSetFrame.h"
 #include "history/HistoryArchive.h"
 #include "history/HistoryManager.h"
 #include "history/HistoryWork.h"
+#include "ledger/LedgerHeaderFrame.h"
 #include "ledger/LedgerManager.h"
 #include "lib/catch.hpp"
 #include "main/Application.h"
 #include "main/Config.h"
 #include "main/ExternalQueue.h"
 #include "main/PersistentState.h"
+#include "medida/metrics_registry.h"
+#include "medida/timer.h"
 #include "process/ProcessManager.h"
 #include "test/TxTests.h"
 #include "test/test.h"
+#include "transactions/TransactionFrame.h"
 #include "util/Fs.h"
 #include "util/Logging.h"
 #include "util/NonCopyable.h"
 #include "util/Timer.h"
 #include "util/TmpDir.h"
+#include "util/XDRStream.h"
 #include "work/WorkManager.h"
 #include "work/WorkParent.h"
+#include <algorithm>
+#include <chrono>
 #include <cstdio>
 #include <fstream>
 #include <random>
@@ -1093,3 +1102,187 @@ TEST_CASE("initialize existing history store fails", "[history]")
         REQUIRE(!HistoryManager::initializeHistoryArchive(*app, "test"));
     }
 }
+
+static void
+benchHistoryExport(bool binary)
+{
+    using namespace txtest;
+
+    Config cfg(getTestConfig(0, Config::TESTDB_ON_DISK_SQLITE));
+    cfg.BINARY_HISTORY = binary;
+    VirtualClock clock;
+    Application::pointer app = Application::create(clock, cfg);
+    app->start();
+
+    auto& lm = app->getLedgerManager();
+    auto const& networkID = app->getNetworkID();
+    auto root = getRoot(networkID);
+    auto dest = getAccount("dest");
+    auto rootSeq = getAccountSeqNum(root, *app) + 1;
+
+    // a checkpoint worth of ledgers, full of payments
+    uint32_t const nbLedgers = 64;
+    size_t const nbTxs = 100;
+    applyCreateAccountTx(*app, root, dest, rootSeq++,
+                         lm.getMinBalance(0) * 10);
+    uint32_t begin = lm.getLedgerNum();
+    for (uint32_t l = 0; l < nbLedgers; ++l)
+    {
+        auto txSet = std::make_shared<TxSetFrame>(
+            lm.getLastClosedLedgerHeader().hash);
+        for (size_t i = 0; i < nbTxs; ++i)
+        {
+            txSet->add(createPaymentTx(networkID, root, dest, rootSeq++, 1));
+        }
+        txSet->sortForHash();
+        closeLedgerOn(*app, lm.getLedgerNum(), 1, 1, 2017, txSet);
+    }
+
+    // what writing the history took, and the space it takes
+    auto& db = app->getDatabase();
+    auto& metrics = app->getMetrics();
+    double insertMs =
+        metrics.NewTimer({"database", "insert", "txhistory"}).sum() +
+        metrics.NewTimer({"database", "insert", "txfeehistory"}).sum() +
+        metrics.NewTimer({"database", "insert", "ledger-header"}).sum();
+    long long txBytes = 0;
+    db.getSession() << "SELECT SUM(LENGTH(txbody) + LENGTH(txresult) + "
+                       "LENGTH(txmeta)) FROM txhistory",
+        soci::into(txBytes);
+    LOG(INFO) << (binary ? "Binary" : "Base64") << " history: inserted "
+              << nbLedgers << " ledgers in " << insertMs << "ms, "
+              << "transaction blobs take " << txBytes << " bytes";
+
+    TmpDir dir(app->getTmpDirManager().tmpDir("export"));
+    for (int i = 0; i < 5; ++i)
+    {
+        XDROutputFileStream headersOut, txOut, txResultOut;
+        headersOut.open(dir.getName() + "/ledger.xdr");
+        txOut.open(dir.getName() + "/transactions.xdr");
+        txResultOut.open(dir.getName() + "/results.xdr");
+
+        auto start = std::chrono::steady_clock::now();
+        size_t nbHeaders = LedgerHeaderFrame::copyLedgerHeadersToStream(
+            db, db.getSession(), begin, nbLedgers, headersOut);
+        auto headersDone = std::chrono::steady_clock::now();
+        size_t nbExported = TransactionFrame::copyTransactionsToStream(
+            networkID, db, db.getSession(), begin, nbLedgers, txOut,
+            txResultOut);
+        auto txsDone = std::chrono::steady_clock::now();
+        REQUIRE(nbHeaders == nbLedgers);
+        REQUIRE(nbExported == nbLedgers * nbTxs);
+
+        auto us = [](std::chrono::steady_clock::duration d) {
+            return std::chrono::duration_cast<std::chrono::microseconds>(d)
+                .count();
+        };
+        LOG(INFO) << (binary ? "Binary" : "Base64") << " history: exported "
+                  << nbHeaders << " ledger headers in "
+                  << us(headersDone - start) << "us, " << nbExported
+                  << " transactions in " << us(txsDone - headersDone) << "us";
+    }
+}
+
+TEST_CASE("history export bench", "[history][bench][hide]")
+{
+    benchHistoryExport(false);
+    benchHistoryExport(true);
+}
+
+TEST_CASE("history blobs converted to binary and back", "[history][db]")
+{
+    using namespace txtest;
+
+    Config cfg(getTestConfig(0, Config::TESTDB_ON_DISK_SQLITE));
+
+    // the history of all the closed ledgers, as read back
+    auto readHistory = [](Application& app) {
+        auto& db = app.getDatabase();
+        std::vector<xdr::opaque_vec<>> res;
+        auto lcl = app.getLedgerManager().getLastClosedLedgerNum();
+        for (uint32_t seq = 1; seq <= lcl; ++seq)
+        {
+            auto header =
+                LedgerHeaderFrame::loadBySequence(seq, db, db.getSession());
+            REQUIRE(header);
+            res.emplace_back(xdr::xdr_to_opaque(header->mHeader));
+            res.emplace_back(xdr::xdr_to_opaque(
+                TransactionFrame::getTransactionHistoryResults(db, seq)));
+            for (auto const& changes :
+                 TransactionFrame::getTransactionFeeMeta(db, seq))
+            {
+                res.emplace_back(xdr::xdr_to_opaque(changes));
+            }
+        }
+        return res;
+    };
+    // closes a ledger with a payment, and returns the history
+    auto closeLedger = [&](Application& app) {
+        auto& lm = app.getLedgerManager();
+        auto root = getRoot(app.getNetworkID());
+        auto rootSeq = getAccountSeqNum(root, app) + 1;
+        auto txSet =
+            std::make_shared<TxSetFrame>(lm.getLastClosedLedgerHeader().hash);
+        txSet->add(createPaymentTx(app.getNetworkID(), root,
+                                   getAccount("dest"), rootSeq, 1));
+        txSet->sortForHash();
+        closeLedgerOn(app, lm.getLedgerNum(), 1, 1, 2017, txSet);
+        REQUIRE(TransactionFrame::getTransactionHistoryResults(
+                    app.getDatabase(), lm.getLastClosedLedgerNum())
+                    .results.size() == 1);
+        return readHistory(app);
+    };
+    auto storageClass = [](Application& app) {
+        std::string res;
+        app.getDatabase().getSession()
+            << "SELECT typeof(txbody) FROM txhistory LIMIT 1",
+            soci::into(res);
+        return res;
+    };
+
+    std::vector<xdr::opaque_vec<>> history;
+    {
+        VirtualClock clock;
+        Application::pointer app = Application::create(clock, cfg);
+        app->start();
+        auto root = getRoot(app->getNetworkID());
+        applyCreateAccountTx(*app, root, getAccount("dest"),
+                             getAccountSeqNum(root, *app) + 1,
+                             app->getLedgerManager().getMinBalance(0) * 10);
+        // more rows than are converted in a batch
+        auto& lm = app->getLedgerManager();
+        auto rootSeq = getAccountSeqNum(root, *app) + 1;
+        auto txSet =
+            std::make_shared<TxSetFrame>(lm.getLastClosedLedgerHeader().hash);
+        for (int i = 0; i < 1500; ++i)
+        {
+            txSet->add(createPaymentTx(app->getNetworkID(), root,
+                                       getAccount("dest"), rootSeq++, 1));
+        }
+        txSet->sortForHash();
+        closeLedgerOn(*app, lm.getLedgerNum(), 1, 1, 2017, txSet);
+
+        history = closeLedger(*app);
+        REQUIRE(!app->getDatabase().hasBinaryHistory());
+        REQUIRE(storageClass(*app) == "text");
+    }
+
+    // restarting with another BINARY_HISTORY converts the existing history,
+    // and the history written after it is in the new format too
+    for (bool binary : {true, false})
+    {
+        cfg.BINARY_HISTORY = binary;
+        VirtualClock clock;
+        Application::pointer app = Application::create(clock, cfg, false);
+        app->start();
+        REQUIRE(app->getDatabase().hasBinaryHistory() == binary);
+        REQUIRE(storageClass(*app) == (binary ? "blob" : "text"));
+        REQUIRE(readHistory(*app) == history);
+
+        auto newHistory = closeLedger(*app);
+        REQUIRE(newHistory.size() > history.size());
+        REQUIRE(std::equal(history.begin(), history.end(),
+                           newHistory.begin()));
+        history = newHistory;
+    }
+}
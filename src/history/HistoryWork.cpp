@@ -16,6 +16,7 @@
 #include "ledger/LedgerManager.h"
 #include "main/Config.h"
 #include "process/ProcessManager.h"
+#include "util/BlockCompression.h"
 #include "util/Logging.h"
 #include "util/make_unique.h"
 #include "xdr/Stellar-ledger.h"
@@ -812,13 +813,18 @@ ApplyBucketsWork::onReset()
 void
 ApplyBucketsWork::onStart()
 {
+    // Both applicators of a level start reading and decoding their buckets
+    // on their own threads straight away, so the first batches of the curr
+    // bucket are decoded while the snap bucket is written to the database.
     auto& level = getBucketLevel(mLevel);
     HistoryStateBucket& i = mApplyState.currentBuckets.at(mLevel);
     if (mApplying || i.snap != binToHex(level.getSnap()->getHash()))
     {
         mSnapBucket = getBucket(i.snap);
-        mSnapApplicator =
-            make_unique<BucketApplicator>(mApp.getDatabase(), mSnapBucket);
+        mSnapApplicator = make_unique<BucketApplicator>(
+            mApp.getDatabase(), mSnapBucket,
+            mApp.getConfig().BUCKET_READ_BLOCK_SIZE,
+            mApp.getConfig().BUCKET_READ_USE_MMAP);
         CLOG(DEBUG, "History") << "ApplyBuckets : starting level[" << mLevel
                                << "].snap = " << i.snap;
         mApplying = true;
@@ -826,8 +832,10 @@ ApplyBucketsWork::onStart()
     if (mApplying || i.curr != binToHex(level.getCurr()->getHash()))
     {
         mCurrBucket = getBucket(i.curr);
-        mCurrApplicator =
-            make_unique<BucketApplicator>(mApp.getDatabase(), mCurrBucket);
+        mCurrApplicator = make_unique<BucketApplicator>(
+            mApp.getDatabase(), mCurrBucket,
+            mApp.getConfig().BUCKET_READ_BLOCK_SIZE,
+            mApp.getConfig().BUCKET_READ_USE_MMAP);
         CLOG(DEBUG, "History") << "ApplyBuckets : starting level[" << mLevel
                                << "].curr = " << i.curr;
         mApplying = true;
@@ -1683,11 +1691,18 @@ PutSnapshotFilesWork::onSuccess()
         {
             if (f && fs::exists(f->localPath_nogz()))
             {
+                // Block-compressed buckets are already valid gzip files and
+                // are uploaded as they are.
+                bool gzipped = isBlockCompressedFile(f->localPath_nogz());
                 auto put = mPutFilesWork->addWork<PutRemoteFileWork>(
-                    f->localPath_gz(), f->remoteName(), mArchive);
+                    gzipped ? f->localPath_nogz() : f->localPath_gz(),
+                    f->remoteName(), mArchive);
                 auto mkdir =
                     put->addWork<MakeRemoteDirWork>(f->remoteDir(), mArchive);
-                mkdir->addWork<GzipFileWork>(f->localPath_nogz(), true);
+                if (!gzipped)
+                {
+                    mkdir->addWork<GzipFileWork>(f->localPath_nogz(), true);
+                }
             }
         }
         return WORK_PENDING;
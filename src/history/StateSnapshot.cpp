@@ -50,11 +50,12 @@ StateSnapshot::StateSnapshot(Application& app, HistoryArchiveState const& state)
 void
 StateSnapshot::makeLive()
 {
-    for (auto& hb : mLocalState.currentBuckets)
+    for (uint32_t i = 0; i < mLocalState.currentBuckets.size(); ++i)
     {
+        auto& hb = mLocalState.currentBuckets[i];
         if (hb.next.hasHashes() && !hb.next.isLive())
         {
-            hb.next.makeLive(mApp);
+            hb.next.makeLive(mApp, i);
         }
     }
 }
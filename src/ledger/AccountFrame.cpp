@@ -357,6 +357,13 @@ void
 AccountFrame::storeDelete(LedgerDelta& delta, Database& db,
                           LedgerKey const& key)
 {
+    if (db.deferLedgerWrites())
+    {
+        putPendingEntry(key, nullptr, db);
+        delta.deleteEntry(key);
+        return;
+    }
+
     flushCachedEntry(key, db);
 
     std::string actIDStrKey = KeyUtils::toStrKey(key.account().accountID);
@@ -381,6 +388,157 @@ AccountFrame::storeDelete(LedgerDelta& delta, Database& db,
     delta.deleteEntry(key);
 }
 
+void
+AccountFrame::storeDeleteBulk(Database& db, std::vector<LedgerKey> const& keys)
+{
+    if (keys.empty())
+    {
+        return;
+    }
+
+    std::vector<std::string> actIDStrKeys;
+    actIDStrKeys.reserve(keys.size());
+    for (auto const& key : keys)
+    {
+        flushCachedEntry(key, db);
+        db.getInflationTally().remove(key.account().accountID);
+        actIDStrKeys.emplace_back(KeyUtils::toStrKey(key.account().accountID));
+    }
+    auto bindRow = [&](soci::statement& st, size_t row) {
+        st.exchange(use(actIDStrKeys[row]));
+    };
+    {
+        auto timer = db.getDeleteTimer("account");
+        db.executeBulk(actIDStrKeys.size(), 1,
+                       [](size_t n) {
+                           return "DELETE FROM accounts WHERE accountid IN (" +
+                                  Database::getPlaceholders(n) + ")";
+                       },
+                       bindRow);
+    }
+    {
+        auto timer = db.getDeleteTimer("signer");
+        db.executeBulk(actIDStrKeys.size(), 1,
+                       [](size_t n) {
+                           return "DELETE FROM signers WHERE accountid IN (" +
+                                  Database::getPlaceholders(n) + ")";
+                       },
+                       bindRow);
+    }
+}
+
+void
+AccountFrame::storeAddBulk(Database& db,
+                           std::vector<LedgerEntry> const& entries)
+{
+    if (entries.empty())
+    {
+        return;
+    }
+
+    size_t n = entries.size();
+    std::vector<std::string> actIDStrKeys, inflationDestStrKeys, homeDomains,
+        thresholds;
+    std::vector<soci::indicator> inflationInds;
+    std::vector<long long> balances, seqNums;
+    std::vector<int> numSubEntries, flags, lastModifieds;
+    actIDStrKeys.reserve(n);
+    inflationDestStrKeys.reserve(n);
+    homeDomains.reserve(n);
+    thresholds.reserve(n);
+    inflationInds.reserve(n);
+    balances.reserve(n);
+    seqNums.reserve(n);
+    numSubEntries.reserve(n);
+    flags.reserve(n);
+    lastModifieds.reserve(n);
+
+    std::vector<std::string> signerActIDStrKeys, signerStrKeys;
+    std::vector<int> signerWeights;
+
+    for (auto const& entry : entries)
+    {
+        auto const& account = entry.data.account();
+        db.getInflationTally().update(account);
+        actIDStrKeys.emplace_back(KeyUtils::toStrKey(account.accountID));
+        balances.emplace_back(account.balance);
+        seqNums.emplace_back(account.seqNum);
+        numSubEntries.emplace_back(account.numSubEntries);
+        if (account.inflationDest)
+        {
+            inflationDestStrKeys.emplace_back(
+                KeyUtils::toStrKey(*account.inflationDest));
+            inflationInds.emplace_back(soci::i_ok);
+        }
+        else
+        {
+            inflationDestStrKeys.emplace_back();
+            inflationInds.emplace_back(soci::i_null);
+        }
+        homeDomains.emplace_back(account.homeDomain);
+        thresholds.emplace_back(bn::encode_b64(account.thresholds));
+        flags.emplace_back(account.flags);
+        lastModifieds.emplace_back(entry.lastModifiedLedgerSeq);
+
+        for (auto const& signer : account.signers)
+        {
+            signerActIDStrKeys.emplace_back(actIDStrKeys.back());
+            signerStrKeys.emplace_back(KeyUtils::toStrKey(signer.key));
+            signerWeights.emplace_back(signer.weight);
+        }
+    }
+
+    {
+        auto timer = db.getInsertTimer("account");
+        auto inserted = db.executeBulk(
+            n, 9,
+            [](size_t rows) {
+                return "INSERT INTO accounts ( accountid, balance, seqnum, "
+                       "numsubentries, inflationdest, homedomain, "
+                       "thresholds, flags, lastmodified ) VALUES " +
+                       Database::getPlaceholders(
+                           rows, "(?, ?, ?, ?, ?, ?, ?, ?, ?)", ", ");
+            },
+            [&](soci::statement& st, size_t row) {
+                st.exchange(use(actIDStrKeys[row]));
+                st.exchange(use(balances[row]));
+                st.exchange(use(seqNums[row]));
+                st.exchange(use(numSubEntries[row]));
+                st.exchange(
+                    use(inflationDestStrKeys[row], inflationInds[row]));
+                st.exchange(use(homeDomains[row]));
+                st.exchange(use(thresholds[row]));
+                st.exchange(use(flags[row]));
+                st.exchange(use(lastModifieds[row]));
+            });
+        if (inserted != static_cast<long long>(n))
+        {
+            throw std::runtime_error("Could not update data in SQL");
+        }
+    }
+
+    if (!signerStrKeys.empty())
+    {
+        auto timer = db.getInsertTimer("signer");
+        auto inserted = db.executeBulk(
+            signerStrKeys.size(), 3,
+            [](size_t rows) {
+                return "INSERT INTO signers (accountid,publickey,weight) "
+                       "VALUES " +
+                       Database::getPlaceholders(rows, "(?, ?, ?)", ", ");
+            },
+            [&](soci::statement& st, size_t row) {
+                st.exchange(use(signerActIDStrKeys[row]));
+                st.exchange(use(signerStrKeys[row]));
+                st.exchange(use(signerWeights[row]));
+            });
+        if (inserted != static_cast<long long>(signerStrKeys.size()))
+        {
+            throw std::runtime_error("Could not update data in SQL");
+        }
+    }
+}
+
 void
 AccountFrame::storeUpdate(LedgerDelta& delta, Database& db, bool insert)
 {
@@ -388,29 +546,36 @@ AccountFrame::storeUpdate(LedgerDelta& delta, Database& db, bool insert)
 
     touch(delta);
 
+    if (db.deferLedgerWrites())
+    {
+        putPendingEntry(db);
+        if (insert)
+        {
+            delta.addEntry(*this);
+        }
+        else
+        {
+            delta.modEntry(*this);
+        }
+        return;
+    }
+
     flushCachedEntry(db);
 
     std::string actIDStrKey = KeyUtils::toStrKey(mAccountEntry.accountID);
-    std::string sql;
 
-    if (insert)
-    {
-        sql = std::string(
-            "INSERT INTO accounts ( accountid, balance, seqnum, "
-            "numsubentries, inflationdest, homedomain, thresholds, flags, "
-            "lastmodified ) "
-            "VALUES ( :id, :v1, :v2, :v3, :v4, :v5, :v6, :v7, :v8 )");
-    }
-    else
-    {
-        sql = std::string(
-            "UPDATE accounts SET balance = :v1, seqnum = :v2, "
-            "numsubentries = :v3, "
-            "inflationdest = :v4, homedomain = :v5, thresholds = :v6, "
-            "flags = :v7, lastmodified = :v8 WHERE accountid = :id");
-    }
+    static const std::string insertSql(
+        "INSERT INTO accounts ( accountid, balance, seqnum, "
+        "numsubentries, inflationdest, homedomain, thresholds, flags, "
+        "lastmodified ) "
+        "VALUES ( :id, :v1, :v2, :v3, :v4, :v5, :v6, :v7, :v8 )");
+    static const std::string updateSql(
+        "UPDATE accounts SET balance = :v1, seqnum = :v2, "
+        "numsubentries = :v3, "
+        "inflationdest = :v4, homedomain = :v5, thresholds = :v6, "
+        "flags = :v7, lastmodified = :v8 WHERE accountid = :id");
 
-    auto prep = db.getPreparedStatement(sql);
+    auto prep = db.getPreparedStatement(insert ? insertSql : updateSql);
 
     soci::indicator inflation_ind = soci::i_null;
     string inflationDestStrKey;
@@ -625,6 +790,105 @@ AccountFrame::processForInflation(
     }
 }
 
+void
+AccountFrame::loadEntries(soci::session& sess,
+                          std::vector<LedgerKey> const& keys,
+                          std::function<void(LedgerEntry const&)> processor)
+{
+    std::vector<std::string> actIDStrKeys;
+    actIDStrKeys.reserve(keys.size());
+    for (auto const& key : keys)
+    {
+        actIDStrKeys.emplace_back(KeyUtils::toStrKey(key.account().accountID));
+    }
+    std::string inList =
+        " WHERE accountid IN (" + Database::getPlaceholders(keys.size()) + ")";
+
+    // Load the signers of all the accounts first, to attach them to their
+    // accounts as those are read.
+    std::map<std::string, std::vector<Signer>> signers;
+    {
+        std::string actIDStrKey, pubKey;
+        Signer signer;
+        auto prep = Database::getStatement(
+            sess, "SELECT accountid, publickey, weight FROM signers" + inList);
+        auto& st = prep.statement();
+        for (auto const& k : actIDStrKeys)
+        {
+            st.exchange(use(k));
+        }
+        st.exchange(into(actIDStrKey));
+        st.exchange(into(pubKey));
+        st.exchange(into(signer.weight));
+        st.define_and_bind();
+        st.execute(true);
+        while (st.got_data())
+        {
+            signer.key = KeyUtils::fromStrKey<SignerKey>(pubKey);
+            signers[actIDStrKey].push_back(signer);
+            st.fetch();
+        }
+    }
+
+    LedgerEntry le;
+    le.data.type(ACCOUNT);
+    AccountEntry& account = le.data.account();
+
+    std::string actIDStrKey, inflationDest, homeDomain, thresholds;
+    soci::indicator inflationDestInd;
+
+    std::string sql = "SELECT accountid, balance, seqnum, numsubentries, "
+                      "inflationdest, homedomain, thresholds, flags, "
+                      "lastmodified FROM accounts";
+    sql += inList;
+    auto prep = Database::getStatement(sess, sql);
+    auto& st = prep.statement();
+    for (auto const& k : actIDStrKeys)
+    {
+        st.exchange(use(k));
+    }
+    st.exchange(into(actIDStrKey));
+    st.exchange(into(account.balance));
+    st.exchange(into(account.seqNum));
+    st.exchange(into(account.numSubEntries));
+    st.exchange(into(inflationDest, inflationDestInd));
+    st.exchange(into(homeDomain));
+    st.exchange(into(thresholds));
+    st.exchange(into(account.flags));
+    st.exchange(into(le.lastModifiedLedgerSeq));
+    st.define_and_bind();
+    st.execute(true);
+    while (st.got_data())
+    {
+        account.accountID = KeyUtils::fromStrKey<PublicKey>(actIDStrKey);
+        account.homeDomain = homeDomain;
+        bn::decode_b64(thresholds.begin(), thresholds.end(),
+                       account.thresholds.begin());
+        if (inflationDestInd == soci::i_ok)
+        {
+            account.inflationDest.activate() =
+                KeyUtils::fromStrKey<PublicKey>(inflationDest);
+        }
+        else
+        {
+            account.inflationDest.reset();
+        }
+
+        account.signers.clear();
+        auto i = signers.find(actIDStrKey);
+        if (i != signers.end())
+        {
+            account.signers.insert(account.signers.end(), i->second.begin(),
+                                   i->second.end());
+            std::sort(account.signers.begin(), account.signers.end(),
+                      &AccountFrame::signerCompare);
+        }
+
+        processor(le);
+        st.fetch();
+    }
+}
+
 std::unordered_map<AccountID, AccountFrame::pointer>
 AccountFrame::checkDB(Database& db)
 {
@@ -680,6 +944,7 @@ AccountFrame::checkDB(Database& db)
 void
 AccountFrame::dropAll(Database& db)
 {
+    db.getInflationTally().clear();
     db.getSession() << "DROP TABLE IF EXISTS accounts;";
     db.getSession() << "DROP TABLE IF EXISTS signers;";
 
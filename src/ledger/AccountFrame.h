@@ -117,6 +117,14 @@ class AccountFrame : public EntryFrame
     // Static helper that don't assume an instance.
     static void storeDelete(LedgerDelta& delta, Database& db,
                             LedgerKey const& key);
+
+    // Bulk forms of storeDelete and storeAdd, used when applying buckets:
+    // they bypass LedgerDelta and write all rows with a single prepared
+    // statement. storeAddBulk expects the rows not to exist yet.
+    static void storeDeleteBulk(Database& db,
+                                std::vector<LedgerKey> const& keys);
+    static void storeAddBulk(Database& db,
+                             std::vector<LedgerEntry> const& entries);
     static bool exists(Database& db, LedgerKey const& key);
     static uint64_t countObjects(soci::session& sess);
 
@@ -142,6 +150,14 @@ class AccountFrame : public EntryFrame
         std::function<bool(InflationVotes const&)> inflationProcessor,
         int maxWinners, Database& db);
 
+    // Load the entries with the given keys through `sess`, bypassing the
+    // entry cache, and pass them to `processor` in no particular order. Keys
+    // that have no entry are skipped. Used to check the database against the
+    // bucket list from a worker thread.
+    static void
+    loadEntries(soci::session& sess, std::vector<LedgerKey> const& keys,
+                std::function<void(LedgerEntry const&)> processor);
+
     // loads all accounts from database and checks for consistency (slow!)
     static std::unordered_map<AccountID, AccountFrame::pointer>
     checkDB(Database& db);
@@ -78,20 +78,41 @@ DataFrame::loadData(AccountID const& accountID, std::string dataName,
 {
     DataFrame::pointer retData;
 
+    LedgerKey key;
+    key.type(DATA);
+    key.data().accountID = accountID;
+    key.data().dataName = dataName;
+    if (cachedEntryExists(key, db))
+    {
+        auto p = getCachedEntry(key, db);
+        return p ? make_shared<DataFrame>(*p) : nullptr;
+    }
+
     std::string actIDStrKey = KeyUtils::toStrKey(accountID);
 
-    std::string sql = dataColumnSelector;
-    sql += " WHERE accountid = :id AND dataname = :dataname";
+    static const std::string sql =
+        std::string(dataColumnSelector) +
+        " WHERE accountid = :id AND dataname = :dataname";
     auto prep = db.getPreparedStatement(sql);
     auto& st = prep.statement();
     st.exchange(use(actIDStrKey));
     st.exchange(use(dataName));
 
-    auto timer = db.getSelectTimer("data");
-    loadData(prep, [&retData](LedgerEntry const& data) {
-        retData = make_shared<DataFrame>(data);
-    });
+    {
+        auto timer = db.getSelectTimer("data");
+        loadData(prep, [&retData](LedgerEntry const& data) {
+            retData = make_shared<DataFrame>(data);
+        });
+    }
 
+    if (retData)
+    {
+        retData->putCachedEntry(db);
+    }
+    else
+    {
+        putCachedEntry(key, nullptr, db);
+    }
     return retData;
 }
 
@@ -169,6 +190,29 @@ DataFrame::loadAllData(Database& db)
     return retData;
 }
 
+void
+DataFrame::loadEntries(soci::session& sess, std::vector<LedgerKey> const& keys,
+                       std::function<void(LedgerEntry const&)> processor)
+{
+    std::vector<std::string> actIDStrKeys;
+    actIDStrKeys.reserve(keys.size());
+    for (auto const& key : keys)
+    {
+        actIDStrKeys.emplace_back(KeyUtils::toStrKey(key.data().accountID));
+    }
+
+    std::string sql = dataColumnSelector;
+    sql += " WHERE accountid IN (" + Database::getPlaceholders(keys.size()) +
+           ")";
+    auto prep = Database::getStatement(sess, sql);
+    auto& st = prep.statement();
+    for (auto const& actIDStrKey : actIDStrKeys)
+    {
+        st.exchange(use(actIDStrKey));
+    }
+    loadData(prep, processor);
+}
+
 bool
 DataFrame::exists(Database& db, LedgerKey const& key)
 {
@@ -205,6 +249,14 @@ DataFrame::storeDelete(LedgerDelta& delta, Database& db) const
 void
 DataFrame::storeDelete(LedgerDelta& delta, Database& db, LedgerKey const& key)
 {
+    if (db.deferLedgerWrites())
+    {
+        putPendingEntry(key, nullptr, db);
+        delta.deleteEntry(key);
+        return;
+    }
+
+    flushCachedEntry(key, db);
     std::string actIDStrKey = KeyUtils::toStrKey(key.data().accountID);
     std::string dataName = key.data().dataName;
     auto timer = db.getDeleteTimer("data");
@@ -218,6 +270,82 @@ DataFrame::storeDelete(LedgerDelta& delta, Database& db, LedgerKey const& key)
     delta.deleteEntry(key);
 }
 
+void
+DataFrame::storeDeleteBulk(Database& db, std::vector<LedgerKey> const& keys)
+{
+    if (keys.empty())
+    {
+        return;
+    }
+
+    std::vector<std::string> actIDStrKeys, dataNames;
+    actIDStrKeys.reserve(keys.size());
+    dataNames.reserve(keys.size());
+    for (auto const& key : keys)
+    {
+        flushCachedEntry(key, db);
+        actIDStrKeys.emplace_back(KeyUtils::toStrKey(key.data().accountID));
+        dataNames.emplace_back(key.data().dataName);
+    }
+
+    // no "(a, b) IN (...)": the bundled SQLite doesn't have row values
+    auto timer = db.getDeleteTimer("data");
+    db.executeBulk(
+        keys.size(), 2,
+        [](size_t n) {
+            return "DELETE FROM accountdata WHERE " +
+                   Database::getPlaceholders(
+                       n, "(accountid = ? AND dataname = ?)", " OR ");
+        },
+        [&](soci::statement& st, size_t row) {
+            st.exchange(use(actIDStrKeys[row]));
+            st.exchange(use(dataNames[row]));
+        });
+}
+
+void
+DataFrame::storeAddBulk(Database& db, std::vector<LedgerEntry> const& entries)
+{
+    if (entries.empty())
+    {
+        return;
+    }
+
+    std::vector<std::string> actIDStrKeys, dataNames, dataValues;
+    std::vector<int> lastModifieds;
+    actIDStrKeys.reserve(entries.size());
+    dataNames.reserve(entries.size());
+    dataValues.reserve(entries.size());
+    lastModifieds.reserve(entries.size());
+    for (auto const& entry : entries)
+    {
+        auto const& data = entry.data.data();
+        actIDStrKeys.emplace_back(KeyUtils::toStrKey(data.accountID));
+        dataNames.emplace_back(data.dataName);
+        dataValues.emplace_back(bn::encode_b64(data.dataValue));
+        lastModifieds.emplace_back(entry.lastModifiedLedgerSeq);
+    }
+
+    auto timer = db.getInsertTimer("data");
+    auto inserted = db.executeBulk(
+        entries.size(), 4,
+        [](size_t n) {
+            return "INSERT INTO accountdata "
+                   "(accountid,dataname,datavalue,lastmodified) VALUES " +
+                   Database::getPlaceholders(n, "(?, ?, ?, ?)", ", ");
+        },
+        [&](soci::statement& st, size_t row) {
+            st.exchange(use(actIDStrKeys[row]));
+            st.exchange(use(dataNames[row]));
+            st.exchange(use(dataValues[row]));
+            st.exchange(use(lastModifieds[row]));
+        });
+    if (inserted != static_cast<long long>(entries.size()))
+    {
+        throw std::runtime_error("Could not update data in SQL");
+    }
+}
+
 void
 DataFrame::storeChange(LedgerDelta& delta, Database& db)
 {
@@ -235,25 +363,34 @@ DataFrame::storeUpdateHelper(LedgerDelta& delta, Database& db, bool insert)
 {
     touch(delta);
 
+    if (db.deferLedgerWrites())
+    {
+        putPendingEntry(db);
+        if (insert)
+        {
+            delta.addEntry(*this);
+        }
+        else
+        {
+            delta.modEntry(*this);
+        }
+        return;
+    }
+
+    flushCachedEntry(db);
+
     std::string actIDStrKey = KeyUtils::toStrKey(mData.accountID);
     std::string dataName = mData.dataName;
     std::string dataValue = bn::encode_b64(mData.dataValue);
 
-    string sql;
+    static const string insertSql("INSERT INTO accountdata "
+                                  "(accountid,dataname,datavalue,lastmodified)"
+                                  " VALUES (:aid,:dn,:dv,:lm)");
+    static const string updateSql(
+        "UPDATE accountdata SET datavalue=:dv,lastmodified=:lm "
+        " WHERE accountid=:aid AND dataname=:dn");
 
-    if (insert)
-    {
-        sql = "INSERT INTO accountdata "
-              "(accountid,dataname,datavalue,lastmodified)"
-              " VALUES (:aid,:dn,:dv,:lm)";
-    }
-    else
-    {
-        sql = "UPDATE accountdata SET datavalue=:dv,lastmodified=:lm "
-              " WHERE accountid=:aid AND dataname=:dn";
-    }
-
-    auto prep = db.getPreparedStatement(sql);
+    auto prep = db.getPreparedStatement(insert ? insertSql : updateSql);
     auto& st = prep.statement();
 
     st.exchange(use(actIDStrKey, "aid"));
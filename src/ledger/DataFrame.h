@@ -67,6 +67,12 @@ class DataFrame : public EntryFrame
     // Static helpers that don't assume an instance.
     static void storeDelete(LedgerDelta& delta, Database& db,
                             LedgerKey const& key);
+
+    // Bulk forms of storeDelete and storeAdd, see AccountFrame.
+    static void storeDeleteBulk(Database& db,
+                                std::vector<LedgerKey> const& keys);
+    static void storeAddBulk(Database& db,
+                             std::vector<LedgerEntry> const& entries);
     static bool exists(Database& db, LedgerKey const& key);
     static uint64_t countObjects(soci::session& sess);
 
@@ -82,6 +88,12 @@ class DataFrame : public EntryFrame
     static std::unordered_map<AccountID, std::vector<DataFrame::pointer>>
     loadAllData(Database& db);
 
+    // Load the entries with the given keys through `sess`, see AccountFrame.
+    // This may also pass other entries of the same accounts.
+    static void
+    loadEntries(soci::session& sess, std::vector<LedgerKey> const& keys,
+                std::function<void(LedgerEntry const&)> processor);
+
     static void dropAll(Database& db);
     static const char* kSQLCreateStatement1;
 };
@@ -4,7 +4,6 @@
 
 #include "ledger/EntryFrame.h"
 #include "LedgerManager.h"
-#include "crypto/Hex.h"
 #include "database/Database.h"
 #include "ledger/AccountFrame.h"
 #include "ledger/DataFrame.h"
@@ -109,30 +108,100 @@ EntryFrame::touch(LedgerDelta const& delta)
 void
 EntryFrame::flushCachedEntry(LedgerKey const& key, Database& db)
 {
-    auto s = binToHex(xdr::xdr_to_opaque(key));
-    db.getEntryCache().erase_if_exists(s);
+    db.getEntryCache().erase(key);
 }
 
 bool
 EntryFrame::cachedEntryExists(LedgerKey const& key, Database& db)
 {
-    auto s = binToHex(xdr::xdr_to_opaque(key));
-    return db.getEntryCache().exists(s);
+    return db.getEntryCache().exists(key);
 }
 
 std::shared_ptr<LedgerEntry const>
 EntryFrame::getCachedEntry(LedgerKey const& key, Database& db)
 {
-    auto s = binToHex(xdr::xdr_to_opaque(key));
-    return db.getEntryCache().get(s);
+    return db.getEntryCache().get(key);
 }
 
 void
 EntryFrame::putCachedEntry(LedgerKey const& key,
                            std::shared_ptr<LedgerEntry const> p, Database& db)
 {
-    auto s = binToHex(xdr::xdr_to_opaque(key));
-    db.getEntryCache().put(s, p);
+    db.getEntryCache().put(key, p);
+}
+
+// Keys per IN (...) query, to stay well below the database's limit on the
+// number of bound parameters.
+static const size_t kPrefetchBatchSize = 500;
+
+static void
+prefetchBatch(LedgerEntryType type, std::vector<LedgerKey> const& batch,
+              LedgerKeySet const& keys, Database& db)
+{
+    auto& cache = db.getEntryCache();
+    auto put = [&](LedgerEntry const& le) {
+        auto key = LedgerEntryKey(le);
+        // loading trust lines by account can return lines nobody asked for
+        if (keys.find(key) != keys.end())
+        {
+            cache.put(key, std::make_shared<LedgerEntry const>(le), true);
+        }
+    };
+
+    if (type == ACCOUNT)
+    {
+        AccountFrame::loadEntries(db.getSession(), batch, put);
+        // remember the accounts that don't exist, as loadAccount would
+        for (auto const& key : batch)
+        {
+            if (!cache.contains(key))
+            {
+                cache.put(key, nullptr, true);
+            }
+        }
+    }
+    else
+    {
+        TrustFrame::loadEntries(db.getSession(), batch, put);
+    }
+}
+
+size_t
+EntryFrame::prefetch(LedgerKeySet const& keys, Database& db)
+{
+    auto& cache = db.getEntryCache();
+    size_t count = 0;
+    for (auto type : {ACCOUNT, TRUSTLINE})
+    {
+        std::vector<LedgerKey> batch;
+        for (auto const& key : keys)
+        {
+            if (key.type() != type || cache.contains(key))
+            {
+                continue;
+            }
+            batch.push_back(key);
+            if (batch.size() == kPrefetchBatchSize)
+            {
+                prefetchBatch(type, batch, keys, db);
+                count += batch.size();
+                batch.clear();
+            }
+        }
+        if (!batch.empty())
+        {
+            prefetchBatch(type, batch, keys, db);
+            count += batch.size();
+        }
+    }
+    return count;
+}
+
+void
+EntryFrame::putPendingEntry(LedgerKey const& key,
+                            std::shared_ptr<LedgerEntry const> p, Database& db)
+{
+    db.getEntryCache().putPending(key, p);
 }
 
 void
@@ -147,6 +216,13 @@ EntryFrame::putCachedEntry(Database& db) const
     putCachedEntry(getKey(), std::make_shared<LedgerEntry const>(mEntry), db);
 }
 
+void
+EntryFrame::putPendingEntry(Database& db) const
+{
+    putPendingEntry(getKey(), std::make_shared<LedgerEntry const>(mEntry),
+                    db);
+}
+
 void
 EntryFrame::checkAgainstDatabase(LedgerEntry const& entry, Database& db)
 {
@@ -200,6 +276,13 @@ EntryFrame::storeAddOrChange(LedgerDelta& delta, Database& db)
 bool
 EntryFrame::exists(Database& db, LedgerKey const& key)
 {
+    // entries pending a write aren't in the database yet
+    auto& cache = db.getEntryCache();
+    if (db.deferLedgerWrites() && cache.contains(key))
+    {
+        return cache.get(key) != nullptr;
+    }
+
     switch (key.type())
     {
     case ACCOUNT:
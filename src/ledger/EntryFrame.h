@@ -7,6 +7,7 @@
 #include "bucket/LedgerCmp.h"
 #include "overlay/StellarXDR.h"
 #include "util/NonCopyable.h"
+#include <set>
 
 /*
 Frame
@@ -20,6 +21,8 @@ namespace stellar
 class Database;
 class LedgerDelta;
 
+typedef std::set<LedgerKey, LedgerEntryIdCmp> LedgerKeySet;
+
 class EntryFrame : public NonMovableOrCopyable
 {
   protected:
@@ -51,6 +54,19 @@ class EntryFrame : public NonMovableOrCopyable
                                std::shared_ptr<LedgerEntry const> p,
                                Database& db);
 
+    // With deferred ledger writes, the store methods record the value of the
+    // entry (null once deleted) in the cache instead of writing it to the
+    // database; LedgerDelta writes it when the ledger is committed.
+    static void putPendingEntry(LedgerKey const& key,
+                                std::shared_ptr<LedgerEntry const> p,
+                                Database& db);
+
+    // Load the account and trust line entries of `keys` that aren't cached
+    // yet into the entry cache, with a few batched queries instead of one
+    // query per entry. Other types of keys are ignored. Returns the number
+    // of keys that were looked up.
+    static size_t prefetch(LedgerKeySet const& keys, Database& db);
+
     // helpers to get/set the last modified field
     uint32 getLastModified() const;
     uint32& getLastModified();
@@ -63,6 +79,7 @@ class EntryFrame : public NonMovableOrCopyable
     // Member helpers that call cache flush/put for self.
     void flushCachedEntry(Database& db) const;
     void putCachedEntry(Database& db) const;
+    void putPendingEntry(Database& db) const;
 
     static void checkAgainstDatabase(LedgerEntry const& entry, Database& db);
 
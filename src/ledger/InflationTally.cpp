@@ -0,0 +1,329 @@
+// Copyright 2017 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "ledger/InflationTally.h"
+#include "crypto/KeyUtils.h"
+#include "crypto/SecretKey.h"
+#include "database/Database.h"
+#include "ledger/LedgerDelta.h"
+#include "medida/metrics_registry.h"
+#include "medida/timer.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace stellar
+{
+using xdr::operator==;
+
+// Accounts with a smaller balance don't vote, as in the query of
+// AccountFrame::processForInflation and load.
+static const int64 kMinVotingBalance = 1000000000;
+
+InflationTally::InflationTally(medida::MetricsRegistry& metrics)
+    : mLoaded(false)
+    , mCheckPending(false)
+    , mCheckMaxWinners(0)
+    , mCheckMinVotes(0)
+    , mLoadTimer(metrics.NewTimer({"ledger", "inflation-tally", "load"}))
+{
+}
+
+bool
+InflationTally::getVote(AccountEntry const& account, Vote& vote)
+{
+    if (!account.inflationDest || account.balance < kMinVotingBalance)
+    {
+        return false;
+    }
+    vote.mDest = *account.inflationDest;
+    vote.mBalance = account.balance;
+    return true;
+}
+
+void
+InflationTally::addVotes(AccountID const& dest, int64 votes)
+{
+    auto it = mCandidates.find(dest);
+    if (it == mCandidates.end())
+    {
+        it = mCandidates
+                 .emplace(dest, Rank(0, KeyUtils::toStrKey(dest)))
+                 .first;
+    }
+    else
+    {
+        mRanking.erase(it->second);
+    }
+
+    it->second.first += votes;
+    if (it->second.first == 0)
+    {
+        mCandidates.erase(it);
+    }
+    else
+    {
+        mRanking.emplace(it->second, dest);
+    }
+}
+
+void
+InflationTally::setVote(AccountID const& accountID, Vote const* vote)
+{
+    auto it = mVoters.find(accountID);
+    if (it != mVoters.end())
+    {
+        addVotes(it->second.mDest, -it->second.mBalance);
+        mVoters.erase(it);
+    }
+    if (vote)
+    {
+        addVotes(vote->mDest, vote->mBalance);
+        mVoters.emplace(accountID, *vote);
+    }
+}
+
+void
+InflationTally::load(Database& db)
+{
+    auto timer = mLoadTimer.TimeScope();
+    clear();
+
+    std::string accountID, inflationDest;
+    Vote vote;
+    auto prep = db.getPreparedStatement(
+        "SELECT accountid, inflationdest, balance FROM accounts WHERE "
+        "inflationdest IS NOT NULL AND balance >= 1000000000");
+    auto& st = prep.statement();
+    st.exchange(soci::into(accountID));
+    st.exchange(soci::into(inflationDest));
+    st.exchange(soci::into(vote.mBalance));
+    st.define_and_bind();
+    st.execute(true);
+    while (st.got_data())
+    {
+        vote.mDest = KeyUtils::fromStrKey<PublicKey>(inflationDest);
+        setVote(KeyUtils::fromStrKey<PublicKey>(accountID), &vote);
+        st.fetch();
+    }
+    mLoaded = true;
+}
+
+void
+InflationTally::refresh(Database& db)
+{
+    for (auto const& accountID : mDirty)
+    {
+        auto account = AccountFrame::loadAccount(accountID, db);
+        if (account)
+        {
+            update(account->getAccount());
+        }
+        else
+        {
+            remove(accountID);
+        }
+    }
+    mDirty.clear();
+}
+
+void
+InflationTally::update(AccountEntry const& account)
+{
+    if (mLoaded)
+    {
+        Vote vote;
+        bool votes = getVote(account, vote);
+        setVote(account.accountID, votes ? &vote : nullptr);
+    }
+}
+
+void
+InflationTally::remove(AccountID const& accountID)
+{
+    if (mLoaded)
+    {
+        setVote(accountID, nullptr);
+    }
+}
+
+void
+InflationTally::invalidate(AccountID const& accountID)
+{
+    if (mLoaded)
+    {
+        mDirty.insert(accountID);
+    }
+}
+
+void
+InflationTally::clear()
+{
+    mLoaded = false;
+    mVoters.clear();
+    mCandidates.clear();
+    mRanking.clear();
+    mDirty.clear();
+}
+
+void
+InflationTally::processForInflation(
+    std::function<bool(AccountFrame::InflationVotes const&)>
+        inflationProcessor,
+    int maxWinners, LedgerDelta const& delta, Database& db)
+{
+    if (!mLoaded)
+    {
+        load(db);
+    }
+    refresh(db);
+
+    // votes moved by the changes that aren't in the tally yet
+    std::unordered_map<AccountID, int64> moved;
+    delta.forEachPendingChange(
+        [&](LedgerKey const& key, EntryFrame::pointer const& entry) {
+            if (key.type() != ACCOUNT)
+            {
+                return;
+            }
+            auto it = mVoters.find(key.account().accountID);
+            if (it != mVoters.end())
+            {
+                moved[it->second.mDest] -= it->second.mBalance;
+            }
+            Vote vote;
+            if (entry && getVote(entry->mEntry.data.account(), vote))
+            {
+                moved[vote.mDest] += vote.mBalance;
+            }
+        });
+    rankCandidates(inflationProcessor, maxWinners, moved);
+}
+
+void
+InflationTally::rankCandidates(
+    std::function<bool(AccountFrame::InflationVotes const&)>
+        inflationProcessor,
+    int maxWinners, std::unordered_map<AccountID, int64> const& moved)
+{
+    std::vector<std::pair<Rank, AccountID>> changed;
+    for (auto const& m : moved)
+    {
+        auto it = mCandidates.find(m.first);
+        Rank rank = it != mCandidates.end()
+                        ? it->second
+                        : Rank(0, KeyUtils::toStrKey(m.first));
+        rank.first += m.second;
+        if (rank.first != 0)
+        {
+            changed.emplace_back(rank, m.first);
+        }
+    }
+    std::sort(changed.begin(), changed.end(),
+              [](std::pair<Rank, AccountID> const& a,
+                 std::pair<Rank, AccountID> const& b) {
+                  return b.first < a.first;
+              });
+
+    // merge both rankings, best first
+    auto r = mRanking.rbegin();
+    auto c = changed.begin();
+    AccountFrame::InflationVotes v;
+    for (int n = 0; n < maxWinners; ++n)
+    {
+        while (r != mRanking.rend() && moved.find(r->second) != moved.end())
+        {
+            ++r;
+        }
+        bool takeChanged =
+            c != changed.end() && (r == mRanking.rend() || r->first < c->first);
+        if (takeChanged)
+        {
+            v.mVotes = c->first.first;
+            v.mInflationDest = c->second;
+            ++c;
+        }
+        else if (r != mRanking.rend())
+        {
+            v.mVotes = r->first.first;
+            v.mInflationDest = r->second;
+            ++r;
+        }
+        else
+        {
+            break;
+        }
+        if (!inflationProcessor(v))
+        {
+            break;
+        }
+    }
+}
+
+void
+InflationTally::checkOnCommit(int maxWinners, int64 minVotes)
+{
+    mCheckPending = true;
+    mCheckMaxWinners = maxWinners;
+    mCheckMinVotes = minVotes;
+}
+
+void
+InflationTally::committed(Database& db)
+{
+    if (!mCheckPending)
+    {
+        return;
+    }
+    mCheckPending = false;
+
+    if (!mLoaded)
+    {
+        load(db);
+    }
+    refresh(db);
+    std::vector<AccountFrame::InflationVotes> winners;
+    int64 minVotes = mCheckMinVotes;
+    rankCandidates(
+        [&](AccountFrame::InflationVotes const& votes) {
+            if (votes.mVotes >= minVotes)
+            {
+                winners.push_back(votes);
+                return true;
+            }
+            return false;
+        },
+        mCheckMaxWinners, {});
+    checkWinners(winners, mCheckMaxWinners, minVotes, db);
+}
+
+void
+InflationTally::checkWinners(
+    std::vector<AccountFrame::InflationVotes> const& winners, int maxWinners,
+    int64 minVotes, Database& db)
+{
+    std::vector<AccountFrame::InflationVotes> expected;
+    AccountFrame::processForInflation(
+        [&](AccountFrame::InflationVotes const& votes) {
+            if (votes.mVotes >= minVotes)
+            {
+                expected.push_back(votes);
+                return true;
+            }
+            return false;
+        },
+        maxWinners, db);
+
+    bool same = winners.size() == expected.size();
+    for (size_t i = 0; same && i < winners.size(); ++i)
+    {
+        same = winners[i].mVotes == expected[i].mVotes &&
+               winners[i].mInflationDest == expected[i].mInflationDest;
+    }
+    if (!same)
+    {
+        throw std::runtime_error(
+            "inflation tally does not match the accounts table");
+    }
+}
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+// Copyright 2017 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "ledger/AccountFrame.h"
+#include "util/NonCopyable.h"
+#include <functional>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace medida
+{
+class MetricsRegistry;
+class Timer;
+}
+
+namespace stellar
+{
+class Database;
+class LedgerDelta;
+
+/**
+ * Running tally of the inflation votes of all accounts, so that inflation
+ * doesn't have to sum the balances of the whole accounts table.
+ *
+ * The tally is loaded from the database the first time inflation runs. From
+ * then on LedgerDelta applies the accounts it changed when the ledger is
+ * committed, and AccountFrame applies the accounts it stores in bulk. Votes
+ * from accounts changed since the last commit are taken from the pending
+ * LedgerDelta when inflation runs.
+ *
+ * Accounts of a ledger that is rolled back are reloaded from the database
+ * before the tally is next used. Like the entry cache, it is only used from
+ * the main thread.
+ */
+class InflationTally : NonMovableOrCopyable
+{
+    struct Vote
+    {
+        AccountID mDest;
+        int64 mBalance;
+    };
+
+    // Candidates are ranked by votes then inflation destination strkey, like
+    // AccountFrame::processForInflation ranks them.
+    typedef std::pair<int64, std::string> Rank;
+
+    bool mLoaded;
+    // see checkOnCommit
+    bool mCheckPending;
+    int mCheckMaxWinners;
+    int64 mCheckMinVotes;
+    std::unordered_map<AccountID, Vote> mVoters;
+    std::unordered_map<AccountID, Rank> mCandidates;
+    std::map<Rank, AccountID> mRanking;
+    std::unordered_set<AccountID> mDirty;
+
+    medida::Timer& mLoadTimer;
+
+    static bool getVote(AccountEntry const& account, Vote& vote);
+    void addVotes(AccountID const& dest, int64 votes);
+    void setVote(AccountID const& accountID, Vote const* vote);
+    void load(Database& db);
+    void refresh(Database& db);
+    // passes the candidates, with the votes in `moved` on top of the tally,
+    // to `inflationProcessor`, best first
+    void rankCandidates(
+        std::function<bool(AccountFrame::InflationVotes const&)>
+            inflationProcessor,
+        int maxWinners, std::unordered_map<AccountID, int64> const& moved);
+
+  public:
+    InflationTally(medida::MetricsRegistry& metrics);
+
+    // Record that `account` was stored, or that the account `accountID` was
+    // deleted, in the database.
+    void update(AccountEntry const& account);
+    void remove(AccountID const& accountID);
+
+    // Record that the account `accountID` may have changed in the database
+    // without the tally being told how.
+    void invalidate(AccountID const& accountID);
+
+    void clear();
+
+    // Same as AccountFrame::processForInflation, with the votes of accounts
+    // changed by `delta` (and the deltas it is nested in) included.
+    void processForInflation(
+        std::function<bool(AccountFrame::InflationVotes const&)>
+            inflationProcessor,
+        int maxWinners, LedgerDelta const& delta, Database& db);
+
+    // Check the tally against the accounts table, for PARANOID_MODE, once the
+    // ledger being applied is committed: its changes are only in the table
+    // then when ledger writes are deferred. The first `maxWinners` candidates
+    // with at least `minVotes` are compared.
+    void checkOnCommit(int maxWinners, int64 minVotes);
+
+    // Called by the outermost LedgerDelta once its changes are in the
+    // database and the tally; runs the check requested by checkOnCommit, if
+    // any.
+    void committed(Database& db);
+
+    // Throw if `winners` aren't the first `maxWinners` candidates with at
+    // least `minVotes` that AccountFrame::processForInflation finds.
+    static void
+    checkWinners(std::vector<AccountFrame::InflationVotes> const& winners,
+                 int maxWinners, int64 minVotes, Database& db);
+};
+}
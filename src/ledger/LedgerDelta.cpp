@@ -3,12 +3,19 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "ledger/LedgerDelta.h"
+#include "database/Database.h"
+#include "ledger/AccountFrame.h"
+#include "ledger/DataFrame.h"
+#include "ledger/OfferFrame.h"
+#include "ledger/TrustFrame.h"
 #include "main/Application.h"
 #include "main/Config.h"
 #include "medida/meter.h"
 #include "medida/metrics_registry.h"
 #include "xdr/Stellar-ledger.h"
 #include "xdrpp/printer.h"
+#include <algorithm>
+#include <map>
 
 namespace stellar
 {
@@ -105,13 +112,13 @@ LedgerDelta::addEntry(EntryFrame::pointer entry)
     {
         // delete + new is an update
         mDelete.erase(del_it);
-        mMod[k] = entry;
+        mMod[k] = std::move(entry);
     }
     else
     {
         assert(mNew.find(k) == mNew.end()); // double new
         assert(mMod.find(k) == mMod.end()); // mod + new is invalid
-        mNew[k] = entry;
+        mNew[k] = std::move(entry);
     }
 }
 
@@ -152,7 +159,7 @@ LedgerDelta::modEntry(EntryFrame::pointer entry)
     if (mod_it != mMod.end())
     {
         // collapse mod
-        mod_it->second = entry;
+        mod_it->second = std::move(entry);
     }
     else
     {
@@ -160,12 +167,12 @@ LedgerDelta::modEntry(EntryFrame::pointer entry)
         if (new_it != mNew.end())
         {
             // new + mod = new (with latest value)
-            new_it->second = entry;
+            new_it->second = std::move(entry);
         }
         else
         {
             assert(mDelete.find(k) == mDelete.end()); // delete + mod is illegal
-            mMod[k] = entry;
+            mMod[k] = std::move(entry);
         }
     }
 }
@@ -175,7 +182,8 @@ LedgerDelta::recordEntry(EntryFrame::pointer entry)
 {
     checkState();
     // keeps the old one around
-    mPrevious.insert(std::make_pair(entry->getKey(), entry));
+    auto k = entry->getKey();
+    mPrevious.emplace(std::move(k), std::move(entry));
 }
 
 void
@@ -183,6 +191,26 @@ LedgerDelta::mergeEntries(LedgerDelta& other)
 {
     checkState();
 
+    // "other" is discarded once merged, so its frames are moved rather than
+    // copied; the frames in a delta are never modified
+    if (mNew.empty() && mMod.empty() && mDelete.empty())
+    {
+        // nothing to collapse with, which is the case of the first
+        // operation of a transaction and of every transaction of a ledger
+        mNew.swap(other.mNew);
+        mMod.swap(other.mMod);
+        mDelete.swap(other.mDelete);
+        for (auto& p : other.mPrevious)
+        {
+            if (mMod.find(p.first) != mMod.end() ||
+                mDelete.find(p.first) != mDelete.end())
+            {
+                mPrevious.emplace(p.first, std::move(p.second));
+            }
+        }
+        return;
+    }
+
     // propagates mPrevious for deleted & modified entries
     for (auto& d : other.mDelete)
     {
@@ -190,20 +218,20 @@ LedgerDelta::mergeEntries(LedgerDelta& other)
         auto it = other.mPrevious.find(d);
         if (it != other.mPrevious.end())
         {
-            recordEntry(*it->second);
+            recordEntry(std::move(it->second));
         }
     }
     for (auto& n : other.mNew)
     {
-        addEntry(n.second);
+        addEntry(std::move(n.second));
     }
     for (auto& m : other.mMod)
     {
-        modEntry(m.second);
+        modEntry(std::move(m.second));
         auto it = other.mPrevious.find(m.first);
         if (it != other.mPrevious.end())
         {
-            recordEntry(*it->second);
+            recordEntry(std::move(it->second));
         }
     }
 }
@@ -224,6 +252,37 @@ LedgerDelta::commit()
         mOuterDelta->mergeEntries(*this);
         mOuterDelta = nullptr;
     }
+    else
+    {
+        if (mDb.deferLedgerWrites())
+        {
+            storePendingChanges();
+        }
+        mDb.getOrderBooks().commit();
+        auto& tally = mDb.getInflationTally();
+        for (auto const& n : mNew)
+        {
+            if (n.first.type() == ACCOUNT)
+            {
+                tally.update(n.second->mEntry.data.account());
+            }
+        }
+        for (auto const& m : mMod)
+        {
+            if (m.first.type() == ACCOUNT)
+            {
+                tally.update(m.second->mEntry.data.account());
+            }
+        }
+        for (auto const& d : mDelete)
+        {
+            if (d.type() == ACCOUNT)
+            {
+                tally.remove(d.account().accountID);
+            }
+        }
+        tally.committed(mDb);
+    }
     *mHeader = mCurrentHeader.mHeader;
     mHeader = nullptr;
 }
@@ -234,18 +293,133 @@ LedgerDelta::rollback()
     checkState();
     mHeader = nullptr;
 
+    // the database changes of an outermost delta aren't necessarily rolled
+    // back with it, so the inflation tally rereads those accounts
+    bool outermost = mOuterDelta == nullptr;
+    auto flush = [this, outermost](LedgerKey const& key) {
+        // pending writes of the outer deltas are only in the entry cache
+        EntryFrame::pointer pending;
+        if (mDb.deferLedgerWrites() && mOuterDelta &&
+            mOuterDelta->findPendingChange(key, pending))
+        {
+            EntryFrame::putPendingEntry(
+                key,
+                pending ? std::make_shared<LedgerEntry const>(pending->mEntry)
+                        : nullptr,
+                mDb);
+        }
+        else
+        {
+            EntryFrame::flushCachedEntry(key, mDb);
+        }
+        if (key.type() == OFFER)
+        {
+            mDb.getOrderBooks().invalidate(key.offer().offerID);
+        }
+        else if (key.type() == ACCOUNT && outermost)
+        {
+            mDb.getInflationTally().invalidate(key.account().accountID);
+        }
+    };
     for (auto& d : mDelete)
     {
-        EntryFrame::flushCachedEntry(d, mDb);
+        flush(d);
     }
     for (auto& n : mNew)
     {
-        EntryFrame::flushCachedEntry(n.first, mDb);
+        flush(n.first);
     }
     for (auto& m : mMod)
     {
-        EntryFrame::flushCachedEntry(m.first, mDb);
+        flush(m.first);
+    }
+}
+
+bool
+LedgerDelta::findPendingChange(LedgerKey const& key,
+                               EntryFrame::pointer& entry) const
+{
+    for (auto delta = this; delta; delta = delta->mOuterDelta)
+    {
+        auto it = delta->mNew.find(key);
+        if (it != delta->mNew.end())
+        {
+            entry = it->second;
+            return true;
+        }
+        it = delta->mMod.find(key);
+        if (it != delta->mMod.end())
+        {
+            entry = it->second;
+            return true;
+        }
+        if (delta->mDelete.find(key) != delta->mDelete.end())
+        {
+            entry = nullptr;
+            return true;
+        }
+    }
+    return false;
+}
+
+void
+LedgerDelta::storePendingChanges()
+{
+    // like BucketApplicator, changed entries are deleted then inserted again
+    // along with the new ones: one statement per table and kind of change
+    std::map<LedgerEntryType, std::vector<LedgerKey>> keys;
+    std::map<LedgerEntryType, std::vector<LedgerEntry>> live;
+    for (auto const& d : mDelete)
+    {
+        keys[d.type()].push_back(d);
+    }
+    for (auto const& m : mMod)
+    {
+        keys[m.first.type()].push_back(m.first);
+        live[m.first.type()].push_back(m.second->mEntry);
+    }
+    for (auto const& n : mNew)
+    {
+        live[n.first.type()].push_back(n.second->mEntry);
+    }
+
+    for (auto type : {ACCOUNT, TRUSTLINE, OFFER, DATA})
+    {
+        auto const& k = keys[type];
+        auto const& l = live[type];
+        switch (type)
+        {
+        case ACCOUNT:
+            AccountFrame::storeDeleteBulk(mDb, k);
+            AccountFrame::storeAddBulk(mDb, l);
+            break;
+        case TRUSTLINE:
+            TrustFrame::storeDeleteBulk(mDb, k);
+            TrustFrame::storeAddBulk(mDb, l);
+            break;
+        case OFFER:
+            OfferFrame::storeDeleteBulk(mDb, k);
+            OfferFrame::storeAddBulk(mDb, l);
+            break;
+        case DATA:
+            DataFrame::storeDeleteBulk(mDb, k);
+            DataFrame::storeAddBulk(mDb, l);
+            break;
+        }
+    }
+
+    // the bulk deletes dropped the entries from the cache, but their values
+    // are still good
+    auto& cache = mDb.getEntryCache();
+    for (auto const& l : getLiveEntries())
+    {
+        cache.put(LedgerEntryKey(l), std::make_shared<LedgerEntry const>(l));
+    }
+    for (auto const& d : mDelete)
+    {
+        cache.put(d, nullptr);
     }
+    cache.clearPending();
 }
 
 void
@@ -265,28 +439,63 @@ LedgerDelta::addCurrentMeta(LedgerEntryChanges& changes,
     }
 }
 
+static std::vector<EntryFrame const*>
+sortedEntries(std::vector<EntryFrame const*> entries)
+{
+    LedgerEntryIdCmp cmp;
+    std::sort(entries.begin(), entries.end(),
+              [&cmp](EntryFrame const* a, EntryFrame const* b) {
+                  return cmp(a->mEntry.data, b->mEntry.data);
+              });
+    return entries;
+}
+
 LedgerEntryChanges
 LedgerDelta::getChanges() const
 {
-    LedgerEntryChanges changes;
-
+    // changes are listed in key order within each kind, so that the meta
+    // doesn't depend on how keys hash
+    std::vector<EntryFrame const*> created, updated;
+    std::vector<LedgerKey const*> removed;
+    created.reserve(mNew.size());
+    updated.reserve(mMod.size());
+    removed.reserve(mDelete.size());
     for (auto const& k : mNew)
     {
-        changes.emplace_back(LEDGER_ENTRY_CREATED);
-        changes.back().created() = k.second->mEntry;
+        created.push_back(k.second.get());
     }
     for (auto const& k : mMod)
     {
-        addCurrentMeta(changes, k.first);
+        updated.push_back(k.second.get());
+    }
+    for (auto const& k : mDelete)
+    {
+        removed.push_back(&k);
+    }
+    LedgerEntryIdCmp cmp;
+    std::sort(removed.begin(), removed.end(),
+              [&cmp](LedgerKey const* a, LedgerKey const* b) {
+                  return cmp(*a, *b);
+              });
+
+    LedgerEntryChanges changes;
+    for (auto e : sortedEntries(std::move(created)))
+    {
+        changes.emplace_back(LEDGER_ENTRY_CREATED);
+        changes.back().created() = e->mEntry;
+    }
+    for (auto e : sortedEntries(std::move(updated)))
+    {
+        addCurrentMeta(changes, e->getKey());
         changes.emplace_back(LEDGER_ENTRY_UPDATED);
-        changes.back().updated() = k.second->mEntry;
+        changes.back().updated() = e->mEntry;
     }
 
-    for (auto const& k : mDelete)
+    for (auto k : removed)
     {
-        addCurrentMeta(changes, k);
+        addCurrentMeta(changes, *k);
         changes.emplace_back(LEDGER_ENTRY_REMOVED);
-        changes.back().removed() = k;
+        changes.back().removed() = *k;
     }
 
     return changes;
@@ -416,6 +625,37 @@ LedgerDelta::markMeters(Application& app) const
     }
 }
 
+void
+LedgerDelta::forEachPendingChange(
+    std::function<void(LedgerKey const&, EntryFrame::pointer const&)> f) const
+{
+    KeySet seen;
+    for (auto delta = this; delta; delta = delta->mOuterDelta)
+    {
+        for (auto const& n : delta->mNew)
+        {
+            if (seen.insert(n.first).second)
+            {
+                f(n.first, n.second);
+            }
+        }
+        for (auto const& m : delta->mMod)
+        {
+            if (seen.insert(m.first).second)
+            {
+                f(m.first, m.second);
+            }
+        }
+        for (auto const& d : delta->mDelete)
+        {
+            if (seen.insert(d).second)
+            {
+                f(d, nullptr);
+            }
+        }
+    }
+}
+
 void
 LedgerDelta::checkAgainstDatabase(Application& app) const
 {
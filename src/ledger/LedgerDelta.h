@@ -6,10 +6,12 @@
 
 #include "bucket/LedgerCmp.h"
 #include "ledger/EntryFrame.h"
+#include "ledger/LedgerEntryCache.h"
 #include "ledger/LedgerHeaderFrame.h"
 #include "xdrpp/marshal.h"
-#include <map>
-#include <set>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace stellar
 {
@@ -18,8 +20,14 @@ class Database;
 
 class LedgerDelta
 {
-    typedef std::map<LedgerKey, EntryFrame::pointer, LedgerEntryIdCmp>
+    // a delta is built for every transaction and operation, and merged into
+    // its parent entry by entry: hashing keys is much cheaper than ordering
+    // them
+    typedef std::unordered_map<LedgerKey, EntryFrame::pointer, LedgerKeyHash,
+                               LedgerKeyEqual>
         KeyEntryMap;
+    typedef std::unordered_set<LedgerKey, LedgerKeyHash, LedgerKeyEqual>
+        KeySet;
 
     LedgerDelta*
         mOuterDelta;       // set when this delta is nested inside another delta
@@ -32,7 +40,7 @@ class LedgerDelta
     // ledger entries
     KeyEntryMap mNew;
     KeyEntryMap mMod;
-    std::set<LedgerKey, LedgerEntryIdCmp> mDelete;
+    KeySet mDelete;
     KeyEntryMap mPrevious;
 
     Database& mDb; // Used strictly for rollback of db entry cache.
@@ -48,6 +56,15 @@ class LedgerDelta
     // merge "other" into current ledgerDelta
     void mergeEntries(LedgerDelta& other);
 
+    // finds the latest value of `key` (null if deleted) in this delta or the
+    // deltas it is nested in, returns false if none of them changed it
+    bool findPendingChange(LedgerKey const& key,
+                           EntryFrame::pointer& entry) const;
+
+    // writes the changes of an outermost delta to the database in bulk,
+    // when entry writes are deferred
+    void storePendingChanges();
+
     // helper method that adds a meta entry to "changes"
     // with the previous value of an entry if needed
     void addCurrentMeta(LedgerEntryChanges& changes,
@@ -92,6 +109,13 @@ class LedgerDelta
 
     LedgerEntryChanges getChanges() const;
 
+    // calls `f` with the key and latest value of every entry changed by this
+    // delta or the deltas it is nested in; the value is null for deleted
+    // entries
+    void forEachPendingChange(
+        std::function<void(LedgerKey const&, EntryFrame::pointer const&)> f)
+        const;
+
     // performs sanity checks against the local state
     void checkAgainstDatabase(Application& app) const;
 };
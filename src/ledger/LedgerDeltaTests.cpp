@@ -10,7 +10,10 @@
 #include "lib/catch.hpp"
 #include "main/Application.h"
 #include "test/test.h"
+#include "util/Logging.h"
 #include "util/Timer.h"
+#include <chrono>
+#include <map>
 
 using namespace stellar;
 
@@ -331,3 +334,58 @@ TEST_CASE("Ledger delta", "[ledger][ledgerdelta]")
         }
     }
 }
+
+TEST_CASE("ledger delta bench", "[ledgerdelta][bench][hide]")
+{
+    VirtualClock clock;
+    Application::pointer app = Application::create(clock, getTestConfig());
+    app->start();
+    LedgerDelta ledgerDelta(app->getLedgerManager().getCurrentLedgerHeader(),
+                            app->getDatabase());
+
+    size_t const nbAccounts = 1000;
+    std::vector<AccountFrame::pointer> accounts;
+    for (auto const& a :
+         LedgerTestUtils::generateValidAccountEntries(nbAccounts))
+    {
+        LedgerEntry le;
+        le.data.type(ACCOUNT);
+        le.data.account() = a;
+        accounts.emplace_back(std::make_shared<AccountFrame>(le));
+    }
+
+    // each operation moves funds between two accounts in its own
+    // transaction, the way a ledger full of payments goes through deltas
+    size_t const nbOps = 100000;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < nbOps; ++i)
+    {
+        LedgerDelta txDelta(ledgerDelta);
+        {
+            LedgerDelta opDelta(txDelta);
+            for (auto const& a : {accounts[i % nbAccounts],
+                                  accounts[(i * 7 + 1) % nbAccounts]})
+            {
+                opDelta.recordEntry(*a);
+                a->setSeqNum(a->getSeqNum() + 1);
+                opDelta.modEntry(*a);
+            }
+            opDelta.getChanges();
+            opDelta.commit();
+        }
+        txDelta.commit();
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    REQUIRE(ledgerDelta.getLiveEntries().size() == nbAccounts);
+    LOG(INFO) << "Applied " << nbOps << " operations through deltas in "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(end -
+                                                                     start)
+                     .count()
+              << "ms, "
+              << std::chrono::duration_cast<std::chrono::nanoseconds>(end -
+                                                                    start)
+                         .count() /
+                     nbOps
+              << "ns per operation";
+}
@@ -0,0 +1,282 @@
+// Copyright 2017 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "ledger/LedgerEntryCache.h"
+#include "crypto/SecretKey.h"
+#include "medida/counter.h"
+#include "medida/meter.h"
+#include "medida/metrics_registry.h"
+#include "xdrpp/marshal.h"
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+
+namespace stellar
+{
+
+// Rough per-item overhead on top of the key and entry: the list node, the
+// hash table node and bucket, and the shared_ptr control block.
+static const size_t kItemOverhead = 128;
+
+static void
+hashCombine(size_t& h, size_t v)
+{
+    h ^= v + 0x9e3779b9 + (h << 6) + (h >> 2);
+}
+
+template <uint32_t N>
+static size_t
+hashBytes(xdr::opaque_array<N> const& a)
+{
+    size_t h = 0;
+    for (auto b : a)
+    {
+        h = h * 31 + b;
+    }
+    return h;
+}
+
+static size_t
+hashAsset(Asset const& asset)
+{
+    size_t h = asset.type();
+    switch (asset.type())
+    {
+    case ASSET_TYPE_NATIVE:
+        break;
+    case ASSET_TYPE_CREDIT_ALPHANUM4:
+        hashCombine(h, std::hash<PublicKey>()(asset.alphaNum4().issuer));
+        hashCombine(h, hashBytes(asset.alphaNum4().assetCode));
+        break;
+    case ASSET_TYPE_CREDIT_ALPHANUM12:
+        hashCombine(h, std::hash<PublicKey>()(asset.alphaNum12().issuer));
+        hashCombine(h, hashBytes(asset.alphaNum12().assetCode));
+        break;
+    }
+    return h;
+}
+
+size_t
+LedgerKeyHash::operator()(LedgerKey const& key) const
+{
+    size_t h = key.type();
+    switch (key.type())
+    {
+    case ACCOUNT:
+        hashCombine(h, std::hash<PublicKey>()(key.account().accountID));
+        break;
+    case TRUSTLINE:
+        hashCombine(h, std::hash<PublicKey>()(key.trustLine().accountID));
+        hashCombine(h, hashAsset(key.trustLine().asset));
+        break;
+    case OFFER:
+        // offer ids are unique on their own
+        hashCombine(h, std::hash<uint64>()(key.offer().offerID));
+        break;
+    case DATA:
+        hashCombine(h, std::hash<PublicKey>()(key.data().accountID));
+        hashCombine(h, std::hash<std::string>()(key.data().dataName));
+        break;
+    }
+    return h;
+}
+
+bool
+LedgerKeyEqual::operator()(LedgerKey const& a, LedgerKey const& b) const
+{
+    using xdr::operator==;
+    return a == b;
+}
+
+LedgerEntryCache::LedgerEntryCache(medida::MetricsRegistry& metrics,
+                                   size_t maxBytes)
+    : mMaxBytes(maxBytes)
+    , mBytes(0)
+    , mPrefetchHit(metrics.NewMeter({"ledger", "prefetch", "hit"}, "entry"))
+    , mBytesCounter(metrics.NewCounter({"ledger", "entry-cache", "bytes"}))
+{
+    // indexed by LedgerEntryType
+    for (auto name : {"account", "trust", "offer", "data"})
+    {
+        mMeters.push_back(
+            {metrics.NewMeter({"ledger", name, "cache-hit"}, "entry"),
+             metrics.NewMeter({"ledger", name, "cache-miss"}, "entry"),
+             metrics.NewMeter({"ledger", name, "cache-evict"}, "entry")});
+    }
+}
+
+LedgerEntryCache::TypeMeters&
+LedgerEntryCache::meters(LedgerKey const& key)
+{
+    return mMeters.at(key.type());
+}
+
+bool
+LedgerEntryCache::exists(LedgerKey const& key)
+{
+    auto i = mIndex.find(key);
+    bool found = i != mIndex.end();
+    auto& m = meters(key);
+    (found ? m.mHit : m.mMiss).Mark();
+    if (found && i->second->mPrefetched)
+    {
+        mPrefetchHit.Mark();
+        i->second->mPrefetched = false;
+    }
+    return found;
+}
+
+bool
+LedgerEntryCache::contains(LedgerKey const& key) const
+{
+    return mIndex.find(key) != mIndex.end();
+}
+
+std::shared_ptr<LedgerEntry const>
+LedgerEntryCache::get(LedgerKey const& key)
+{
+    auto i = mIndex.find(key);
+    if (i == mIndex.end())
+    {
+        throw std::range_error("There is no such key in cache");
+    }
+    if (!i->second->mPending)
+    {
+        mItems.splice(mItems.begin(), mItems, i->second);
+    }
+    return i->second->mEntry;
+}
+
+void
+LedgerEntryCache::put(LedgerKey const& key,
+                      std::shared_ptr<LedgerEntry const> entry, bool prefetched)
+{
+    size_t bytes = kItemOverhead + 2 * sizeof(LedgerKey);
+    if (entry)
+    {
+        bytes += sizeof(LedgerEntry) + xdr::xdr_size(*entry);
+    }
+
+    auto i = mIndex.find(key);
+    if (i != mIndex.end())
+    {
+        auto it = i->second;
+        mBytes -= it->mBytes;
+        it->mEntry = std::move(entry);
+        it->mBytes = bytes;
+        it->mPrefetched = prefetched;
+        if (!it->mPending)
+        {
+            mItems.splice(mItems.begin(), mItems, it);
+        }
+    }
+    else
+    {
+        mItems.push_front(
+            Item{key, std::move(entry), bytes, prefetched, false});
+        mIndex.emplace(key, mItems.begin());
+    }
+    mBytes += bytes;
+    evict();
+    mBytesCounter.set_count(mBytes);
+}
+
+void
+LedgerEntryCache::eraseItem(ItemList::iterator it)
+{
+    mBytes -= it->mBytes;
+    mIndex.erase(it->mKey);
+    (it->mPending ? mPending : mItems).erase(it);
+}
+
+void
+LedgerEntryCache::evict()
+{
+    // always keep the most recently used item, even if it alone is over
+    // budget: callers expect what they just put to be there
+    while (mBytes > mMaxBytes && mItems.size() > 1)
+    {
+        auto last = std::prev(mItems.end());
+        meters(last->mKey).mEvict.Mark();
+        eraseItem(last);
+    }
+}
+
+void
+LedgerEntryCache::erase(LedgerKey const& key)
+{
+    auto i = mIndex.find(key);
+    if (i != mIndex.end())
+    {
+        eraseItem(i->second);
+        mBytesCounter.set_count(mBytes);
+    }
+}
+
+void
+LedgerEntryCache::clear()
+{
+    mIndex.clear();
+    mItems.clear();
+    mPending.clear();
+    mBytes = 0;
+    mBytesCounter.set_count(0);
+}
+
+void
+LedgerEntryCache::putPending(LedgerKey const& key,
+                             std::shared_ptr<LedgerEntry const> entry)
+{
+    put(key, std::move(entry));
+    auto it = mIndex.find(key)->second;
+    if (!it->mPending)
+    {
+        it->mPending = true;
+        mPending.splice(mPending.begin(), mItems, it);
+    }
+}
+
+void
+LedgerEntryCache::forEachPending(
+    std::function<void(LedgerKey const&,
+                       std::shared_ptr<LedgerEntry const> const&)>
+        f) const
+{
+    for (auto const& item : mPending)
+    {
+        f(item.mKey, item.mEntry);
+    }
+}
+
+void
+LedgerEntryCache::clearPending()
+{
+    for (auto& item : mPending)
+    {
+        item.mPending = false;
+    }
+    mItems.splice(mItems.begin(), mPending);
+    evict();
+    mBytesCounter.set_count(mBytes);
+}
+
+size_t
+LedgerEntryCache::size() const
+{
+    return mItems.size() + mPending.size();
+}
+
+size_t
+LedgerEntryCache::getBytes() const
+{
+    return mBytes;
+}
+
+size_t
+LedgerEntryCache::getMaxBytes() const
+{
+    return mMaxBytes;
+}
+}
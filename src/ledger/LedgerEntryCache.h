@@ -0,0 +1,132 @@
+#pragma once
+
+// Copyright 2017 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "overlay/StellarXDR.h"
+#include "util/NonCopyable.h"
+#include <functional>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace medida
+{
+class Counter;
+class Meter;
+class MetricsRegistry;
+}
+
+namespace stellar
+{
+
+// Hashes a LedgerKey field by field, without serializing it.
+struct LedgerKeyHash
+{
+    size_t operator()(LedgerKey const& key) const;
+};
+
+struct LedgerKeyEqual
+{
+    bool operator()(LedgerKey const& a, LedgerKey const& b) const;
+};
+
+/**
+ * LRU cache of LedgerEntries loaded from the database, keyed on their
+ * LedgerKey. A null entry records that the key is known not to exist.
+ *
+ * The capacity is a budget in bytes: each item is charged an estimate of its
+ * in-memory footprint, and the least recently used items are evicted once
+ * the total exceeds it. Hits, misses and evictions are metered per entry
+ * type, under "ledger.<type>.cache-{hit,miss,evict}".
+ *
+ * With DEFERRED_LEDGER_WRITES, the entries written while a ledger is applied
+ * are put here as pending until LedgerDelta writes them to the database.
+ * Pending items are kept apart from the LRU order and never evicted, as the
+ * database doesn't have them yet; they still count towards the byte total.
+ *
+ * Not thread-safe; like the main database session, it is only used from the
+ * main thread.
+ */
+class LedgerEntryCache : NonMovableOrCopyable
+{
+    struct Item
+    {
+        LedgerKey mKey;
+        std::shared_ptr<LedgerEntry const> mEntry;
+        size_t mBytes;
+        // put by a prefetch and not looked up since
+        bool mPrefetched;
+        // in mPending rather than mItems
+        bool mPending;
+    };
+    typedef std::list<Item> ItemList;
+
+    struct TypeMeters
+    {
+        medida::Meter& mHit;
+        medida::Meter& mMiss;
+        medida::Meter& mEvict;
+    };
+
+    size_t const mMaxBytes;
+    size_t mBytes;
+
+    // Most recently used first.
+    ItemList mItems;
+    ItemList mPending;
+    std::unordered_map<LedgerKey, ItemList::iterator, LedgerKeyHash,
+                       LedgerKeyEqual>
+        mIndex;
+
+    std::vector<TypeMeters> mMeters;
+    medida::Meter& mPrefetchHit;
+    medida::Counter& mBytesCounter;
+
+    TypeMeters& meters(LedgerKey const& key);
+    void eraseItem(ItemList::iterator it);
+    void evict();
+
+  public:
+    LedgerEntryCache(medida::MetricsRegistry& metrics, size_t maxBytes);
+
+    // Whether `key` is cached, either as an entry or as known to be absent.
+    // Counts as a cache hit or miss, and as a prefetch hit the first time a
+    // prefetched item is found.
+    bool exists(LedgerKey const& key);
+
+    // Same as exists, without counting anything.
+    bool contains(LedgerKey const& key) const;
+
+    // The entry cached for `key`, or null if it is known to be absent. Throws
+    // std::range_error if nothing is cached for `key`.
+    std::shared_ptr<LedgerEntry const> get(LedgerKey const& key);
+
+    // `prefetched` marks entries loaded ahead of being needed, to meter how
+    // many of them get used ("ledger.prefetch.hit").
+    void put(LedgerKey const& key, std::shared_ptr<LedgerEntry const> entry,
+             bool prefetched = false);
+    void erase(LedgerKey const& key);
+    void clear();
+
+    // Put `entry` (null if it was deleted) as the pending value of `key`.
+    void putPending(LedgerKey const& key,
+                    std::shared_ptr<LedgerEntry const> entry);
+
+    // Calls `f` with the key and value of every pending item.
+    void forEachPending(
+        std::function<void(LedgerKey const&,
+                           std::shared_ptr<LedgerEntry const> const&)>
+            f) const;
+
+    // Turn the pending items into ordinary cached ones, once the database
+    // has them.
+    void clearPending();
+
+    size_t size() const;
+    size_t getBytes() const;
+    size_t getMaxBytes() const;
+};
+}
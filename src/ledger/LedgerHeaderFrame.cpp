@@ -13,7 +13,6 @@
 #include "util/format.h"
 #include "util/types.h"
 #include "xdrpp/marshal.h"
-#include <util/basen.h>
 
 namespace stellar
 {
@@ -76,12 +75,12 @@ LedgerHeaderFrame::storeInsert(LedgerManager& ledgerManager) const
         prevHash(binToHex(mHeader.previousLedgerHash)),
         bucketListHash(binToHex(mHeader.bucketListHash));
 
-    auto headerBytes(xdr::xdr_to_opaque(mHeader));
+    auto& db = ledgerManager.getDatabase();
 
-    std::string headerEncoded;
-    headerEncoded = bn::encode_b64(headerBytes);
+    auto headerBytes(xdr::xdr_to_opaque(mHeader));
 
-    auto& db = ledgerManager.getDatabase();
+    HistoryBlob headerEncoded(db, db.getSession());
+    headerEncoded.set(headerBytes);
 
     // note: columns other than "data" are there to faciliate lookup/processing
     auto prep = db.getPreparedStatement(
@@ -95,7 +94,7 @@ LedgerHeaderFrame::storeInsert(LedgerManager& ledgerManager) const
     st.exchange(use(bucketListHash));
     st.exchange(use(mHeader.ledgerSeq));
     st.exchange(use(mHeader.scpValue.closeTime));
-    st.exchange(use(headerEncoded));
+    st.exchange(headerEncoded.use());
     st.define_and_bind();
     {
         auto timer = db.getInsertTimer("ledger-header");
@@ -108,13 +107,10 @@ LedgerHeaderFrame::storeInsert(LedgerManager& ledgerManager) const
 }
 
 LedgerHeaderFrame::pointer
-LedgerHeaderFrame::decodeFromData(std::string const& data)
+LedgerHeaderFrame::decodeFromData(std::vector<uint8_t> const& data)
 {
     LedgerHeader lh;
-    std::vector<uint8_t> decoded;
-    bn::decode_b64(data, decoded);
-
-    xdr::xdr_get g(&decoded.front(), &decoded.back() + 1);
+    xdr::xdr_get g(&data.front(), &data.back() + 1);
     xdr::xdr_argpack_archive(g, lh);
     g.done();
 
@@ -127,12 +123,12 @@ LedgerHeaderFrame::loadByHash(Hash const& hash, Database& db)
     LedgerHeaderFrame::pointer lhf;
 
     string hash_s(binToHex(hash));
-    string headerEncoded;
+    HistoryBlob headerEncoded(db, db.getSession());
 
     auto prep = db.getPreparedStatement("SELECT data FROM ledgerheaders "
                                         "WHERE ledgerhash = :h");
     auto& st = prep.statement();
-    st.exchange(into(headerEncoded));
+    st.exchange(headerEncoded.into());
     st.exchange(use(hash_s));
     st.define_and_bind();
     {
@@ -141,7 +137,9 @@ LedgerHeaderFrame::loadByHash(Hash const& hash, Database& db)
     }
     if (st.got_data())
     {
-        lhf = decodeFromData(headerEncoded);
+        std::vector<uint8_t> decoded;
+        headerEncoded.get(decoded);
+        lhf = decodeFromData(decoded);
         if (lhf->getHash() != hash)
         {
             // wrong hash
@@ -158,16 +156,18 @@ LedgerHeaderFrame::loadBySequence(uint32_t seq, Database& db,
 {
     LedgerHeaderFrame::pointer lhf;
 
-    string headerEncoded;
+    HistoryBlob headerEncoded(db, sess);
     {
         auto timer = db.getSelectTimer("ledger-header");
         sess << "SELECT data FROM ledgerheaders "
                 "WHERE ledgerseq = :s",
-            into(headerEncoded), use(seq);
+            headerEncoded.into(), use(seq);
     }
     if (sess.got_data())
     {
-        lhf = decodeFromData(headerEncoded);
+        std::vector<uint8_t> decoded;
+        headerEncoded.get(decoded);
+        lhf = decodeFromData(decoded);
         uint32_t loadedSeq = lhf->mHeader.ledgerSeq;
 
         if (loadedSeq != seq)
@@ -192,7 +192,7 @@ LedgerHeaderFrame::copyLedgerHeadersToStream(Database& db, soci::session& sess,
     uint32_t begin = ledgerSeq, end = ledgerSeq + ledgerCount;
     size_t n = 0;
 
-    string headerEncoded;
+    HistoryBlob headerEncoded(db, sess);
 
     assert(begin <= end);
 
@@ -200,15 +200,21 @@ LedgerHeaderFrame::copyLedgerHeadersToStream(Database& db, soci::session& sess,
         (sess.prepare << "SELECT data FROM ledgerheaders "
                          "WHERE ledgerseq >= :begin AND ledgerseq < :end ORDER "
                          "BY ledgerseq ASC",
-         into(headerEncoded), use(begin), use(end));
+         headerEncoded.into(), use(begin), use(end));
+
+    // decoding buffer, kept across rows
+    std::vector<uint8_t> decoded;
+    LedgerHeaderHistoryEntry lhe;
 
     st.execute(true);
     while (st.got_data())
     {
-        LedgerHeaderHistoryEntry lhe;
-        LedgerHeaderFrame::pointer lhf = decodeFromData(headerEncoded);
-        lhe.hash = lhf->getHash();
-        lhe.header = lhf->mHeader;
+        headerEncoded.get(decoded);
+        xdr::xdr_get g(&decoded.front(), &decoded.back() + 1);
+        xdr::xdr_argpack_archive(g, lhe.header);
+        g.done();
+        // the decoded bytes are the XDR the header hash is taken on
+        lhe.hash = sha256(decoded);
         CLOG(DEBUG, "Ledger") << "Streaming ledger-header "
                               << lhe.header.ledgerSeq;
         headersOut.writeOne(lhe);
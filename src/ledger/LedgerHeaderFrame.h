@@ -60,6 +60,7 @@ class LedgerHeaderFrame
     static const char* kSQLCreateStatement;
 
   private:
-    static LedgerHeaderFrame::pointer decodeFromData(std::string const& data);
+    static LedgerHeaderFrame::pointer
+    decodeFromData(std::vector<uint8_t> const& data);
 };
 }
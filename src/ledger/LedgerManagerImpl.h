@@ -24,6 +24,7 @@ namespace medida
 {
 class Timer;
 class Counter;
+class Meter;
 }
 
 namespace stellar
@@ -31,6 +32,7 @@ namespace stellar
 class Application;
 class Database;
 class LedgerDelta;
+class TxHistoryBatch;
 
 class LedgerManagerImpl : public LedgerManager
 {
@@ -44,6 +46,10 @@ class LedgerManagerImpl : public LedgerManager
     medida::Counter& mLedgerAge;
     medida::Counter& mLedgerStateCurrent;
     medida::Timer& mLedgerStateChanges;
+    medida::Timer& mPrefetchLoad;
+    medida::Meter& mPrefetchKeys;
+    medida::Meter& mPrefetchLoaded;
+    medida::Meter& mPrefetchHit;
     VirtualClock::time_point mLastClose;
     VirtualClock::time_point mLastStateChange;
 
@@ -55,11 +61,19 @@ class LedgerManagerImpl : public LedgerManager
                          HistoryManager::CatchupMode mode,
                          LedgerHeaderHistoryEntry const& lastClosed);
 
+    // Load the entries `txs` will need into the entry cache up front.
+    // Returns how long that took.
+    std::chrono::nanoseconds
+    prefetchTransactionData(std::vector<TransactionFramePtr>& txs);
+    void logPrefetch(std::chrono::nanoseconds prefetchTime,
+                     int64_t prefetchHits);
+
     void processFeesSeqNums(std::vector<TransactionFramePtr>& txs,
-                            LedgerDelta& delta);
+                            LedgerDelta& delta, TxHistoryBatch& history);
     void applyTransactions(std::vector<TransactionFramePtr>& txs,
                            LedgerDelta& ledgerDelta,
-                           TransactionResultSet& txResultSet);
+                           TransactionResultSet& txResultSet,
+                           TxHistoryBatch& history);
 
     void closeLedgerHelper(LedgerDelta const& delta);
     void advanceLedgerPointers();
@@ -3,18 +3,29 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "LedgerTestUtils.h"
+#include "crypto/KeyUtils.h"
+#include "crypto/SHA.h"
 #include "database/Database.h"
+#include "herder/TxSetFrame.h"
 #include "ledger/AccountFrame.h"
 #include "ledger/EntryFrame.h"
 #include "ledger/LedgerDelta.h"
+#include "ledger/LedgerEntryCache.h"
 #include "ledger/LedgerManager.h"
 #include "lib/catch.hpp"
 #include "main/Application.h"
 #include "main/Config.h"
+#include "medida/meter.h"
+#include "medida/metrics_registry.h"
+#include "test/TxTests.h"
 #include "test/test.h"
+#include "transactions/TransactionFrame.h"
 #include "util/Logging.h"
 #include "util/Timer.h"
 #include "util/types.h"
+#include "xdrpp/marshal.h"
+#include <numeric>
+#include <unordered_set>
 #include <xdrpp/autocheck.h>
 
 using namespace stellar;
@@ -137,3 +148,261 @@ TEST_CASE("DB cache interaction with transactions", "[ledger][dbcache]")
 
     CHECK(balance0 == acc->getAccount().balance);
 }
+
+TEST_CASE("ledger entry cache stays within its byte budget", "[ledger]")
+{
+    medida::MetricsRegistry metrics;
+    size_t const maxBytes = 64 * 1024;
+    LedgerEntryCache cache(metrics, maxBytes);
+
+    std::unordered_set<LedgerKey, LedgerKeyHash, LedgerKeyEqual> keys;
+    LedgerKey first, last;
+    for (auto const& e : LedgerTestUtils::generateValidLedgerEntries(1000))
+    {
+        last = LedgerEntryKey(e);
+        if (keys.empty())
+        {
+            first = last;
+        }
+        keys.insert(last);
+        cache.put(last, std::make_shared<LedgerEntry const>(e));
+        REQUIRE(cache.getBytes() <= maxBytes);
+    }
+    REQUIRE(cache.size() > 0);
+    REQUIRE(cache.size() < keys.size());
+
+    uint64_t evicted = 0;
+    for (auto name : {"account", "trust", "offer", "data"})
+    {
+        evicted +=
+            metrics.NewMeter({"ledger", name, "cache-evict"}, "entry").count();
+    }
+    REQUIRE(evicted + cache.size() == keys.size());
+
+    // the most recent entry is still there, the oldest one was evicted
+    REQUIRE(cache.exists(last));
+    REQUIRE(cache.get(last) != nullptr);
+    REQUIRE(!cache.exists(first));
+    REQUIRE_THROWS_AS(cache.get(first), std::range_error);
+
+    // negative entries are cached too, and erase forgets them
+    cache.put(first, nullptr);
+    REQUIRE(cache.exists(first));
+    REQUIRE(cache.get(first) == nullptr);
+    cache.erase(first);
+    REQUIRE(!cache.exists(first));
+
+    uint64_t hits = 0, misses = 0;
+    for (auto name : {"account", "trust", "offer", "data"})
+    {
+        hits +=
+            metrics.NewMeter({"ledger", name, "cache-hit"}, "entry").count();
+        misses +=
+            metrics.NewMeter({"ledger", name, "cache-miss"}, "entry").count();
+    }
+    REQUIRE(hits == 2);
+    REQUIRE(misses == 2);
+
+    cache.clear();
+    REQUIRE(cache.size() == 0);
+    REQUIRE(cache.getBytes() == 0);
+}
+
+static TxSetFramePtr
+makeTxSet(Application& app, std::vector<TransactionFramePtr> const& txs)
+{
+    auto txSet = std::make_shared<TxSetFrame>(
+        app.getLedgerManager().getLastClosedLedgerHeader().hash);
+    for (auto const& tx : txs)
+    {
+        txSet->add(tx);
+    }
+    txSet->sortForHash();
+    return txSet;
+}
+
+static void
+closeLedgerWith(Application& app, uint32 ledgerSeq,
+                std::vector<TransactionFramePtr> const& txs)
+{
+    txtest::closeLedgerOn(app, ledgerSeq, 1, 1, 2017, makeTxSet(app, txs));
+}
+
+TEST_CASE("deferred ledger writes", "[ledger][deferred]")
+{
+    using namespace txtest;
+
+    SECTION("pending entries are read back and flushed at commit")
+    {
+        Config cfg(getTestConfig());
+        cfg.DEFERRED_LEDGER_WRITES = true;
+        VirtualClock clock;
+        Application::pointer app = Application::create(clock, cfg);
+        app->start();
+        auto& db = app->getDatabase();
+
+        auto rows = [&](PublicKey const& k) {
+            int n = 0;
+            std::string id = KeyUtils::toStrKey(k);
+            db.getSession()
+                << "SELECT COUNT(*) FROM accounts WHERE accountid = :id",
+                soci::into(n), soci::use(id);
+            return n;
+        };
+        auto balance = [&](PublicKey const& k) -> int64_t {
+            auto account = AccountFrame::loadAccount(k, db);
+            return account ? account->getBalance() : -1;
+        };
+
+        auto a = getAccount("A").getPublicKey();
+        auto b = getAccount("B").getPublicKey();
+        {
+            LedgerDelta ledgerDelta(
+                app->getLedgerManager().getCurrentLedgerHeader(), db);
+            for (auto const& k : {a, b})
+            {
+                AccountFrame account(k);
+                account.getAccount().balance = 1000;
+                account.storeAdd(ledgerDelta, db);
+            }
+            REQUIRE(balance(a) == 1000);
+            REQUIRE(rows(a) == 0);
+
+            {
+                // rolling back restores the outer pending value
+                LedgerDelta delta(ledgerDelta);
+                auto account = AccountFrame::loadAccount(a, db);
+                account->getAccount().balance = 2000;
+                account->storeChange(delta, db);
+                REQUIRE(balance(a) == 2000);
+            }
+            REQUIRE(balance(a) == 1000);
+
+            {
+                LedgerDelta delta(ledgerDelta);
+                AccountFrame::loadAccount(b, db)->storeDelete(delta, db);
+                delta.commit();
+            }
+            REQUIRE(balance(b) == -1);
+            REQUIRE(rows(b) == 0);
+
+            ledgerDelta.commit();
+        }
+        REQUIRE(rows(a) == 1);
+        REQUIRE(rows(b) == 0);
+        db.getEntryCache().clear();
+        REQUIRE(balance(a) == 1000);
+        REQUIRE(balance(b) == -1);
+
+        {
+            // an outermost delta that isn't committed writes nothing
+            LedgerDelta ledgerDelta(
+                app->getLedgerManager().getCurrentLedgerHeader(), db);
+            auto account = AccountFrame::loadAccount(a, db);
+            account->getAccount().balance = 3000;
+            account->storeChange(ledgerDelta, db);
+            AccountFrame(b).storeAdd(ledgerDelta, db);
+        }
+        REQUIRE(balance(a) == 1000);
+        REQUIRE(balance(b) == -1);
+        REQUIRE(rows(b) == 0);
+    }
+
+    SECTION("ledgers close the same as with immediate writes")
+    {
+        auto closeLedgers = [](int instance, bool deferred) {
+            Config cfg(getTestConfig(instance));
+            cfg.DEFERRED_LEDGER_WRITES = deferred;
+            VirtualClock clock;
+            Application::pointer app = Application::create(clock, cfg);
+            app->start();
+
+            auto& lm = app->getLedgerManager();
+            auto const& networkID = app->getNetworkID();
+            auto root = getRoot(networkID);
+            auto a1 = getAccount("A");
+            auto gateway = getAccount("gateway");
+            Asset xlm;
+            xlm.type(ASSET_TYPE_NATIVE);
+            Asset idr = makeAsset(gateway, "IDR");
+            int64_t const amount = lm.getMinBalance(10) * 10;
+
+            auto close = [&](uint32 ledgerSeq,
+                             std::vector<TransactionFramePtr> const& txs) {
+                closeLedgerWith(*app, ledgerSeq, txs);
+            };
+
+            auto rootSeq = getAccountSeqNum(root, *app) + 1;
+            close(2, {createCreateAccountTx(networkID, root, a1, rootSeq,
+                                            amount),
+                      createCreateAccountTx(networkID, root, gateway,
+                                            rootSeq + 1, amount)});
+
+            auto a1Seq = getAccountSeqNum(a1, *app) + 1;
+            auto gatewaySeq = getAccountSeqNum(gateway, *app) + 1;
+            close(3, {createChangeTrust(networkID, a1, gateway, a1Seq++, "IDR",
+                                        1000000),
+                      manageOfferOp(networkID, 0, gateway, xlm, idr,
+                                    Price(1, 1), 500, gatewaySeq++)});
+
+            close(4, {createCreditPaymentTx(networkID, gateway, a1, idr,
+                                            gatewaySeq++, 1000),
+                      // underfunded, so its changes are rolled back
+                      createPaymentTx(networkID, gateway, root, gatewaySeq++,
+                                      amount * 10)});
+
+            // crosses the gateway's offer
+            close(5, {manageOfferOp(networkID, 0, a1, idr, xlm, Price(1, 1),
+                                    200, a1Seq++)});
+
+            return lm.getLastClosedLedgerHeader().hash;
+        };
+
+        REQUIRE(closeLedgers(0, false) == closeLedgers(1, true));
+    }
+}
+
+TEST_CASE("transaction history of a ledger is written in bulk",
+          "[ledger][history]")
+{
+    using namespace txtest;
+
+    VirtualClock clock;
+    Application::pointer app = Application::create(clock, getTestConfig());
+    app->start();
+    auto& db = app->getDatabase();
+    auto const& networkID = app->getNetworkID();
+    auto root = getRoot(networkID);
+
+    size_t const nbTxs = 20;
+    int64_t const amount = app->getLedgerManager().getMinBalance(0) * 10;
+    auto rootSeq = getAccountSeqNum(root, *app) + 1;
+    std::vector<TransactionFramePtr> txs;
+    for (size_t i = 0; i < nbTxs; ++i)
+    {
+        txs.push_back(createCreateAccountTx(
+            networkID, root, getAccount(("A" + std::to_string(i)).c_str()),
+            rootSeq++, amount));
+    }
+    auto res = closeLedgerOn(*app, 2, 1, 1, 2017, makeTxSet(*app, txs));
+    REQUIRE(res.size() == nbTxs);
+
+    std::vector<int> txIndexes(nbTxs), feeIndexes(nbTxs);
+    db.getSession() << "SELECT txindex FROM txhistory WHERE ledgerseq = 2 "
+                       "ORDER BY txindex",
+        soci::into(txIndexes);
+    db.getSession() << "SELECT txindex FROM txfeehistory WHERE ledgerseq = 2 "
+                       "ORDER BY txindex",
+        soci::into(feeIndexes);
+    std::vector<int> expected(nbTxs);
+    std::iota(expected.begin(), expected.end(), 1);
+    REQUIRE(txIndexes == expected);
+    REQUIRE(feeIndexes == expected);
+
+    // the stored results are the ones the ledger committed to
+    auto results = TransactionFrame::getTransactionHistoryResults(db, 2);
+    REQUIRE(sha256(xdr::xdr_to_opaque(results)) ==
+            app->getLedgerManager()
+                .getLastClosedLedgerHeader()
+                .header.txSetResultHash);
+}
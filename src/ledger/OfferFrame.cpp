@@ -135,19 +135,45 @@ OfferFrame::loadOffer(AccountID const& sellerID, uint64_t offerID, Database& db,
 {
     OfferFrame::pointer retOffer;
 
-    std::string actIDStrKey = KeyUtils::toStrKey(sellerID);
+    LedgerKey key;
+    key.type(OFFER);
+    key.offer().sellerID = sellerID;
+    key.offer().offerID = offerID;
+    if (cachedEntryExists(key, db))
+    {
+        auto p = getCachedEntry(key, db);
+        if (p)
+        {
+            retOffer = make_shared<OfferFrame>(*p);
+        }
+    }
+    else
+    {
+        std::string actIDStrKey = KeyUtils::toStrKey(sellerID);
 
-    std::string sql = offerColumnSelector;
-    sql += " WHERE sellerid = :id AND offerid = :offerid";
-    auto prep = db.getPreparedStatement(sql);
-    auto& st = prep.statement();
-    st.exchange(use(actIDStrKey));
-    st.exchange(use(offerID));
+        static const std::string sql =
+            std::string(offerColumnSelector) +
+            " WHERE sellerid = :id AND offerid = :offerid";
+        auto prep = db.getPreparedStatement(sql);
+        auto& st = prep.statement();
+        st.exchange(use(actIDStrKey));
+        st.exchange(use(offerID));
 
-    auto timer = db.getSelectTimer("offer");
-    loadOffers(prep, [&retOffer](LedgerEntry const& offer) {
-        retOffer = make_shared<OfferFrame>(offer);
-    });
+        {
+            auto timer = db.getSelectTimer("offer");
+            loadOffers(prep, [&retOffer](LedgerEntry const& offer) {
+                retOffer = make_shared<OfferFrame>(offer);
+            });
+        }
+        if (retOffer)
+        {
+            retOffer->putCachedEntry(db);
+        }
+        else
+        {
+            putCachedEntry(key, nullptr, db);
+        }
+    }
 
     if (delta && retOffer)
     {
@@ -260,6 +286,35 @@ void
 OfferFrame::loadBestOffers(size_t numOffers, size_t offset,
                            Asset const& selling, Asset const& buying,
                            vector<OfferFrame::pointer>& retOffers, Database& db)
+{
+    loadBestOffers(numOffers, offset, selling, buying,
+                   [&retOffers](LedgerEntry const& of) {
+                       retOffers.emplace_back(make_shared<OfferFrame>(of));
+                   },
+                   db);
+}
+
+void
+OfferFrame::loadAllBestOffers(
+    Asset const& selling, Asset const& buying,
+    std::function<void(LedgerEntry const&)> offerProcessor, Database& db)
+{
+    loadBestOffers(0, 0, selling, buying, offerProcessor, db);
+}
+
+OfferFrame::pointer
+OfferFrame::loadNextBestOffer(Asset const& selling, Asset const& buying,
+                              OfferFrame const* after, Database& db)
+{
+    auto offer = db.getOrderBooks().next(
+        selling, buying, after ? &after->getOffer() : nullptr, db);
+    return offer ? make_shared<OfferFrame>(*offer) : nullptr;
+}
+
+void
+OfferFrame::loadBestOffers(
+    size_t numOffers, size_t offset, Asset const& selling, Asset const& buying,
+    std::function<void(LedgerEntry const&)> offerProcessor, Database& db)
 {
     std::string sql = offerColumnSelector;
 
@@ -323,7 +378,11 @@ OfferFrame::loadBestOffers(size_t numOffers, size_t offset,
 
     // price is an approximation of the actual n/d (truncated math, 15 digits)
     // ordering by offerid gives precendence to older offers for fairness
-    sql += " ORDER BY price, offerid LIMIT :n OFFSET :o";
+    sql += " ORDER BY price, offerid";
+    if (numOffers != 0)
+    {
+        sql += " LIMIT :n OFFSET :o";
+    }
 
     auto prep = db.getPreparedStatement(sql);
     auto& st = prep.statement();
@@ -340,13 +399,14 @@ OfferFrame::loadBestOffers(size_t numOffers, size_t offset,
         st.exchange(use(buyingIssuerStrKey));
     }
 
-    st.exchange(use(numOffers));
-    st.exchange(use(offset));
+    if (numOffers != 0)
+    {
+        st.exchange(use(numOffers));
+        st.exchange(use(offset));
+    }
 
     auto timer = db.getSelectTimer("offer");
-    loadOffers(prep, [&retOffers](LedgerEntry const& of) {
-        retOffers.emplace_back(make_shared<OfferFrame>(of));
-    });
+    loadOffers(prep, offerProcessor);
 }
 
 void
@@ -385,6 +445,22 @@ OfferFrame::loadAllOffers(Database& db)
     return retOffers;
 }
 
+void
+OfferFrame::loadEntries(soci::session& sess, std::vector<LedgerKey> const& keys,
+                        std::function<void(LedgerEntry const&)> processor)
+{
+    std::string sql = offerColumnSelector;
+    sql += " WHERE offerid IN (" + Database::getPlaceholders(keys.size()) +
+           ")";
+    auto prep = Database::getStatement(sess, sql);
+    auto& st = prep.statement();
+    for (auto const& key : keys)
+    {
+        st.exchange(use(key.offer().offerID));
+    }
+    loadOffers(prep, processor);
+}
+
 bool
 OfferFrame::exists(Database& db, LedgerKey const& key)
 {
@@ -420,15 +496,175 @@ OfferFrame::storeDelete(LedgerDelta& delta, Database& db) const
 void
 OfferFrame::storeDelete(LedgerDelta& delta, Database& db, LedgerKey const& key)
 {
+    if (db.deferLedgerWrites())
+    {
+        putPendingEntry(key, nullptr, db);
+        db.getOrderBooks().erase(key.offer().offerID);
+        delta.deleteEntry(key);
+        return;
+    }
+
+    flushCachedEntry(key, db);
     auto timer = db.getDeleteTimer("offer");
     auto prep = db.getPreparedStatement("DELETE FROM offers WHERE offerid=:s");
     auto& st = prep.statement();
     st.exchange(use(key.offer().offerID));
     st.define_and_bind();
     st.execute(true);
+    db.getOrderBooks().erase(key.offer().offerID);
     delta.deleteEntry(key);
 }
 
+void
+OfferFrame::storeDeleteBulk(Database& db, std::vector<LedgerKey> const& keys)
+{
+    if (keys.empty())
+    {
+        return;
+    }
+
+    std::vector<long long> offerIDs;
+    offerIDs.reserve(keys.size());
+    for (auto const& key : keys)
+    {
+        flushCachedEntry(key, db);
+        db.getOrderBooks().erase(key.offer().offerID);
+        offerIDs.emplace_back(key.offer().offerID);
+    }
+
+    auto timer = db.getDeleteTimer("offer");
+    db.executeBulk(offerIDs.size(), 1,
+                   [](size_t n) {
+                       return "DELETE FROM offers WHERE offerid IN (" +
+                              Database::getPlaceholders(n) + ")";
+                   },
+                   [&](soci::statement& st, size_t row) {
+                       st.exchange(use(offerIDs[row]));
+                   });
+}
+
+// Column values for the asset of an offer: its type, and its code and
+// issuer unless it is native.
+static void
+pushAsset(Asset const& asset, std::vector<int>& types,
+          std::vector<std::string>& codes, std::vector<std::string>& issuers,
+          std::vector<soci::indicator>& inds)
+{
+    types.emplace_back(asset.type());
+    codes.emplace_back();
+    issuers.emplace_back();
+    if (asset.type() == ASSET_TYPE_CREDIT_ALPHANUM4)
+    {
+        issuers.back() = KeyUtils::toStrKey(asset.alphaNum4().issuer);
+        assetCodeToStr(asset.alphaNum4().assetCode, codes.back());
+        inds.emplace_back(soci::i_ok);
+    }
+    else if (asset.type() == ASSET_TYPE_CREDIT_ALPHANUM12)
+    {
+        issuers.back() = KeyUtils::toStrKey(asset.alphaNum12().issuer);
+        assetCodeToStr(asset.alphaNum12().assetCode, codes.back());
+        inds.emplace_back(soci::i_ok);
+    }
+    else
+    {
+        inds.emplace_back(soci::i_null);
+    }
+}
+
+void
+OfferFrame::storeAddBulk(Database& db, std::vector<LedgerEntry> const& entries)
+{
+    if (entries.empty())
+    {
+        return;
+    }
+
+    size_t n = entries.size();
+    std::vector<std::string> actIDStrKeys;
+    std::vector<long long> offerIDs, amounts;
+    std::vector<int> sellingTypes, buyingTypes, priceNs, priceDs, flags,
+        lastModifieds;
+    std::vector<std::string> sellingAssetCodes, sellingIssuerStrKeys,
+        buyingAssetCodes, buyingIssuerStrKeys;
+    std::vector<soci::indicator> sellingInds, buyingInds;
+    std::vector<double> prices;
+    actIDStrKeys.reserve(n);
+    offerIDs.reserve(n);
+    amounts.reserve(n);
+    sellingTypes.reserve(n);
+    buyingTypes.reserve(n);
+    priceNs.reserve(n);
+    priceDs.reserve(n);
+    flags.reserve(n);
+    lastModifieds.reserve(n);
+    sellingAssetCodes.reserve(n);
+    sellingIssuerStrKeys.reserve(n);
+    buyingAssetCodes.reserve(n);
+    buyingIssuerStrKeys.reserve(n);
+    sellingInds.reserve(n);
+    buyingInds.reserve(n);
+    prices.reserve(n);
+
+    for (auto const& entry : entries)
+    {
+        auto const& offer = entry.data.offer();
+        if (!isValid(offer))
+        {
+            throw std::runtime_error("Invalid asset");
+        }
+        actIDStrKeys.emplace_back(KeyUtils::toStrKey(offer.sellerID));
+        offerIDs.emplace_back(offer.offerID);
+        pushAsset(offer.selling, sellingTypes, sellingAssetCodes,
+                  sellingIssuerStrKeys, sellingInds);
+        pushAsset(offer.buying, buyingTypes, buyingAssetCodes,
+                  buyingIssuerStrKeys, buyingInds);
+        amounts.emplace_back(offer.amount);
+        priceNs.emplace_back(offer.price.n);
+        priceDs.emplace_back(offer.price.d);
+        prices.emplace_back(double(offer.price.n) / double(offer.price.d));
+        flags.emplace_back(offer.flags);
+        lastModifieds.emplace_back(entry.lastModifiedLedgerSeq);
+    }
+
+    auto timer = db.getInsertTimer("offer");
+    auto inserted = db.executeBulk(
+        n, 14,
+        [](size_t rows) {
+            return "INSERT INTO offers (sellerid,offerid,"
+                   "sellingassettype,sellingassetcode,sellingissuer,"
+                   "buyingassettype,buyingassetcode,buyingissuer,"
+                   "amount,pricen,priced,price,flags,lastmodified) VALUES " +
+                   Database::getPlaceholders(
+                       rows, "(?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)",
+                       ", ");
+        },
+        [&](soci::statement& st, size_t row) {
+            st.exchange(use(actIDStrKeys[row]));
+            st.exchange(use(offerIDs[row]));
+            st.exchange(use(sellingTypes[row]));
+            st.exchange(use(sellingAssetCodes[row], sellingInds[row]));
+            st.exchange(use(sellingIssuerStrKeys[row], sellingInds[row]));
+            st.exchange(use(buyingTypes[row]));
+            st.exchange(use(buyingAssetCodes[row], buyingInds[row]));
+            st.exchange(use(buyingIssuerStrKeys[row], buyingInds[row]));
+            st.exchange(use(amounts[row]));
+            st.exchange(use(priceNs[row]));
+            st.exchange(use(priceDs[row]));
+            st.exchange(use(prices[row]));
+            st.exchange(use(flags[row]));
+            st.exchange(use(lastModifieds[row]));
+        });
+    if (inserted != static_cast<long long>(n))
+    {
+        throw std::runtime_error("Could not update data in SQL");
+    }
+
+    for (auto const& entry : entries)
+    {
+        db.getOrderBooks().put(entry);
+    }
+}
+
 double
 OfferFrame::computePrice() const
 {
@@ -457,6 +693,23 @@ OfferFrame::storeUpdateHelper(LedgerDelta& delta, Database& db, bool insert)
         throw std::runtime_error("Invalid asset");
     }
 
+    if (db.deferLedgerWrites())
+    {
+        putPendingEntry(db);
+        db.getOrderBooks().put(mEntry);
+        if (insert)
+        {
+            delta.addEntry(*this);
+        }
+        else
+        {
+            delta.modEntry(*this);
+        }
+        return;
+    }
+
+    flushCachedEntry(db);
+
     std::string actIDStrKey = KeyUtils::toStrKey(mOffer.sellerID);
 
     unsigned int sellingType = mOffer.selling.type();
@@ -495,26 +748,20 @@ OfferFrame::storeUpdateHelper(LedgerDelta& delta, Database& db, bool insert)
         buying_ind = soci::i_ok;
     }
 
-    string sql;
-
-    if (insert)
-    {
-        sql = "INSERT INTO offers (sellerid,offerid,"
-              "sellingassettype,sellingassetcode,sellingissuer,"
-              "buyingassettype,buyingassetcode,buyingissuer,"
-              "amount,pricen,priced,price,flags,lastmodified) VALUES "
-              "(:sid,:oid,:sat,:sac,:si,:bat,:bac,:bi,:a,:pn,:pd,:p,:f,:l)";
-    }
-    else
-    {
-        sql = "UPDATE offers SET sellingassettype=:sat "
-              ",sellingassetcode=:sac,sellingissuer=:si,"
-              "buyingassettype=:bat,buyingassetcode=:bac,buyingissuer=:bi,"
-              "amount=:a,pricen=:pn,priced=:pd,price=:p,flags=:f,"
-              "lastmodified=:l WHERE offerid=:oid";
-    }
-
-    auto prep = db.getPreparedStatement(sql);
+    static const string insertSql(
+        "INSERT INTO offers (sellerid,offerid,"
+        "sellingassettype,sellingassetcode,sellingissuer,"
+        "buyingassettype,buyingassetcode,buyingissuer,"
+        "amount,pricen,priced,price,flags,lastmodified) VALUES "
+        "(:sid,:oid,:sat,:sac,:si,:bat,:bac,:bi,:a,:pn,:pd,:p,:f,:l)");
+    static const string updateSql(
+        "UPDATE offers SET sellingassettype=:sat "
+        ",sellingassetcode=:sac,sellingissuer=:si,"
+        "buyingassettype=:bat,buyingassetcode=:bac,buyingissuer=:bi,"
+        "amount=:a,pricen=:pn,priced=:pd,price=:p,flags=:f,"
+        "lastmodified=:l WHERE offerid=:oid");
+
+    auto prep = db.getPreparedStatement(insert ? insertSql : updateSql);
     auto& st = prep.statement();
 
     if (insert)
@@ -545,6 +792,7 @@ OfferFrame::storeUpdateHelper(LedgerDelta& delta, Database& db, bool insert)
     {
         throw std::runtime_error("could not update SQL");
     }
+    db.getOrderBooks().put(mEntry);
 
     if (insert)
     {
@@ -559,6 +807,7 @@ OfferFrame::storeUpdateHelper(LedgerDelta& delta, Database& db, bool insert)
 void
 OfferFrame::dropAll(Database& db)
 {
+    db.getOrderBooks().clear();
     db.getSession() << "DROP TABLE IF EXISTS offers;";
     db.getSession() << kSQLCreateStatement1;
     db.getSession() << kSQLCreateStatement2;
@@ -23,6 +23,11 @@ class OfferFrame : public EntryFrame
     static void
     loadOffers(StatementContext& prep,
                std::function<void(LedgerEntry const&)> offerProcessor);
+    static void
+    loadBestOffers(size_t numOffers, size_t offset, Asset const& selling,
+                   Asset const& buying,
+                   std::function<void(LedgerEntry const&)> offerProcessor,
+                   Database& db);
 
     double computePrice() const;
 
@@ -81,6 +86,12 @@ class OfferFrame : public EntryFrame
     // Static helpers that don't assume an instance.
     static void storeDelete(LedgerDelta& delta, Database& db,
                             LedgerKey const& key);
+
+    // Bulk forms of storeDelete and storeAdd, see AccountFrame.
+    static void storeDeleteBulk(Database& db,
+                                std::vector<LedgerKey> const& keys);
+    static void storeAddBulk(Database& db,
+                             std::vector<LedgerEntry> const& entries);
     static bool exists(Database& db, LedgerKey const& key);
     static uint64_t countObjects(soci::session& sess);
 
@@ -93,6 +104,19 @@ class OfferFrame : public EntryFrame
                                std::vector<OfferFrame::pointer>& retOffers,
                                Database& db);
 
+    // Load all the offers selling `selling` for `buying`, best first.
+    static void
+    loadAllBestOffers(Asset const& selling, Asset const& buying,
+                      std::function<void(LedgerEntry const&)> offerProcessor,
+                      Database& db);
+
+    // The best offer selling `selling` for `buying` that comes after `after`
+    // (or the best one if `after` is null), in the order loadBestOffers
+    // returns them. Uses the in-memory order book rather than querying the
+    // database each time.
+    static pointer loadNextBestOffer(Asset const& selling, Asset const& buying,
+                                     OfferFrame const* after, Database& db);
+
     static void loadOffers(AccountID const& accountID,
                            std::vector<OfferFrame::pointer>& retOffers,
                            Database& db);
@@ -101,6 +125,11 @@ class OfferFrame : public EntryFrame
     static std::unordered_map<AccountID, std::vector<OfferFrame::pointer>>
     loadAllOffers(Database& db);
 
+    // Load the entries with the given keys through `sess`, see AccountFrame.
+    static void
+    loadEntries(soci::session& sess, std::vector<LedgerKey> const& keys,
+                std::function<void(LedgerEntry const&)> processor);
+
     static void dropAll(Database& db);
     static const char* kSQLCreateStatement1;
     static const char* kSQLCreateStatement2;
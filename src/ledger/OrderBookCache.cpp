@@ -0,0 +1,185 @@
+// Copyright 2017 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "ledger/OrderBookCache.h"
+#include "database/Database.h"
+#include "ledger/OfferFrame.h"
+#include "medida/counter.h"
+#include "medida/metrics_registry.h"
+#include "medida/timer.h"
+#include <iterator>
+
+namespace stellar
+{
+
+bool
+OrderBookCache::AssetPairCmp::operator()(AssetPair const& a,
+                                         AssetPair const& b) const
+{
+    using xdr::operator<;
+    using xdr::operator==;
+    if (a.first == b.first)
+    {
+        return a.second < b.second;
+    }
+    return a.first < b.first;
+}
+
+OrderBookCache::OrderBookCache(medida::MetricsRegistry& metrics)
+    : mLoadTimer(metrics.NewTimer({"ledger", "order-book", "load"}))
+    , mOfferCount(metrics.NewCounter({"ledger", "order-book", "offers"}))
+{
+}
+
+OrderBookCache::Position
+OrderBookCache::getPosition(OfferEntry const& offer)
+{
+    // same as the price column loadBestOffers sorts on
+    return Position(double(offer.price.n) / double(offer.price.d),
+                    offer.offerID);
+}
+
+OrderBookCache::BookMap::iterator
+OrderBookCache::load(Asset const& selling, Asset const& buying, Database& db)
+{
+    auto timer = mLoadTimer.TimeScope();
+    auto book = mBooks.emplace(AssetPair(selling, buying), Book()).first;
+    OfferFrame::loadAllBestOffers(
+        selling, buying,
+        [this, book](LedgerEntry const& of) {
+            auto pos = getPosition(of.data.offer());
+            book->second.emplace(pos, std::make_shared<LedgerEntry const>(of));
+            mOffers[of.data.offer().offerID] = Location{book, pos};
+        },
+        db);
+
+    // with deferred ledger writes, the offers written since the last commit
+    // are only in the entry cache
+    db.getEntryCache().forEachPending(
+        [this, book](LedgerKey const& key,
+                     std::shared_ptr<LedgerEntry const> const& entry) {
+            using xdr::operator==;
+            if (key.type() != OFFER)
+            {
+                return;
+            }
+            auto offerID = key.offer().offerID;
+            auto it = mOffers.find(offerID);
+            if (it != mOffers.end() && it->second.mBook == book)
+            {
+                book->second.erase(it->second.mPosition);
+                mOffers.erase(it);
+            }
+            if (entry && entry->data.offer().selling == book->first.first &&
+                entry->data.offer().buying == book->first.second)
+            {
+                auto pos = getPosition(entry->data.offer());
+                book->second[pos] = entry;
+                mOffers[offerID] = Location{book, pos};
+            }
+        });
+    mOfferCount.inc(book->second.size());
+    return book;
+}
+
+std::shared_ptr<LedgerEntry const>
+OrderBookCache::next(Asset const& selling, Asset const& buying,
+                     OfferEntry const* after, Database& db)
+{
+    auto book = mBooks.find(AssetPair(selling, buying));
+    if (book == mBooks.end())
+    {
+        book = load(selling, buying, db);
+    }
+    auto& offers = book->second;
+    auto it = after ? offers.upper_bound(getPosition(*after)) : offers.begin();
+    if (it == offers.end())
+    {
+        return nullptr;
+    }
+    return it->second;
+}
+
+void
+OrderBookCache::remove(uint64 offerID)
+{
+    auto it = mOffers.find(offerID);
+    if (it != mOffers.end())
+    {
+        auto book = it->second.mBook;
+        book->second.erase(it->second.mPosition);
+        mRemoved.emplace(offerID, book);
+        mOffers.erase(it);
+        mOfferCount.dec();
+    }
+}
+
+void
+OrderBookCache::put(LedgerEntry const& offer)
+{
+    auto const& oe = offer.data.offer();
+    remove(oe.offerID);
+
+    auto book = mBooks.find(AssetPair(oe.selling, oe.buying));
+    if (book != mBooks.end())
+    {
+        auto pos = getPosition(oe);
+        book->second[pos] = std::make_shared<LedgerEntry const>(offer);
+        mOffers[oe.offerID] = Location{book, pos};
+        mOfferCount.inc();
+    }
+}
+
+void
+OrderBookCache::erase(uint64 offerID)
+{
+    remove(offerID);
+}
+
+void
+OrderBookCache::drop(BookMap::iterator book)
+{
+    for (auto const& o : book->second)
+    {
+        mOffers.erase(o.first.second);
+    }
+    mOfferCount.dec(book->second.size());
+    for (auto it = mRemoved.begin(); it != mRemoved.end();)
+    {
+        it = (it->second == book) ? mRemoved.erase(it) : std::next(it);
+    }
+    mBooks.erase(book);
+}
+
+void
+OrderBookCache::invalidate(uint64 offerID)
+{
+    auto it = mOffers.find(offerID);
+    if (it != mOffers.end())
+    {
+        drop(it->second.mBook);
+    }
+    auto removed = mRemoved.find(offerID);
+    while (removed != mRemoved.end())
+    {
+        drop(removed->second);
+        removed = mRemoved.find(offerID);
+    }
+}
+
+void
+OrderBookCache::commit()
+{
+    mRemoved.clear();
+}
+
+void
+OrderBookCache::clear()
+{
+    mBooks.clear();
+    mOffers.clear();
+    mRemoved.clear();
+    mOfferCount.clear();
+}
+}
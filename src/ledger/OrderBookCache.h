@@ -0,0 +1,98 @@
+#pragma once
+
+// Copyright 2017 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "overlay/StellarXDR.h"
+#include "util/NonCopyable.h"
+#include <map>
+#include <memory>
+#include <unordered_map>
+
+namespace medida
+{
+class Counter;
+class MetricsRegistry;
+class Timer;
+}
+
+namespace stellar
+{
+class Database;
+
+/**
+ * In-memory copies of the order books crossed by OfferExchange, so that
+ * walking a book does not cost a SQL query per handful of offers.
+ *
+ * The book of an asset pair is loaded from the offers table the first time
+ * it is walked, and kept in the same order as OfferFrame::loadBestOffers
+ * returns offers: by price, then offer id. OfferFrame keeps loaded books up
+ * to date as it writes offers. With deferred ledger writes, the offers still
+ * pending in the entry cache are applied on top of the table when loading.
+ *
+ * The database writes can still be rolled back, so the cache also remembers
+ * which books offers were removed from since the last ledger was committed.
+ * LedgerDelta::rollback invalidates the books holding any offer it touched,
+ * and they are reloaded on next use. Like the entry cache, it is only used
+ * from the main thread.
+ */
+class OrderBookCache : NonMovableOrCopyable
+{
+    typedef std::pair<Asset, Asset> AssetPair; // selling, buying
+    struct AssetPairCmp
+    {
+        bool operator()(AssetPair const& a, AssetPair const& b) const;
+    };
+
+    typedef std::pair<double, uint64> Position; // price, offer id
+    typedef std::map<Position, std::shared_ptr<LedgerEntry const>> Book;
+    typedef std::map<AssetPair, Book, AssetPairCmp> BookMap;
+
+    struct Location
+    {
+        BookMap::iterator mBook;
+        Position mPosition;
+    };
+
+    BookMap mBooks;
+    // where each offer of a loaded book is
+    std::unordered_map<uint64, Location> mOffers;
+    // books offers were removed from since the last commit
+    std::unordered_multimap<uint64, BookMap::iterator> mRemoved;
+
+    medida::Timer& mLoadTimer;
+    medida::Counter& mOfferCount;
+
+    static Position getPosition(OfferEntry const& offer);
+    BookMap::iterator load(Asset const& selling, Asset const& buying,
+                           Database& db);
+    void remove(uint64 offerID);
+    void drop(BookMap::iterator book);
+
+  public:
+    OrderBookCache(medida::MetricsRegistry& metrics);
+
+    // The best offer selling `selling` for `buying` that comes after
+    // `after` in its book (the best one overall if `after` is null), or null
+    // if there is none.
+    std::shared_ptr<LedgerEntry const> next(Asset const& selling,
+                                            Asset const& buying,
+                                            OfferEntry const* after,
+                                            Database& db);
+
+    // Record that `offer` was stored, or that the offer with `offerID` was
+    // deleted, in the database.
+    void put(LedgerEntry const& offer);
+    void erase(uint64 offerID);
+
+    // Drop any book that holds, or held since the last commit, the offer
+    // with `offerID`.
+    void invalidate(uint64 offerID);
+
+    // Called once the changes to the current ledger are committed.
+    void commit();
+
+    void clear();
+};
+}
@@ -212,6 +212,13 @@ TrustFrame::storeDelete(LedgerDelta& delta, Database& db) const
 void
 TrustFrame::storeDelete(LedgerDelta& delta, Database& db, LedgerKey const& key)
 {
+    if (db.deferLedgerWrites())
+    {
+        putPendingEntry(key, nullptr, db);
+        delta.deleteEntry(key);
+        return;
+    }
+
     flushCachedEntry(key, db);
 
     std::string actIDStrKey, issuerStrKey, assetCode;
@@ -225,6 +232,113 @@ TrustFrame::storeDelete(LedgerDelta& delta, Database& db, LedgerKey const& key)
     delta.deleteEntry(key);
 }
 
+void
+TrustFrame::storeDeleteBulk(Database& db, std::vector<LedgerKey> const& keys)
+{
+    if (keys.empty())
+    {
+        return;
+    }
+
+    size_t n = keys.size();
+    std::vector<std::string> actIDStrKeys, issuerStrKeys, assetCodes;
+    actIDStrKeys.reserve(n);
+    issuerStrKeys.reserve(n);
+    assetCodes.reserve(n);
+    for (auto const& key : keys)
+    {
+        flushCachedEntry(key, db);
+        actIDStrKeys.emplace_back();
+        issuerStrKeys.emplace_back();
+        assetCodes.emplace_back();
+        getKeyFields(key, actIDStrKeys.back(), issuerStrKeys.back(),
+                     assetCodes.back());
+    }
+
+    // no "(a, b, c) IN (...)": the bundled SQLite doesn't have row values
+    auto timer = db.getDeleteTimer("trust");
+    db.executeBulk(n, 3,
+                   [](size_t rows) {
+                       return "DELETE FROM trustlines WHERE " +
+                              Database::getPlaceholders(
+                                  rows,
+                                  "(accountid = ? AND issuer = ? AND "
+                                  "assetcode = ?)",
+                                  " OR ");
+                   },
+                   [&](soci::statement& st, size_t row) {
+                       st.exchange(use(actIDStrKeys[row]));
+                       st.exchange(use(issuerStrKeys[row]));
+                       st.exchange(use(assetCodes[row]));
+                   });
+}
+
+void
+TrustFrame::storeAddBulk(Database& db, std::vector<LedgerEntry> const& entries)
+{
+    if (entries.empty())
+    {
+        return;
+    }
+
+    size_t n = entries.size();
+    std::vector<std::string> actIDStrKeys, issuerStrKeys, assetCodes;
+    std::vector<int> assetTypes, flags, lastModifieds;
+    std::vector<long long> balances, limits;
+    actIDStrKeys.reserve(n);
+    issuerStrKeys.reserve(n);
+    assetCodes.reserve(n);
+    assetTypes.reserve(n);
+    flags.reserve(n);
+    lastModifieds.reserve(n);
+    balances.reserve(n);
+    limits.reserve(n);
+
+    for (auto const& entry : entries)
+    {
+        auto const& tl = entry.data.trustLine();
+        if (!isValid(tl))
+        {
+            throw std::runtime_error("Invalid TrustEntry");
+        }
+        actIDStrKeys.emplace_back();
+        issuerStrKeys.emplace_back();
+        assetCodes.emplace_back();
+        getKeyFields(LedgerEntryKey(entry), actIDStrKeys.back(),
+                     issuerStrKeys.back(), assetCodes.back());
+        assetTypes.emplace_back(tl.asset.type());
+        balances.emplace_back(tl.balance);
+        limits.emplace_back(tl.limit);
+        flags.emplace_back(tl.flags);
+        lastModifieds.emplace_back(entry.lastModifiedLedgerSeq);
+    }
+
+    auto timer = db.getInsertTimer("trust");
+    auto inserted = db.executeBulk(
+        n, 8,
+        [](size_t rows) {
+            return "INSERT INTO trustlines "
+                   "(accountid, assettype, issuer, assetcode, balance, "
+                   "tlimit, flags, lastmodified) VALUES " +
+                   Database::getPlaceholders(
+                       rows, "(?, ?, ?, ?, ?, ?, ?, ?)", ", ");
+        },
+        [&](soci::statement& st, size_t row) {
+            st.exchange(use(actIDStrKeys[row]));
+            st.exchange(use(assetTypes[row]));
+            st.exchange(use(issuerStrKeys[row]));
+            st.exchange(use(assetCodes[row]));
+            st.exchange(use(balances[row]));
+            st.exchange(use(limits[row]));
+            st.exchange(use(flags[row]));
+            st.exchange(use(lastModifieds[row]));
+        });
+    if (inserted != static_cast<long long>(n))
+    {
+        throw std::runtime_error("Could not update data in SQL");
+    }
+}
+
 void
 TrustFrame::storeChange(LedgerDelta& delta, Database& db)
 {
@@ -241,6 +355,13 @@ TrustFrame::storeChange(LedgerDelta& delta, Database& db)
 
     touch(delta);
 
+    if (db.deferLedgerWrites())
+    {
+        putPendingEntry(db);
+        delta.modEntry(*this);
+        return;
+    }
+
     std::string actIDStrKey, issuerStrKey, assetCode;
     getKeyFields(key, actIDStrKey, issuerStrKey, assetCode);
 
@@ -285,6 +406,13 @@ TrustFrame::storeAdd(LedgerDelta& delta, Database& db)
 
     touch(delta);
 
+    if (db.deferLedgerWrites())
+    {
+        putPendingEntry(db);
+        delta.addEntry(*this);
+        return;
+    }
+
     std::string actIDStrKey, issuerStrKey, assetCode;
     unsigned int assetType = getKey().trustLine().asset.type();
     getKeyFields(getKey(), actIDStrKey, issuerStrKey, assetCode);
@@ -361,15 +489,16 @@ TrustFrame::loadTrustLine(AccountID const& accountID, Asset const& asset,
     if (cachedEntryExists(key, db))
     {
         auto p = getCachedEntry(key, db);
-        if (p)
+        if (!p)
         {
-            pointer ret = std::make_shared<TrustFrame>(*p);
-            if (delta)
-            {
-                delta->recordEntry(*ret);
-            }
-            return ret;
+            return nullptr;
         }
+        pointer ret = std::make_shared<TrustFrame>(*p);
+        if (delta)
+        {
+            delta->recordEntry(*ret);
+        }
+        return ret;
     }
 
     std::string accStr, issuerStr, assetStr;
@@ -386,10 +515,10 @@ TrustFrame::loadTrustLine(AccountID const& accountID, Asset const& asset,
         issuerStr = KeyUtils::toStrKey(asset.alphaNum12().issuer);
     }
 
-    auto query = std::string(trustLineColumnSelector);
-    query += (" WHERE accountid = :id "
-              " AND issuer = :issuer "
-              " AND assetcode = :asset");
+    static const std::string query = std::string(trustLineColumnSelector) +
+                                     " WHERE accountid = :id "
+                                     " AND issuer = :issuer "
+                                     " AND assetcode = :asset";
     auto prep = db.getPreparedStatement(query);
     auto& st = prep.statement();
     st.exchange(use(accStr));
@@ -518,6 +647,30 @@ TrustFrame::loadAllLines(Database& db)
     return retLines;
 }
 
+void
+TrustFrame::loadEntries(soci::session& sess, std::vector<LedgerKey> const& keys,
+                        std::function<void(LedgerEntry const&)> processor)
+{
+    std::vector<std::string> actIDStrKeys;
+    actIDStrKeys.reserve(keys.size());
+    for (auto const& key : keys)
+    {
+        actIDStrKeys.emplace_back(
+            KeyUtils::toStrKey(key.trustLine().accountID));
+    }
+
+    auto query = std::string(trustLineColumnSelector);
+    query += " WHERE accountid IN (" +
+             Database::getPlaceholders(keys.size()) + ")";
+    auto prep = Database::getStatement(sess, query);
+    auto& st = prep.statement();
+    for (auto const& actIDStrKey : actIDStrKeys)
+    {
+        st.exchange(use(actIDStrKey));
+    }
+    loadLines(prep, processor);
+}
+
 void
 TrustFrame::dropAll(Database& db)
 {
@@ -63,6 +63,12 @@ class TrustFrame : public EntryFrame
     // Static helper that don't assume an instance.
     static void storeDelete(LedgerDelta& delta, Database& db,
                             LedgerKey const& key);
+
+    // Bulk forms of storeDelete and storeAdd, see AccountFrame.
+    static void storeDeleteBulk(Database& db,
+                                std::vector<LedgerKey> const& keys);
+    static void storeAddBulk(Database& db,
+                             std::vector<LedgerEntry> const& entries);
     static bool exists(Database& db, LedgerKey const& key);
     static uint64_t countObjects(soci::session& sess);
 
@@ -84,6 +90,12 @@ class TrustFrame : public EntryFrame
     static std::unordered_map<AccountID, std::vector<TrustFrame::pointer>>
     loadAllLines(Database& db);
 
+    // Load the entries with the given keys through `sess`, see AccountFrame.
+    // This may also pass other entries of the same accounts.
+    static void
+    loadEntries(soci::session& sess, std::vector<LedgerKey> const& keys,
+                std::function<void(LedgerEntry const&)> processor);
+
     int64_t getBalance() const;
     bool addBalance(int64_t delta);
 
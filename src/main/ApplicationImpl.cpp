@@ -71,6 +71,18 @@ ApplicationImpl::ApplicationImpl(VirtualClock& clock, Config const& cfg)
 
     mNetworkID = sha256(mConfig.NETWORK_PASSPHRASE);
 
+    // the verification cache is shared by the whole process, the first
+    // application created sets its size
+    size_t sigCacheSize =
+        PubKeyUtils::setVerifySigCacheSize(mConfig.SIGNATURE_VERIFY_CACHE_SIZE);
+    if (sigCacheSize != mConfig.SIGNATURE_VERIFY_CACHE_SIZE)
+    {
+        LOG(WARNING) << "Ignoring SIGNATURE_VERIFY_CACHE_SIZE="
+                     << mConfig.SIGNATURE_VERIFY_CACHE_SIZE
+                     << ", the signature verification cache of the process "
+                     << "already keeps " << sigCacheSize << " results";
+    }
+
     unsigned t = std::thread::hardware_concurrency();
     LOG(DEBUG) << "Application constructing "
                << "(worker threads: " << t << ")";
@@ -377,6 +389,10 @@ ApplicationImpl::joinAllThreads()
         w.join();
     }
     LOG(DEBUG) << "Joined all " << mWorkerThreads.size() << " threads";
+    if (mBucketManager)
+    {
+        mBucketManager->shutdown();
+    }
 }
 
 bool
@@ -412,11 +428,15 @@ ApplicationImpl::getLoadGenerator()
 void
 ApplicationImpl::checkDB()
 {
-    getClock().getIOService().post([this] {
-        checkDBAgainstBuckets(this->getMetrics(), this->getBucketManager(),
-                              this->getDatabase(),
-                              this->getBucketManager().getBucketList());
-    });
+    if (getMetrics().NewCounter({"bucket", "checkdb", "running"}).count() != 0)
+    {
+        LOG(INFO) << "CheckDB already running";
+        return;
+    }
+    auto checker = std::make_shared<BucketDBChecker>(*this);
+    auto& io = checker->canRunInBackground() ? getWorkerIOService()
+                                             : getClock().getIOService();
+    io.post([checker]() { checker->run(); });
 }
 
 void
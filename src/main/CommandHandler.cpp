@@ -19,7 +19,10 @@
 #include "util/StatusManager.h"
 #include "util/make_unique.h"
 
+#include "medida/counter.h"
+#include "medida/metrics_registry.h"
 #include "medida/reporting/json_reporter.h"
+#include "medida/timer.h"
 #include "util/basen.h"
 #include "xdrpp/marshal.h"
 #include "xdrpp/printer.h"
@@ -261,7 +264,8 @@ CommandHandler::fileNotFound(std::string const& params, std::string& retStr)
         "triggers the instance to catch up to ledger NNN from history; "
         "mode is either 'minimal' (the default, if omitted) or 'complete'."
         "</p><p><h1> /checkdb</h1>"
-        "triggers the instance to perform an integrity check of the database."
+        "triggers the instance to perform a background integrity check of the "
+        "database, or reports the progress of the check already running."
         "</p><p><h1> /checkpoint</h1>"
         "triggers the instance to write an immediate history checkpoint."
         "</p><p><h1> /connect?peer=NAME&port=NNN</h1>"
@@ -572,8 +576,29 @@ CommandHandler::catchup(std::string const& params, std::string& retStr)
 void
 CommandHandler::checkdb(std::string const& params, std::string& retStr)
 {
+    auto& metrics = mApp.getMetrics();
+    auto compared =
+        metrics.NewCounter({"bucket", "checkdb", "compared"}).count();
+    auto mismatches =
+        metrics.NewCounter({"bucket", "checkdb", "mismatches"}).count();
+    if (metrics.NewCounter({"bucket", "checkdb", "running"}).count() != 0)
+    {
+        retStr = fmt::format("CheckDB running: compared {} objects so far, "
+                             "found {} mismatches.",
+                             compared, mismatches);
+        return;
+    }
+
+    bool ranBefore = metrics.NewTimer({"bucket", "checkdb", "execute"})
+                         .count() != 0;
     mApp.checkDB();
     retStr = "CheckDB started.";
+    if (ranBefore)
+    {
+        retStr += fmt::format(" Previous check compared {} objects and "
+                              "found {} mismatches.",
+                              compared, mismatches);
+    }
 }
 
 void
@@ -9,6 +9,7 @@
 #include "crypto/KeyUtils.h"
 #include "history/HistoryArchive.h"
 #include "scp/LocalNode.h"
+#include "util/BlockCompression.h"
 #include "util/Logging.h"
 #include "util/types.h"
 
@@ -50,6 +51,12 @@ Config::Config() : NODE_SEED(SecretKey::random())
 
     LOG_FILE_PATH = "stellar-core.%datetime{%Y.%M.%d-%H:%m:%s}.log";
     BUCKET_DIR_PATH = "buckets";
+    BUCKET_READ_BLOCK_SIZE = 1024 * 1024;
+    BUCKET_READ_USE_MMAP = false;
+    BUCKET_MERGE_THREADS = 0;
+    BUCKET_PARTITIONED_MERGE_MIN_BYTES = 0;
+    BUCKET_MERGE_PARTITIONS = 4;
+    BUCKET_COMPRESSION = false;
 
     DESIRED_BASE_FEE = 100;
     DESIRED_MAX_TX_PER_LEDGER = 50;
@@ -69,6 +76,12 @@ Config::Config() : NODE_SEED(SecretKey::random())
     NODE_IS_VALIDATOR = false;
 
     DATABASE = SecretValue{"sqlite3://:memory:"};
+    ENTRY_CACHE_BYTES = 32 * 1024 * 1024;
+    DEFERRED_LEDGER_WRITES = false;
+    BINARY_HISTORY = false;
+    SIGNATURE_VERIFY_THREADS = 0;
+    SIGNATURE_VERIFY_CACHE_SIZE = 0xffff;
+    TX_ADMISSION_QUEUE_SIZE = 1000;
     NTP_SERVER = "pool.ntp.org";
 }
 
@@ -373,6 +386,85 @@ Config::load(std::string const& filename)
                 }
                 BUCKET_DIR_PATH = item.second->as<std::string>()->value();
             }
+            else if (item.first == "BUCKET_READ_BLOCK_SIZE")
+            {
+                if (!item.second->as<int64_t>())
+                {
+                    throw std::invalid_argument(
+                        "invalid BUCKET_READ_BLOCK_SIZE");
+                }
+                int64_t f = item.second->as<int64_t>()->value();
+                if (f < 4096 || f > 64 * 1024 * 1024)
+                {
+                    throw std::invalid_argument(
+                        "invalid BUCKET_READ_BLOCK_SIZE");
+                }
+                BUCKET_READ_BLOCK_SIZE = (size_t)f;
+            }
+            else if (item.first == "BUCKET_READ_USE_MMAP")
+            {
+                if (!item.second->as<bool>())
+                {
+                    throw std::invalid_argument("invalid BUCKET_READ_USE_MMAP");
+                }
+                BUCKET_READ_USE_MMAP = item.second->as<bool>()->value();
+            }
+            else if (item.first == "BUCKET_MERGE_THREADS")
+            {
+                if (!item.second->as<int64_t>())
+                {
+                    throw std::invalid_argument("invalid BUCKET_MERGE_THREADS");
+                }
+                int64_t f = item.second->as<int64_t>()->value();
+                if (f < 0 || f > 256)
+                {
+                    throw std::invalid_argument("invalid BUCKET_MERGE_THREADS");
+                }
+                BUCKET_MERGE_THREADS = (uint32_t)f;
+            }
+            else if (item.first == "BUCKET_PARTITIONED_MERGE_MIN_BYTES")
+            {
+                if (!item.second->as<int64_t>())
+                {
+                    throw std::invalid_argument(
+                        "invalid BUCKET_PARTITIONED_MERGE_MIN_BYTES");
+                }
+                int64_t f = item.second->as<int64_t>()->value();
+                if (f < 0)
+                {
+                    throw std::invalid_argument(
+                        "invalid BUCKET_PARTITIONED_MERGE_MIN_BYTES");
+                }
+                BUCKET_PARTITIONED_MERGE_MIN_BYTES = (uint64_t)f;
+            }
+            else if (item.first == "BUCKET_MERGE_PARTITIONS")
+            {
+                if (!item.second->as<int64_t>())
+                {
+                    throw std::invalid_argument(
+                        "invalid BUCKET_MERGE_PARTITIONS");
+                }
+                int64_t f = item.second->as<int64_t>()->value();
+                if (f < 1 || f > 64)
+                {
+                    throw std::invalid_argument(
+                        "invalid BUCKET_MERGE_PARTITIONS");
+                }
+                BUCKET_MERGE_PARTITIONS = (uint32_t)f;
+            }
+            else if (item.first == "BUCKET_COMPRESSION")
+            {
+                if (!item.second->as<bool>())
+                {
+                    throw std::invalid_argument("invalid BUCKET_COMPRESSION");
+                }
+                BUCKET_COMPRESSION = item.second->as<bool>()->value();
+                if (BUCKET_COMPRESSION && !blockCompressionSupported())
+                {
+                    throw std::invalid_argument(
+                        "BUCKET_COMPRESSION is not supported by this build");
+                }
+            }
             else if (item.first == "NODE_NAMES")
             {
                 if (!item.second->is_array())
@@ -571,6 +663,81 @@ Config::load(std::string const& filename)
                 }
                 DATABASE = SecretValue{item.second->as<std::string>()->value()};
             }
+            else if (item.first == "ENTRY_CACHE_BYTES")
+            {
+                if (!item.second->as<int64_t>())
+                {
+                    throw std::invalid_argument("invalid ENTRY_CACHE_BYTES");
+                }
+                int64_t f = item.second->as<int64_t>()->value();
+                if (f < 0)
+                {
+                    throw std::invalid_argument("invalid ENTRY_CACHE_BYTES");
+                }
+                ENTRY_CACHE_BYTES = (uint64_t)f;
+            }
+            else if (item.first == "DEFERRED_LEDGER_WRITES")
+            {
+                if (!item.second->as<bool>())
+                {
+                    throw std::invalid_argument(
+                        "invalid DEFERRED_LEDGER_WRITES");
+                }
+                DEFERRED_LEDGER_WRITES = item.second->as<bool>()->value();
+            }
+            else if (item.first == "BINARY_HISTORY")
+            {
+                if (!item.second->as<bool>())
+                {
+                    throw std::invalid_argument("invalid BINARY_HISTORY");
+                }
+                BINARY_HISTORY = item.second->as<bool>()->value();
+            }
+            else if (item.first == "SIGNATURE_VERIFY_THREADS")
+            {
+                if (!item.second->as<int64_t>())
+                {
+                    throw std::invalid_argument(
+                        "invalid SIGNATURE_VERIFY_THREADS");
+                }
+                int64_t f = item.second->as<int64_t>()->value();
+                if (f < 0 || f > 256)
+                {
+                    throw std::invalid_argument(
+                        "invalid SIGNATURE_VERIFY_THREADS");
+                }
+                SIGNATURE_VERIFY_THREADS = (uint32_t)f;
+            }
+            else if (item.first == "SIGNATURE_VERIFY_CACHE_SIZE")
+            {
+                if (!item.second->as<int64_t>())
+                {
+                    throw std::invalid_argument(
+                        "invalid SIGNATURE_VERIFY_CACHE_SIZE");
+                }
+                int64_t f = item.second->as<int64_t>()->value();
+                if (f <= 0 || f >= UINT32_MAX)
+                {
+                    throw std::invalid_argument(
+                        "invalid SIGNATURE_VERIFY_CACHE_SIZE");
+                }
+                SIGNATURE_VERIFY_CACHE_SIZE = (uint32_t)f;
+            }
+            else if (item.first == "TX_ADMISSION_QUEUE_SIZE")
+            {
+                if (!item.second->as<int64_t>())
+                {
+                    throw std::invalid_argument(
+                        "invalid TX_ADMISSION_QUEUE_SIZE");
+                }
+                int64_t f = item.second->as<int64_t>()->value();
+                if (f < 0 || f >= UINT32_MAX)
+                {
+                    throw std::invalid_argument(
+                        "invalid TX_ADMISSION_QUEUE_SIZE");
+                }
+                TX_ADMISSION_QUEUE_SIZE = (uint32_t)f;
+            }
             else if (item.first == "PARANOID_MODE")
             {
                 if (!item.second->as<bool>())
@@ -125,6 +125,27 @@ class Config : public std::enable_shared_from_this<Config>
     std::string VERSION_STR;
     std::string LOG_FILE_PATH;
     std::string BUCKET_DIR_PATH;
+
+    // Size, in bytes, of the blocks read from bucket files when iterating,
+    // merging or applying buckets.
+    size_t BUCKET_READ_BLOCK_SIZE;
+
+    // Whether to read bucket files through a memory mapping rather than
+    // block-sized reads. Ignored on platforms without mmap.
+    bool BUCKET_READ_USE_MMAP;
+
+    // Number of threads dedicated to merging buckets. 0 means half the number
+    // of cores, but at least one.
+    uint32_t BUCKET_MERGE_THREADS;
+
+    // Merges whose inputs total at least this many bytes are split into
+    // BUCKET_MERGE_PARTITIONS key ranges merged in parallel. 0 disables
+    // partitioned merges.
+    uint64_t BUCKET_PARTITIONED_MERGE_MIN_BYTES;
+    uint32_t BUCKET_MERGE_PARTITIONS;
+
+    // Whether to store new buckets in the block-compressed format.
+    bool BUCKET_COMPRESSION;
     uint32_t DESIRED_BASE_FEE;     // in stroops
     uint32_t DESIRED_BASE_RESERVE; // in stroops
     uint32_t DESIRED_MAX_TX_PER_LEDGER;
@@ -176,6 +197,32 @@ class Config : public std::enable_shared_from_this<Config>
     // Database config
     SecretValue DATABASE;
 
+    // Memory budget, in bytes, of the cache of ledger entries loaded from
+    // the database.
+    uint64_t ENTRY_CACHE_BYTES;
+
+    // Keep the ledger entries written while applying a ledger in memory, and
+    // write them to the database in bulk when the ledger is committed.
+    bool DEFERRED_LEDGER_WRITES;
+
+    // Store the XDR blobs of the history tables (txhistory, txfeehistory,
+    // scphistory and ledgerheaders) in binary rather than as base64 text.
+    // The database is converted, either way, on startup.
+    bool BINARY_HISTORY;
+
+    // Number of threads the signatures of a transaction set are verified on.
+    // 0 means one per core.
+    uint32_t SIGNATURE_VERIFY_THREADS;
+
+    // Number of signature verification results kept in the process-wide
+    // verification cache; only the first application of the process sets it.
+    uint32_t SIGNATURE_VERIFY_CACHE_SIZE;
+
+    // Maximum number of transactions from peers being checked on a worker
+    // thread at once; peers sending more are read from once there is room.
+    // 0 means they are checked synchronously when received.
+    uint32_t TX_ADMISSION_QUEUE_SIZE;
+
     std::vector<std::string> COMMANDS;
     std::vector<std::string> REPORT_METRICS;
 
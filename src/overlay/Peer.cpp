@@ -752,19 +752,42 @@ Peer::recvTransaction(StellarMessage const& msg)
     {
         // add it to our current set
         // and make sure it is valid
-        auto recvRes = mApp.getHerder().recvTransaction(transaction);
-
-        if (recvRes == Herder::TX_STATUS_PENDING ||
-            recvRes == Herder::TX_STATUS_DUPLICATE)
+        auto self = shared_from_this();
+        if (!mApp.getHerder().recvTransactionAsync(
+                transaction,
+                [self, msg](Herder::TransactionSubmitStatus recvRes) {
+                    if (recvRes == Herder::TX_STATUS_PENDING ||
+                        recvRes == Herder::TX_STATUS_DUPLICATE)
+                    {
+                        // record that this peer sent us this transaction
+                        auto& om = self->mApp.getOverlayManager();
+                        om.recvFloodedMsg(msg, self);
+
+                        if (recvRes == Herder::TX_STATUS_PENDING)
+                        {
+                            // if it's a new transaction, broadcast it
+                            om.broadcastMessage(msg);
+                        }
+                    }
+                }))
         {
-            // record that this peer sent us this transaction
-            mApp.getOverlayManager().recvFloodedMsg(msg, shared_from_this());
-
-            if (recvRes == Herder::TX_STATUS_PENDING)
-            {
-                // if it's a new transaction, broadcast it
-                mApp.getOverlayManager().broadcastMessage(msg);
-            }
+            // the herder is checking as many transactions as it can: stop
+            // reading from this peer until it has room for this one
+            mReadPaused = true;
+            std::weak_ptr<Peer> weak = self;
+            mApp.getHerder().waitForTxAdmission([weak, msg]() {
+                auto peer = weak.lock();
+                if (!peer || peer->shouldAbort())
+                {
+                    return;
+                }
+                peer->mReadPaused = false;
+                peer->recvTransaction(msg);
+                if (!peer->mReadPaused)
+                {
+                    peer->resumeRead();
+                }
+            });
         }
     }
 }
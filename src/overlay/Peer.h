@@ -72,6 +72,10 @@ class Peer : public std::enable_shared_from_this<Peer>,
     uint32_t mRemoteOverlayVersion;
     unsigned short mRemoteListeningPort;
 
+    // Set while a transaction from this peer waits for room in the herder's
+    // admission queue: no other message is read from the peer meanwhile.
+    bool mReadPaused{false};
+
     VirtualTimer mIdleTimer;
     VirtualClock::time_point mLastRead;
     VirtualClock::time_point mLastWrite;
@@ -178,6 +182,12 @@ class Peer : public std::enable_shared_from_this<Peer>,
 
     virtual AuthCert getAuthCert();
 
+    // Start reading messages again, once mReadPaused is cleared.
+    virtual void
+    resumeRead()
+    {
+    }
+
     void startIdleTimer();
     void idleTimerExpired(asio::error_code const& error);
     size_t getIOTimeoutSeconds() const;
@@ -243,6 +243,12 @@ TCPPeer::startRead()
                      });
 }
 
+void
+TCPPeer::resumeRead()
+{
+    startRead();
+}
+
 int
 TCPPeer::getIncomingMsgLength()
 {
@@ -328,7 +334,10 @@ TCPPeer::readBodyHandler(asio::error_code const& error,
         receivedBytes(bytes_transferred, true);
         recvMessage();
         mIncomingHeader.clear();
-        startRead();
+        if (!mReadPaused)
+        {
+            startRead();
+        }
     }
     else
     {
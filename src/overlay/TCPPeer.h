@@ -42,6 +42,7 @@ class TCPPeer : public Peer
     int getIncomingMsgLength();
     virtual void connected() override;
     void startRead();
+    void resumeRead() override;
 
     void writeHandler(asio::error_code const& error,
                       std::size_t bytes_transferred) override;
@@ -748,6 +748,7 @@ LoadGenerator::AccountInfo::createDirectly(Application& app)
                       app.getDatabase());
     ;
     a.storeAdd(delta, app.getDatabase());
+    delta.commit();
 }
 
 void
@@ -771,6 +772,7 @@ LoadGenerator::AccountInfo::debitDirectly(Application& app, int64_t debitAmount)
                       app.getDatabase());
     ;
     existing->storeChange(delta, app.getDatabase());
+    delta.commit();
 }
 
 void
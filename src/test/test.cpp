@@ -99,6 +99,9 @@ getTestConfig(int instanceNumber, Config::TestDbMode mode)
         // not currently have IPv6 connectivity.
         thisConfig.NTP_SERVER.clear();
 
+        // keep transactions from peers in step with the virtual clock
+        thisConfig.TX_ADMISSION_QUEUE_SIZE = 0;
+
         std::ostringstream dbname;
         switch (mode)
         {
@@ -19,6 +19,24 @@ AllowTrustOpFrame::AllowTrustOpFrame(Operation const& op, OperationResult& res,
 {
 }
 
+Asset
+AllowTrustOpFrame::getAsset() const
+{
+    Asset ci;
+    ci.type(mAllowTrust.asset.type());
+    if (mAllowTrust.asset.type() == ASSET_TYPE_CREDIT_ALPHANUM4)
+    {
+        ci.alphaNum4().assetCode = mAllowTrust.asset.assetCode4();
+        ci.alphaNum4().issuer = getSourceID();
+    }
+    else if (mAllowTrust.asset.type() == ASSET_TYPE_CREDIT_ALPHANUM12)
+    {
+        ci.alphaNum12().assetCode = mAllowTrust.asset.assetCode12();
+        ci.alphaNum12().issuer = getSourceID();
+    }
+    return ci;
+}
+
 int32_t
 AllowTrustOpFrame::getNeededThreshold() const
 {
@@ -65,18 +83,7 @@ AllowTrustOpFrame::doApply(Application& app, LedgerDelta& delta,
         return false;
     }
 
-    Asset ci;
-    ci.type(mAllowTrust.asset.type());
-    if (mAllowTrust.asset.type() == ASSET_TYPE_CREDIT_ALPHANUM4)
-    {
-        ci.alphaNum4().assetCode = mAllowTrust.asset.assetCode4();
-        ci.alphaNum4().issuer = getSourceID();
-    }
-    else if (mAllowTrust.asset.type() == ASSET_TYPE_CREDIT_ALPHANUM12)
-    {
-        ci.alphaNum12().assetCode = mAllowTrust.asset.assetCode12();
-        ci.alphaNum12().issuer = getSourceID();
-    }
+    Asset ci = getAsset();
 
     Database& db = ledgerManager.getDatabase();
     TrustFrame::pointer trustLine;
@@ -116,18 +123,7 @@ AllowTrustOpFrame::doCheckValid(Application& app)
         innerResult().code(ALLOW_TRUST_MALFORMED);
         return false;
     }
-    Asset ci;
-    ci.type(mAllowTrust.asset.type());
-    if (mAllowTrust.asset.type() == ASSET_TYPE_CREDIT_ALPHANUM4)
-    {
-        ci.alphaNum4().assetCode = mAllowTrust.asset.assetCode4();
-        ci.alphaNum4().issuer = getSourceID();
-    }
-    else if (mAllowTrust.asset.type() == ASSET_TYPE_CREDIT_ALPHANUM12)
-    {
-        ci.alphaNum12().assetCode = mAllowTrust.asset.assetCode12();
-        ci.alphaNum12().issuer = getSourceID();
-    }
+    Asset ci = getAsset();
 
     if (!isAssetValid(ci))
     {
@@ -141,4 +137,10 @@ AllowTrustOpFrame::doCheckValid(Application& app)
 
     return true;
 }
+
+void
+AllowTrustOpFrame::insertLedgerKeysToPrefetch(LedgerKeySet& keys) const
+{
+    insertTrustLineKeys(keys, mAllowTrust.trustor, getAsset());
+}
 }
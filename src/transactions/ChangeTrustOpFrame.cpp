@@ -162,4 +162,10 @@ ChangeTrustOpFrame::doCheckValid(Application& app)
     }
     return true;
 }
+
+void
+ChangeTrustOpFrame::insertLedgerKeysToPrefetch(LedgerKeySet& keys) const
+{
+    insertTrustLineKeys(keys, getSourceID(), mChangeTrust.line);
+}
 }
@@ -24,6 +24,7 @@ class ChangeTrustOpFrame : public OperationFrame
     bool doApply(Application& app, LedgerDelta& delta,
                  LedgerManager& ledgerManager) override;
     bool doCheckValid(Application& app) override;
+    void insertLedgerKeysToPrefetch(LedgerKeySet& keys) const override;
 
     static ChangeTrustResultCode
     getInnerCode(OperationResult const& res)
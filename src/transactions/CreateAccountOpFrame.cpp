@@ -124,4 +124,10 @@ CreateAccountOpFrame::doCheckValid(Application& app)
 
     return true;
 }
+
+void
+CreateAccountOpFrame::insertLedgerKeysToPrefetch(LedgerKeySet& keys) const
+{
+    insertAccountKey(keys, mCreateAccount.destination);
+}
 }
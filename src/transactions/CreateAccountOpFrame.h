@@ -25,6 +25,7 @@ class CreateAccountOpFrame : public OperationFrame
     bool doApply(Application& app, LedgerDelta& delta,
                  LedgerManager& ledgerManager) override;
     bool doCheckValid(Application& app) override;
+    void insertLedgerKeysToPrefetch(LedgerKeySet& keys) const override;
 
     static CreateAccountResultCode
     getInnerCode(OperationResult const& res)
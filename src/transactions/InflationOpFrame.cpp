@@ -3,10 +3,13 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "transactions/InflationOpFrame.h"
+#include "database/Database.h"
 #include "ledger/AccountFrame.h"
+#include "ledger/InflationTally.h"
 #include "ledger/LedgerDelta.h"
 #include "ledger/LedgerManager.h"
 #include "main/Application.h"
+#include "main/Config.h"
 #include "medida/meter.h"
 #include "medida/metrics_registry.h"
 #include "overlay/StellarXDR.h"
@@ -64,19 +67,41 @@ InflationOpFrame::doApply(Application& app, LedgerDelta& delta,
     int64_t minBalance =
         bigDivide(totalVotes, INFLATION_WIN_MIN_PERCENT, TRILLION, ROUND_DOWN);
 
+    auto collectWinners =
+        [minBalance](std::vector<AccountFrame::InflationVotes>& winners) {
+            return [minBalance,
+                    &winners](AccountFrame::InflationVotes const& votes) {
+                if (votes.mVotes >= minBalance)
+                {
+                    winners.push_back(votes);
+                    return true;
+                }
+                return false;
+            };
+        };
+
     std::vector<AccountFrame::InflationVotes> winners;
     auto& db = ledgerManager.getDatabase();
 
-    AccountFrame::processForInflation(
-        [&](AccountFrame::InflationVotes const& votes) {
-            if (votes.mVotes >= minBalance)
-            {
-                winners.push_back(votes);
-                return true;
-            }
-            return false;
-        },
-        INFLATION_NUM_WINNERS, db);
+    auto& tally = db.getInflationTally();
+    tally.processForInflation(collectWinners(winners), INFLATION_NUM_WINNERS,
+                              inflationDelta, db);
+
+    if (app.getConfig().PARANOID_MODE)
+    {
+        // cross-check the tally against summing up the accounts table, which
+        // only has this ledger's changes once it is committed when ledger
+        // writes are deferred
+        if (db.deferLedgerWrites())
+        {
+            tally.checkOnCommit(INFLATION_NUM_WINNERS, minBalance);
+        }
+        else
+        {
+            InflationTally::checkWinners(winners, INFLATION_NUM_WINNERS,
+                                         minBalance, db);
+        }
+    }
 
     int64 inflationAmount = bigDivide(lcl.totalCoins, INFLATION_RATE_TRILLIONTHS,
                                    TRILLION, ROUND_DOWN);
@@ -2,9 +2,13 @@
 // under the Apache License, Version 2.0. See the COPYING file at the root
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
+#include "crypto/KeyUtils.h"
+#include "database/Database.h"
 #include "herder/LedgerCloseData.h"
+#include "ledger/InflationTally.h"
 #include "ledger/LedgerDelta.h"
 #include "ledger/LedgerManager.h"
+#include "ledger/LedgerTestUtils.h"
 #include "lib/catch.hpp"
 #include "main/Application.h"
 #include "main/Config.h"
@@ -14,6 +18,7 @@
 #include "test/test.h"
 #include "transactions/InflationOpFrame.h"
 #include "util/Logging.h"
+#include "util/Math.h"
 #include "util/Timer.h"
 #include <functional>
 
@@ -573,3 +578,125 @@ TEST_CASE("inflation", "[tx][inflation]")
     }
 #endif
 }
+
+// (votes, destination) of the top inflation candidates, from the tally or
+// from the accounts table
+static std::vector<std::pair<int64, std::string>>
+getCandidates(Database& db, LedgerDelta const* delta)
+{
+    std::vector<std::pair<int64, std::string>> res;
+    auto collect = [&res](AccountFrame::InflationVotes const& v) {
+        res.emplace_back(v.mVotes, KeyUtils::toStrKey(v.mInflationDest));
+        return true;
+    };
+    if (delta)
+    {
+        db.getInflationTally().processForInflation(collect, 10, *delta, db);
+    }
+    else
+    {
+        AccountFrame::processForInflation(collect, 10, db);
+    }
+    return res;
+}
+
+TEST_CASE("inflation tally matches the accounts table", "[inflation]")
+{
+    VirtualClock clock;
+    Application::pointer app = Application::create(clock, getTestConfig());
+    app->start();
+    auto& db = app->getDatabase();
+    auto& lm = app->getLedgerManager();
+
+    auto randomAccount = [](int i) {
+        LedgerEntry le;
+        le.data.type(ACCOUNT);
+        auto& a = le.data.account();
+        a.accountID = getTestAccount(i).getPublicKey();
+        LedgerTestUtils::makeValid(a);
+        // around the 1000000000 voting threshold, some of them below
+        a.balance = rand_uniform<int64>(500000000, 3000000000);
+        a.inflationDest.activate() =
+            getTestAccount(rand_uniform<int>(0, 29)).getPublicKey();
+        return le;
+    };
+
+    std::vector<LedgerEntry> accounts;
+    for (int i = 0; i < 300; ++i)
+    {
+        accounts.emplace_back(randomAccount(i));
+    }
+    AccountFrame::storeAddBulk(db, accounts);
+
+    {
+        LedgerDelta delta(lm.getCurrentLedgerHeader(), db);
+        REQUIRE(getCandidates(db, &delta).size() == 10);
+        REQUIRE(getCandidates(db, &delta) == getCandidates(db, nullptr));
+    }
+
+    auto changeAccounts = [&](LedgerDelta& delta) {
+        for (int i = 0; i < 100; ++i)
+        {
+            AccountFrame account(randomAccount(rand_uniform<int>(0, 299)));
+            account.storeChange(delta, db);
+        }
+        AccountFrame::storeDelete(delta, db, LedgerEntryKey(accounts[0]));
+    };
+
+    SECTION("pending changes")
+    {
+        soci::transaction sqlTx(db.getSession());
+        LedgerDelta delta(lm.getCurrentLedgerHeader(), db);
+        LedgerDelta inner(delta);
+        changeAccounts(inner);
+        REQUIRE(getCandidates(db, &inner) == getCandidates(db, nullptr));
+        inner.commit();
+        LedgerDelta inflationDelta(delta);
+        REQUIRE(getCandidates(db, &inflationDelta) ==
+                getCandidates(db, nullptr));
+    }
+    SECTION("committed changes")
+    {
+        {
+            soci::transaction sqlTx(db.getSession());
+            LedgerDelta delta(lm.getCurrentLedgerHeader(), db);
+            changeAccounts(delta);
+            delta.commit();
+            sqlTx.commit();
+        }
+        LedgerDelta delta(lm.getCurrentLedgerHeader(), db);
+        REQUIRE(getCandidates(db, &delta) == getCandidates(db, nullptr));
+    }
+    SECTION("changes outside of a transaction")
+    {
+        {
+            LedgerDelta delta(lm.getCurrentLedgerHeader(), db);
+            changeAccounts(delta);
+            // rolled back, but the changes stay in the database
+        }
+        LedgerDelta delta(lm.getCurrentLedgerHeader(), db);
+        REQUIRE(getCandidates(db, &delta) == getCandidates(db, nullptr));
+    }
+    SECTION("checked once committed")
+    {
+        auto& tally = db.getInflationTally();
+        {
+            soci::transaction sqlTx(db.getSession());
+            LedgerDelta delta(lm.getCurrentLedgerHeader(), db);
+            LedgerDelta inner(delta);
+            changeAccounts(inner);
+            tally.checkOnCommit(10, 0);
+            // not by nested deltas
+            inner.commit();
+            REQUIRE_NOTHROW(delta.commit());
+            sqlTx.commit();
+        }
+
+        // votes the tally isn't told of
+        db.getSession() << "UPDATE accounts SET balance = balance + 1 "
+                           "WHERE inflationdest IS NOT NULL";
+        LedgerDelta delta(lm.getCurrentLedgerHeader(), db);
+        tally.checkOnCommit(10, 0);
+        REQUIRE_THROWS_AS(delta.commit(), std::runtime_error);
+    }
+}
@@ -451,4 +451,11 @@ ManageOfferOpFrame::buildOffer(AccountID const& account,
     o.flags = flags;
     return o;
 }
+
+void
+ManageOfferOpFrame::insertLedgerKeysToPrefetch(LedgerKeySet& keys) const
+{
+    insertTrustLineKeys(keys, getSourceID(), mManageOffer.selling);
+    insertTrustLineKeys(keys, getSourceID(), mManageOffer.buying);
+}
 }
@@ -41,6 +41,7 @@ class ManageOfferOpFrame : public OperationFrame
     bool doApply(Application& app, LedgerDelta& delta,
                  LedgerManager& ledgerManager) override;
     bool doCheckValid(Application& app) override;
+    void insertLedgerKeysToPrefetch(LedgerKeySet& keys) const override;
 
     static ManageOfferResultCode
     getInnerCode(OperationResult const& res)
@@ -117,4 +117,10 @@ MergeOpFrame::doCheckValid(Application& app)
     }
     return true;
 }
+
+void
+MergeOpFrame::insertLedgerKeysToPrefetch(LedgerKeySet& keys) const
+{
+    insertAccountKey(keys, mOperation.body.destination());
+}
 }
@@ -251,74 +251,67 @@ OfferExchange::convertWithOffers(
 
     Database& db = mLedgerManager.getDatabase();
 
-    size_t offerOffset = 0;
+    OfferFrame::pointer wheatOffer;
 
     bool needMore = (maxWheatReceive > 0 && maxSheepSend > 0);
 
     while (needMore)
     {
-        std::vector<OfferFrame::pointer> retList;
-        OfferFrame::loadBestOffers(5, offerOffset, wheat, sheep, retList, db);
-
-        offerOffset += retList.size();
-
-        for (auto& wheatOffer : retList)
+        // crossing an offer only changes or deletes that offer, so picking
+        // up after it in the book walks the same offers as before
+        wheatOffer =
+            OfferFrame::loadNextBestOffer(wheat, sheep, wheatOffer.get(), db);
+        if (!wheatOffer)
         {
-            if (filter)
-            {
-                OfferFilterResult r = filter(*wheatOffer);
-                switch (r)
-                {
-                case eKeep:
-                    break;
-                case eStop:
-                    return eFilterStop;
-                case eSkip:
-                    continue;
-                }
-            }
-
-            int64_t numWheatReceived;
-            int64_t numSheepSend;
-
-            CrossOfferResult cor =
-                crossOffer(*wheatOffer, maxWheatReceive, numWheatReceived,
-                           maxSheepSend, numSheepSend);
+            // still stuff to fill but no more offers
+            return eOK;
+        }
 
-            switch (cor)
+        if (filter)
+        {
+            OfferFilterResult r = filter(*wheatOffer);
+            switch (r)
             {
-            case eOfferTaken:
-                assert(offerOffset > 0);
-                offerOffset--; // adjust offset as an offer was deleted
-                break;
-            case eOfferPartial:
+            case eKeep:
                 break;
-            case eOfferCantConvert:
-                return ePartial;
+            case eStop:
+                return eFilterStop;
+            case eSkip:
+                continue;
             }
+        }
 
-            sheepSend += numSheepSend;
-            maxSheepSend -= numSheepSend;
+        int64_t numWheatReceived;
+        int64_t numSheepSend;
 
-            wheatReceived += numWheatReceived;
-            maxWheatReceive -= numWheatReceived;
+        CrossOfferResult cor =
+            crossOffer(*wheatOffer, maxWheatReceive, numWheatReceived,
+                       maxSheepSend, numSheepSend);
 
-            needMore = (maxWheatReceive > 0 && maxSheepSend > 0);
-            if (!needMore)
-            {
-                return eOK;
-            }
-            else if (cor == eOfferPartial)
-            {
-                return ePartial;
-            }
+        switch (cor)
+        {
+        case eOfferTaken:
+        case eOfferPartial:
+            break;
+        case eOfferCantConvert:
+            return ePartial;
         }
 
-        // still stuff to fill but no more offers
-        if (needMore && retList.size() < 5)
+        sheepSend += numSheepSend;
+        maxSheepSend -= numSheepSend;
+
+        wheatReceived += numWheatReceived;
+        maxWheatReceive -= numWheatReceived;
+
+        needMore = (maxWheatReceive > 0 && maxSheepSend > 0);
+        if (!needMore)
         {
             return eOK;
         }
+        else if (cor == eOfferPartial)
+        {
+            return ePartial;
+        }
     }
     return eOK;
 }
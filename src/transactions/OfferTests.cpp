@@ -2,6 +2,7 @@
 // under the Apache License, Version 2.0. See the COPYING file at the root
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 #include "database/Database.h"
+#include "ledger/LedgerDelta.h"
 #include "ledger/LedgerManager.h"
 #include "lib/catch.hpp"
 #include "lib/util/uint128_t.h"
@@ -15,8 +16,10 @@
 #include "test/test.h"
 #include "transactions/OfferExchange.h"
 #include "util/Logging.h"
+#include "util/Math.h"
 #include "util/Timer.h"
 #include "util/make_unique.h"
+#include <chrono>
 
 using namespace stellar;
 using namespace stellar::txtest;
@@ -1688,3 +1691,186 @@ TEST_CASE("Exchange", "[offers]")
         }
     }
 }
+
+static std::vector<LedgerEntry>
+makeOffers(size_t n, uint64 firstID, Asset const& selling, Asset const& buying)
+{
+    std::vector<LedgerEntry> offers;
+    auto seller = getAccount("seller").getPublicKey();
+    for (size_t i = 0; i < n; ++i)
+    {
+        LedgerEntry le;
+        le.lastModifiedLedgerSeq = 1;
+        le.data.type(OFFER);
+        auto& oe = le.data.offer();
+        oe.sellerID = seller;
+        oe.offerID = firstID + i;
+        oe.selling = selling;
+        oe.buying = buying;
+        oe.amount = 1000;
+        // few distinct prices, so that ties are broken by offer id
+        oe.price = Price(rand_uniform<int32_t>(1, 10),
+                         rand_uniform<int32_t>(1, 10));
+        offers.emplace_back(le);
+    }
+    return offers;
+}
+
+static std::vector<uint64>
+walkOrderBook(Asset const& selling, Asset const& buying, Database& db)
+{
+    std::vector<uint64> ids;
+    OfferFrame::pointer offer;
+    while ((offer = OfferFrame::loadNextBestOffer(selling, buying, offer.get(),
+                                                  db)))
+    {
+        ids.push_back(offer->getOfferID());
+    }
+    return ids;
+}
+
+static std::vector<uint64>
+walkOffersTable(Asset const& selling, Asset const& buying, Database& db)
+{
+    std::vector<uint64> ids;
+    std::vector<OfferFrame::pointer> offers;
+    OfferFrame::loadBestOffers(1000, 0, selling, buying, offers, db);
+    for (auto const& offer : offers)
+    {
+        ids.push_back(offer->getOfferID());
+    }
+    return ids;
+}
+
+TEST_CASE("order book cache follows offer changes", "[offers]")
+{
+    VirtualClock clock;
+    Application::pointer app = Application::create(clock, getTestConfig());
+    app->start();
+    auto& db = app->getDatabase();
+    auto& lm = app->getLedgerManager();
+
+    Asset xlm;
+    xlm.type(ASSET_TYPE_NATIVE);
+    auto gateway = getAccount("gateway");
+    Asset usd = makeAsset(gateway, "USD");
+    Asset idr = makeAsset(gateway, "IDR");
+
+    OfferFrame::storeAddBulk(db, makeOffers(50, 1, xlm, usd));
+    OfferFrame::storeAddBulk(db, makeOffers(50, 51, xlm, idr));
+    auto usdBook = walkOffersTable(xlm, usd, db);
+    REQUIRE(usdBook.size() == 50);
+    REQUIRE(walkOrderBook(xlm, usd, db) == usdBook);
+    REQUIRE(walkOrderBook(xlm, idr, db) == walkOffersTable(xlm, idr, db));
+
+    auto seller = getAccount("seller").getPublicKey();
+    auto change = [&](LedgerDelta& delta) {
+        auto offer = OfferFrame::loadOffer(seller, usdBook[10], db, &delta);
+        offer->getOffer().price = Price(1, 100);
+        offer->storeChange(delta, db);
+
+        offer = OfferFrame::loadOffer(seller, usdBook[20], db, &delta);
+        offer->getOffer().buying = idr;
+        offer->storeChange(delta, db);
+
+        offer = OfferFrame::loadOffer(seller, usdBook[30], db, &delta);
+        offer->storeDelete(delta, db);
+
+        OfferFrame added(makeOffers(1, 1000, xlm, usd)[0]);
+        added.storeAdd(delta, db);
+    };
+
+    SECTION("rolled back")
+    {
+        {
+            soci::transaction sqlTx(db.getSession());
+            LedgerDelta delta(lm.getCurrentLedgerHeader(), db);
+            change(delta);
+            REQUIRE(walkOrderBook(xlm, usd, db) ==
+                    walkOffersTable(xlm, usd, db));
+            REQUIRE(walkOrderBook(xlm, idr, db) ==
+                    walkOffersTable(xlm, idr, db));
+        }
+        REQUIRE(walkOrderBook(xlm, usd, db) == usdBook);
+        REQUIRE(walkOrderBook(xlm, idr, db) == walkOffersTable(xlm, idr, db));
+    }
+    SECTION("committed")
+    {
+        {
+            soci::transaction sqlTx(db.getSession());
+            LedgerDelta delta(lm.getCurrentLedgerHeader(), db);
+            change(delta);
+            delta.commit();
+            sqlTx.commit();
+        }
+        auto book = walkOrderBook(xlm, usd, db);
+        REQUIRE(book == walkOffersTable(xlm, usd, db));
+        REQUIRE(book.size() == 49);
+        REQUIRE(book[0] == usdBook[10]);
+        REQUIRE(walkOrderBook(xlm, idr, db) == walkOffersTable(xlm, idr, db));
+    }
+}
+
+TEST_CASE("offer crossing bench", "[offers][bench][hide]")
+{
+    VirtualClock clock;
+    Application::pointer app = Application::create(clock, getTestConfig());
+    app->start();
+    auto& db = app->getDatabase();
+    auto& lm = app->getLedgerManager();
+
+    Asset xlm;
+    xlm.type(ASSET_TYPE_NATIVE);
+    Asset usd = makeAsset(getAccount("gateway"), "USD");
+
+    // takes every offer of the book, the way convertWithOffers used to walk
+    // it (SQL) and walks it now (order book)
+    auto crossAll = [&](bool useSQL) {
+        soci::transaction sqlTx(db.getSession());
+        LedgerDelta delta(lm.getCurrentLedgerHeader(), db);
+        auto start = std::chrono::steady_clock::now();
+        size_t crossed = 0;
+        if (useSQL)
+        {
+            std::vector<OfferFrame::pointer> offers;
+            do
+            {
+                offers.clear();
+                OfferFrame::loadBestOffers(5, 0, usd, xlm, offers, db);
+                for (auto const& offer : offers)
+                {
+                    offer->storeDelete(delta, db);
+                    ++crossed;
+                }
+            } while (offers.size() == 5);
+        }
+        else
+        {
+            OfferFrame::pointer offer;
+            while ((offer = OfferFrame::loadNextBestOffer(usd, xlm,
+                                                          offer.get(), db)))
+            {
+                offer->storeDelete(delta, db);
+                ++crossed;
+            }
+        }
+        auto end = std::chrono::steady_clock::now();
+        LOG(INFO) << "Crossed " << crossed << " offers "
+                  << (useSQL ? "with SQL" : "with the order book") << " in "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(
+                         end - start)
+                         .count()
+                  << "ms";
+        // scope exit rolls the deletes back
+    };
+
+    uint64 nextID = 1;
+    for (size_t n : {1000, 10000, 100000})
+    {
+        OfferFrame::storeAddBulk(db, makeOffers(n - nextID + 1, nextID, usd,
+                                                xlm));
+        nextID = n + 1;
+        crossAll(true);
+        crossAll(false);
+    }
+}
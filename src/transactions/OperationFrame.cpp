@@ -109,6 +109,38 @@ OperationFrame::getSourceID() const
                                     : mParentTx.getEnvelope().tx.sourceAccount;
 }
 
+void
+OperationFrame::insertAccountKey(LedgerKeySet& keys, AccountID const& accountID)
+{
+    LedgerKey key;
+    key.type(ACCOUNT);
+    key.account().accountID = accountID;
+    keys.insert(key);
+}
+
+void
+OperationFrame::insertTrustLineKeys(LedgerKeySet& keys,
+                                    AccountID const& accountID,
+                                    Asset const& asset)
+{
+    using xdr::operator==;
+    if (asset.type() == ASSET_TYPE_NATIVE)
+    {
+        return;
+    }
+    auto issuer = getIssuer(asset);
+    insertAccountKey(keys, issuer);
+    // the issuer's own trust line isn't stored, see TrustFrame
+    if (!(accountID == issuer))
+    {
+        LedgerKey key;
+        key.type(TRUSTLINE);
+        key.trustLine().accountID = accountID;
+        key.trustLine().asset = asset;
+        keys.insert(key);
+    }
+}
+
 bool
 OperationFrame::loadAccount(int ledgerProtocolVersion, LedgerDelta* delta, Database& db)
 {
@@ -39,6 +39,15 @@ class OperationFrame
                          LedgerManager& ledgerManager) = 0;
     virtual int32_t getNeededThreshold() const;
 
+    // helpers for insertLedgerKeysToPrefetch
+    static void insertAccountKey(LedgerKeySet& keys,
+                                 AccountID const& accountID);
+    // the trust line of `accountID` for `asset` and the account of its
+    // issuer, if `asset` isn't native
+    static void insertTrustLineKeys(LedgerKeySet& keys,
+                                    AccountID const& accountID,
+                                    Asset const& asset);
+
   public:
     static std::shared_ptr<OperationFrame>
     makeHelper(Operation const& op, OperationResult& res,
@@ -82,6 +91,14 @@ class OperationFrame
     bool apply(SignatureChecker& signatureChecker, LedgerDelta& delta,
                Application& app);
 
+    // Add the keys of the accounts and trust lines that applying this
+    // operation will load, other than its source account, as far as they
+    // can be told without looking at the ledger.
+    virtual void
+    insertLedgerKeysToPrefetch(LedgerKeySet& keys) const
+    {
+    }
+
     Operation const&
     getOperation() const
     {
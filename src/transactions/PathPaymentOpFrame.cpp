@@ -374,4 +374,13 @@ PathPaymentOpFrame::doCheckValid(Application& app)
     }
     return true;
 }
+
+void
+PathPaymentOpFrame::insertLedgerKeysToPrefetch(LedgerKeySet& keys) const
+{
+    insertAccountKey(keys, mPathPayment.destination);
+    insertTrustLineKeys(keys, getSourceID(), mPathPayment.sendAsset);
+    insertTrustLineKeys(keys, mPathPayment.destination,
+                        mPathPayment.destAsset);
+}
 }
@@ -7,6 +7,8 @@
 #include "lib/catch.hpp"
 #include "main/Application.h"
 #include "main/Config.h"
+#include "medida/meter.h"
+#include "medida/metrics_registry.h"
 #include "overlay/LoopbackPeer.h"
 #include "test/TestAccount.h"
 #include "test/TestExceptions.h"
@@ -1302,6 +1304,71 @@ TEST_CASE("payment", "[tx][payment]")
     }
 }
 
+TEST_CASE("payments prefetch their accounts and trust lines",
+          "[tx][payment][prefetch]")
+{
+    using xdr::operator==;
+
+    VirtualClock clock;
+    ApplicationEditableVersion app(clock, getTestConfig());
+    app.start();
+
+    auto root = TestAccount::createRoot(app);
+    int64_t const minBalance =
+        app.getLedgerManager().getMinBalance(2) +
+        10 * app.getLedgerManager().getTxFee();
+    auto gateway = root.create("gate", minBalance);
+    auto a1 = root.create("A", minBalance);
+    SecretKey b1 = getAccount("B");
+    Asset idrCur = makeAsset(gateway, "IDR");
+    a1.changeTrust(idrCur, 1000);
+
+    LedgerKeySet keys;
+    auto creditTx =
+        createCreditPaymentTx(app.getNetworkID(), gateway, a1, idrCur, 1, 100);
+    auto results = creditTx->getResult();
+    creditTx->insertLedgerKeysToPrefetch(keys);
+    // the results are left alone
+    REQUIRE(creditTx->getResult() == results);
+    createPaymentTx(app.getNetworkID(), a1, b1, 1, 100)
+        ->insertLedgerKeysToPrefetch(keys);
+    // the accounts of gateway, a1 and b1, and the trust line of a1 (the
+    // gateway doesn't need one for its own asset)
+    REQUIRE(keys.size() == 4);
+
+    auto& db = app.getDatabase();
+    db.getEntryCache().clear();
+    REQUIRE(EntryFrame::prefetch(keys, db) == keys.size());
+    REQUIRE(db.getEntryCache().size() == keys.size());
+    // already cached keys aren't loaded again
+    REQUIRE(EntryFrame::prefetch(keys, db) == 0);
+
+    auto& hits = app.getMetrics().NewMeter({"ledger", "prefetch", "hit"},
+                                           "entry");
+    auto hitsBefore = hits.count();
+    for (auto const& key : keys)
+    {
+        // what was prefetched is what loading the entry gives
+        REQUIRE(EntryFrame::cachedEntryExists(key, db));
+        auto cached = EntryFrame::getCachedEntry(key, db);
+        EntryFrame::flushCachedEntry(key, db);
+        auto loaded = EntryFrame::storeLoad(key, db);
+        if (key.type() == ACCOUNT &&
+            key.account().accountID == b1.getPublicKey())
+        {
+            REQUIRE(cached == nullptr);
+            REQUIRE(loaded == nullptr);
+        }
+        else
+        {
+            REQUIRE(cached != nullptr);
+            REQUIRE(loaded != nullptr);
+            REQUIRE(*cached == loaded->mEntry);
+        }
+    }
+    REQUIRE(hits.count() - hitsBefore == keys.size());
+}
+
 TEST_CASE("single create account SQL", "[singlesql][paymentsql][hide]")
 {
     Config::TestDbMode mode = Config::TESTDB_ON_DISK_SQLITE;
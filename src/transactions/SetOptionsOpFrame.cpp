@@ -310,4 +310,13 @@ SetOptionsOpFrame::doCheckValid(Application& app)
 
     return true;
 }
+
+void
+SetOptionsOpFrame::insertLedgerKeysToPrefetch(LedgerKeySet& keys) const
+{
+    if (mSetOptions.inflationDest)
+    {
+        insertAccountKey(keys, *mSetOptions.inflationDest);
+    }
+}
 }
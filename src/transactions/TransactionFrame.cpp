@@ -7,6 +7,7 @@
 #include "OperationFrame.h"
 #include "crypto/Hex.h"
 #include "crypto/SHA.h"
+#include "crypto/SecretKey.h"
 #include "crypto/SignerKey.h"
 #include "database/Database.h"
 #include "herder/TxSetFrame.h"
@@ -14,10 +15,10 @@
 #include "main/Application.h"
 #include "transactions/SignatureChecker.h"
 #include "transactions/SignatureUtils.h"
+#include "transactions/TxHistoryBatch.h"
 #include "util/Algoritm.h"
 #include "util/Logging.h"
 #include "util/XDRStream.h"
-#include "util/basen.h"
 #include "xdrpp/marshal.h"
 #include <string>
 
@@ -26,6 +27,7 @@
 
 #include <algorithm>
 #include <numeric>
+#include <unordered_map>
 
 namespace stellar
 {
@@ -550,6 +552,99 @@ TransactionFrame::apply(LedgerDelta& delta, TransactionMeta& meta,
     return !errorEncountered;
 }
 
+void
+TransactionFrame::insertLedgerKeysToPrefetch(LedgerKeySet& keys)
+{
+    LedgerKey key;
+    key.type(ACCOUNT);
+    key.account().accountID = getSourceID();
+    keys.insert(key);
+
+    // operations bound to a scratch result, so that the results of the
+    // transaction (and the operations bound to them) are left as they are
+    OperationResult opResult;
+    for (auto const& op : mEnvelope.tx.operations)
+    {
+        auto frame = OperationFrame::makeHelper(op, opResult, *this);
+        key.account().accountID = frame->getSourceID();
+        keys.insert(key);
+        frame->insertLedgerKeysToPrefetch(keys);
+    }
+}
+
+std::vector<AccountID>
+TransactionFrame::getSourceAccountIDs() const
+{
+    std::vector<AccountID> accountIDs{getSourceID()};
+    for (auto const& op : mEnvelope.tx.operations)
+    {
+        if (op.sourceAccount &&
+            std::find(accountIDs.begin(), accountIDs.end(),
+                      *op.sourceAccount) == accountIDs.end())
+        {
+            accountIDs.emplace_back(*op.sourceAccount);
+        }
+    }
+    return accountIDs;
+}
+
+void
+TransactionFrame::insertSignaturesToVerify(
+    Database& db, std::vector<PubKeyUtils::SigToVerify>& sigs)
+{
+    std::vector<AccountEntry> accounts;
+    for (auto const& accountID : getSourceAccountIDs())
+    {
+        auto account = AccountFrame::loadAccount(accountID, db);
+        if (account)
+        {
+            accounts.emplace_back(account->getAccount());
+        }
+    }
+    insertSignaturesToVerify(accounts, sigs);
+}
+
+void
+TransactionFrame::insertSignaturesToVerify(
+    std::vector<AccountEntry> const& accounts,
+    std::vector<PubKeyUtils::SigToVerify>& sigs)
+{
+    // the master keys and Ed25519 signers of the source accounts
+    std::vector<PublicKey> keys;
+    auto addKey = [&keys](PublicKey const& key) {
+        if (std::find(keys.begin(), keys.end(), key) == keys.end())
+        {
+            keys.emplace_back(key);
+        }
+    };
+    for (auto const& accountID : getSourceAccountIDs())
+    {
+        addKey(accountID);
+    }
+    for (auto const& account : accounts)
+    {
+        for (auto const& signer : account.signers)
+        {
+            if (signer.key.type() == SIGNER_KEY_TYPE_ED25519)
+            {
+                addKey(KeyUtils::convertKey<PublicKey>(signer.key));
+            }
+        }
+    }
+
+    for (auto const& sig : mEnvelope.signatures)
+    {
+        for (auto const& key : keys)
+        {
+            if (SignatureUtils::doesHintMatch(key.ed25519(), sig.hint))
+            {
+                sigs.push_back(PubKeyUtils::SigToVerify{key, sig.signature,
+                                                        getContentsHash()});
+            }
+        }
+    }
+}
+
 StellarMessage
 TransactionFrame::toStellarMessage() const
 {
@@ -560,102 +655,65 @@ TransactionFrame::toStellarMessage() const
 }
 
 void
-TransactionFrame::storeTransaction(LedgerManager& ledgerManager,
-                                   TransactionMeta& tm, int txindex,
+TransactionFrame::storeTransaction(TxHistoryBatch& batch, TransactionMeta& tm,
+                                   int txindex,
                                    TransactionResultSet& resultSet) const
 {
-    auto txBytes(xdr::xdr_to_opaque(mEnvelope));
-
     resultSet.results.emplace_back(getResultPair());
-    auto txResultBytes(xdr::xdr_to_opaque(resultSet.results.back()));
-
-    std::string txBody;
-    txBody = bn::encode_b64(txBytes);
-
-    std::string txResult;
-    txResult = bn::encode_b64(txResultBytes);
-
-    xdr::opaque_vec<> txMeta(xdr::xdr_to_opaque(tm));
-
-    std::string meta;
-    meta = bn::encode_b64(txMeta);
 
-    string txIDString(binToHex(getContentsHash()));
-
-    auto& db = ledgerManager.getDatabase();
-    auto prep = db.getPreparedStatement(
-        "INSERT INTO txhistory "
-        "( txid, ledgerseq, txindex,  txbody, txresult, txmeta) VALUES "
-        "(:id,  :seq,      :txindex, :txb,   :txres,   :meta)");
-
-    auto& st = prep.statement();
-    st.exchange(soci::use(txIDString));
-    st.exchange(soci::use(ledgerManager.getCurrentLedgerHeader().ledgerSeq));
-    st.exchange(soci::use(txindex));
-    st.exchange(soci::use(txBody));
-    st.exchange(soci::use(txResult));
-    st.exchange(soci::use(meta));
-    st.define_and_bind();
-    {
-        auto timer = db.getInsertTimer("txhistory");
-        st.execute(true);
-    }
-
-    if (st.get_affected_rows() != 1)
-    {
-        throw std::runtime_error("Could not update data in SQL");
-    }
+    batch.addTransaction(binToHex(getContentsHash()), txindex,
+                         xdr::xdr_to_opaque(mEnvelope),
+                         xdr::xdr_to_opaque(resultSet.results.back()),
+                         xdr::xdr_to_opaque(tm));
 }
 
 void
-TransactionFrame::storeTransactionFee(LedgerManager& ledgerManager,
+TransactionFrame::storeTransactionFee(TxHistoryBatch& batch,
                                       LedgerEntryChanges const& changes,
                                       int txindex) const
 {
-    xdr::opaque_vec<> txChanges(xdr::xdr_to_opaque(changes));
-
-    std::string txChanges64;
-    txChanges64 = bn::encode_b64(txChanges);
-
-    string txIDString(binToHex(getContentsHash()));
-
-    auto& db = ledgerManager.getDatabase();
-    auto prep = db.getPreparedStatement(
-        "INSERT INTO txfeehistory "
-        "( txid, ledgerseq, txindex,  txchanges) VALUES "
-        "(:id,  :seq,      :txindex, :txchanges)");
-
-    auto& st = prep.statement();
-    st.exchange(soci::use(txIDString));
-    st.exchange(soci::use(ledgerManager.getCurrentLedgerHeader().ledgerSeq));
-    st.exchange(soci::use(txindex));
-    st.exchange(soci::use(txChanges64));
-    st.define_and_bind();
-    {
-        auto timer = db.getInsertTimer("txfeehistory");
-        st.execute(true);
-    }
+    batch.addTransactionFee(binToHex(getContentsHash()), txindex,
+                            xdr::xdr_to_opaque(changes));
+}
 
-    if (st.get_affected_rows() != 1)
+// The previous ledger hash of each ledger in [begin, end), read from the
+// prevhash column rather than by decoding each whole header.
+static std::unordered_map<uint32_t, Hash>
+loadPreviousLedgerHashes(Database& db, soci::session& sess, uint32_t begin,
+                         uint32_t end)
+{
+    auto timer = db.getSelectTimer("ledger-header-history");
+    std::unordered_map<uint32_t, Hash> res;
+    uint32_t ledgerSeq;
+    std::string prevHash;
+    soci::statement st =
+        (sess.prepare << "SELECT ledgerseq, prevhash FROM ledgerheaders "
+                         "WHERE ledgerseq >= :begin AND ledgerseq < :end",
+         soci::into(ledgerSeq), soci::into(prevHash), soci::use(begin),
+         soci::use(end));
+    st.execute(true);
+    while (st.got_data())
     {
-        throw std::runtime_error("Could not update data in SQL");
+        res.emplace(ledgerSeq, hexToBin256(prevHash));
+        st.fetch();
     }
+    return res;
 }
 
 static void
-saveTransactionHelper(Database& db, soci::session& sess, uint32 ledgerSeq,
-                      TxSetFrame& txSet, TransactionHistoryResultEntry& results,
+saveTransactionHelper(std::unordered_map<uint32_t, Hash> const& prevHashes,
+                      uint32 ledgerSeq, TxSetFrame& txSet,
+                      TransactionHistoryResultEntry& results,
                       XDROutputFileStream& txOut,
                       XDROutputFileStream& txResultOut)
 {
     // prepare the txset for saving
-    LedgerHeaderFrame::pointer lh =
-        LedgerHeaderFrame::loadBySequence(ledgerSeq, db, sess);
-    if (!lh)
+    auto prevHash = prevHashes.find(ledgerSeq);
+    if (prevHash == prevHashes.end())
     {
         throw std::runtime_error("Could not find ledger");
     }
-    txSet.previousLedgerHash() = lh->mHeader.previousLedgerHash;
+    txSet.previousLedgerHash() = prevHash->second;
     txSet.sortForHash();
     TransactionHistoryEntry hist;
     hist.ledgerSeq = ledgerSeq;
@@ -669,20 +727,20 @@ TransactionResultSet
 TransactionFrame::getTransactionHistoryResults(Database& db, uint32 ledgerSeq)
 {
     TransactionResultSet res;
-    std::string txresult64;
+    HistoryBlob txResult(db, db.getSession());
     auto prep =
         db.getPreparedStatement("SELECT txresult FROM txhistory "
                                 "WHERE ledgerseq = :lseq ORDER BY txindex ASC");
     auto& st = prep.statement();
 
     st.exchange(soci::use(ledgerSeq));
-    st.exchange(soci::into(txresult64));
+    st.exchange(txResult.into());
     st.define_and_bind();
     st.execute(true);
     while (st.got_data())
     {
         std::vector<uint8_t> result;
-        bn::decode_b64(txresult64, result);
+        txResult.get(result);
 
         res.results.emplace_back();
         TransactionResultPair& p = res.results.back();
@@ -699,20 +757,20 @@ std::vector<LedgerEntryChanges>
 TransactionFrame::getTransactionFeeMeta(Database& db, uint32 ledgerSeq)
 {
     std::vector<LedgerEntryChanges> res;
-    std::string changes64;
+    HistoryBlob changes(db, db.getSession());
     auto prep =
         db.getPreparedStatement("SELECT txchanges FROM txfeehistory "
                                 "WHERE ledgerseq = :lseq ORDER BY txindex ASC");
     auto& st = prep.statement();
 
-    st.exchange(soci::into(changes64));
+    st.exchange(changes.into());
     st.exchange(soci::use(ledgerSeq));
     st.define_and_bind();
     st.execute(true);
     while (st.got_data())
     {
         std::vector<uint8_t> changesRaw;
-        bn::decode_b64(changes64, changesRaw);
+        changes.get(changesRaw);
 
         xdr::xdr_get g1(&changesRaw.front(), &changesRaw.back() + 1);
         res.emplace_back();
@@ -732,7 +790,7 @@ TransactionFrame::copyTransactionsToStream(Hash const& networkID, Database& db,
                                            XDROutputFileStream& txResultOut)
 {
     auto timer = db.getSelectTimer("txhistory");
-    std::string txBody, txResult, txMeta;
+    HistoryBlob txBody(db, sess), txResult(db, sess);
     uint32_t begin = ledgerSeq, end = ledgerSeq + ledgerCount;
     size_t n = 0;
 
@@ -744,12 +802,16 @@ TransactionFrame::copyTransactionsToStream(Hash const& networkID, Database& db,
         (sess.prepare << "SELECT ledgerseq, txbody, txresult FROM txhistory "
                          "WHERE ledgerseq >= :begin AND ledgerseq < :end ORDER "
                          "BY ledgerseq ASC, txindex ASC",
-         soci::into(curLedgerSeq), soci::into(txBody), soci::into(txResult),
+         soci::into(curLedgerSeq), txBody.into(), txResult.into(),
          soci::use(begin), soci::use(end));
 
+    auto prevHashes = loadPreviousLedgerHashes(db, sess, begin, end);
+
     Hash h;
     TxSetFrame txSet(h); // we're setting the hash later
     TransactionHistoryResultEntry results;
+    // decoding buffers, kept across rows
+    std::vector<uint8_t> body, result;
 
     st.execute(true);
 
@@ -760,7 +822,7 @@ TransactionFrame::copyTransactionsToStream(Hash const& networkID, Database& db,
     {
         if (curLedgerSeq != lastLedgerSeq)
         {
-            saveTransactionHelper(db, sess, lastLedgerSeq, txSet, results,
+            saveTransactionHelper(prevHashes, lastLedgerSeq, txSet, results,
                                   txOut, txResultOut);
             // reset state
             txSet.mTransactions.clear();
@@ -769,11 +831,8 @@ TransactionFrame::copyTransactionsToStream(Hash const& networkID, Database& db,
             lastLedgerSeq = curLedgerSeq;
         }
 
-        std::vector<uint8_t> body;
-        bn::decode_b64(txBody, body);
-
-        std::vector<uint8_t> result;
-        bn::decode_b64(txResult, result);
+        txBody.get(body);
+        txResult.get(result);
 
         xdr::xdr_get g1(&body.front(), &body.back() + 1);
         xdr_argpack_archive(g1, tx);
@@ -798,8 +857,8 @@ TransactionFrame::copyTransactionsToStream(Hash const& networkID, Database& db,
     }
     if (n != 0)
     {
-        saveTransactionHelper(db, sess, lastLedgerSeq, txSet, results, txOut,
-                              txResultOut);
+        saveTransactionHelper(prevHashes, lastLedgerSeq, txSet, results,
+                              txOut, txResultOut);
     }
     return n;
 }
@@ -28,6 +28,12 @@ class OperationFrame;
 class LedgerDelta;
 class SecretKey;
 class SignatureChecker;
+class TxHistoryBatch;
+
+namespace PubKeyUtils
+{
+struct SigToVerify;
+}
 class XDROutputFileStream;
 class SHA256;
 
@@ -160,18 +166,40 @@ class TransactionFrame
     // version without meta
     bool apply(LedgerDelta& delta, Application& app);
 
+    // Add the keys of the accounts and trust lines that applying this
+    // transaction will load, see OperationFrame.
+    void insertLedgerKeysToPrefetch(LedgerKeySet& keys);
+
+    // The source account of the transaction and those of its operations,
+    // without duplicates.
+    std::vector<AccountID> getSourceAccountIDs() const;
+
+    // Add the Ed25519 signatures of the transaction, with each key of its
+    // source accounts they may be checked against, to `sigs`. Verifying
+    // them up front with PubKeyUtils::verifySigs makes the checks of
+    // checkValid and apply cache hits. The source accounts are loaded from
+    // `db`.
+    void insertSignaturesToVerify(Database& db,
+                                  std::vector<PubKeyUtils::SigToVerify>& sigs);
+
+    // Same, with the source accounts already loaded in `accounts`, e.g.
+    // through a pool session off the main thread. Only the master key of
+    // the source accounts missing from it is used.
+    void insertSignaturesToVerify(std::vector<AccountEntry> const& accounts,
+                                  std::vector<PubKeyUtils::SigToVerify>& sigs);
+
     StellarMessage toStellarMessage() const;
 
     AccountFrame::pointer loadAccount(int ledgerProtocolVersion,
                                       LedgerDelta* delta, Database& app,
                                       AccountID const& accountID);
 
-    // transaction history
-    void storeTransaction(LedgerManager& ledgerManager, TransactionMeta& tm,
+    // transaction history, written when `batch` is stored
+    void storeTransaction(TxHistoryBatch& batch, TransactionMeta& tm,
                           int txindex, TransactionResultSet& resultSet) const;
 
-    // fee history
-    void storeTransactionFee(LedgerManager& ledgerManager,
+    // fee history, written when `batch` is stored
+    void storeTransactionFee(TxHistoryBatch& batch,
                              LedgerEntryChanges const& changes,
                              int txindex) const;
 
@@ -0,0 +1,117 @@
+// Copyright 2017 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "transactions/TxHistoryBatch.h"
+#include "database/Database.h"
+#include <stdexcept>
+
+namespace stellar
+{
+
+using namespace soci;
+
+TxHistoryBatch::TxHistoryBatch(uint32 ledgerSeq) : mLedgerSeq(ledgerSeq)
+{
+}
+
+void
+TxHistoryBatch::addTransaction(std::string txID, int txindex,
+                               xdr::opaque_vec<> txBody,
+                               xdr::opaque_vec<> txResult,
+                               xdr::opaque_vec<> txMeta)
+{
+    mTxIDs.emplace_back(std::move(txID));
+    mTxIndexes.emplace_back(txindex);
+    mTxBodies.emplace_back(std::move(txBody));
+    mTxResults.emplace_back(std::move(txResult));
+    mTxMetas.emplace_back(std::move(txMeta));
+}
+
+void
+TxHistoryBatch::addTransactionFee(std::string txID, int txindex,
+                                  xdr::opaque_vec<> txChanges)
+{
+    mFeeTxIDs.emplace_back(std::move(txID));
+    mFeeTxIndexes.emplace_back(txindex);
+    mFeeTxChanges.emplace_back(std::move(txChanges));
+}
+
+void
+TxHistoryBatch::store(Database& db)
+{
+    int seq = mLedgerSeq;
+
+    auto encode = [&db](std::vector<xdr::opaque_vec<>> const& blobs) {
+        std::vector<HistoryBlob> res;
+        res.reserve(blobs.size());
+        for (auto const& b : blobs)
+        {
+            res.emplace_back(db, db.getSession());
+            res.back().set(b);
+        }
+        return res;
+    };
+
+    if (!mFeeTxIDs.empty())
+    {
+        auto txChanges = encode(mFeeTxChanges);
+        auto timer = db.getInsertTimer("txfeehistory");
+        auto inserted = db.executeBulk(
+            mFeeTxIDs.size(), 4,
+            [&](size_t n) {
+                return "INSERT INTO txfeehistory "
+                       "(txid, ledgerseq, txindex, txchanges) VALUES " +
+                       Database::getPlaceholders(n, "(?, ?, ?, ?)", ", ");
+            },
+            [&](statement& st, size_t row) {
+                st.exchange(use(mFeeTxIDs[row]));
+                st.exchange(use(seq));
+                st.exchange(use(mFeeTxIndexes[row]));
+                st.exchange(txChanges[row].use());
+            });
+        if (inserted != static_cast<long long>(mFeeTxIDs.size()))
+        {
+            throw std::runtime_error("Could not update data in SQL");
+        }
+    }
+
+    if (!mTxIDs.empty())
+    {
+        auto txBodies = encode(mTxBodies);
+        auto txResults = encode(mTxResults);
+        auto txMetas = encode(mTxMetas);
+        auto timer = db.getInsertTimer("txhistory");
+        auto inserted = db.executeBulk(
+            mTxIDs.size(), 6,
+            [&](size_t n) {
+                return "INSERT INTO txhistory "
+                       "(txid, ledgerseq, txindex, txbody, txresult, txmeta) "
+                       "VALUES " +
+                       Database::getPlaceholders(n, "(?, ?, ?, ?, ?, ?)",
+                                                 ", ");
+            },
+            [&](statement& st, size_t row) {
+                st.exchange(use(mTxIDs[row]));
+                st.exchange(use(seq));
+                st.exchange(use(mTxIndexes[row]));
+                st.exchange(txBodies[row].use());
+                st.exchange(txResults[row].use());
+                st.exchange(txMetas[row].use());
+            });
+        if (inserted != static_cast<long long>(mTxIDs.size()))
+        {
+            throw std::runtime_error("Could not update data in SQL");
+        }
+    }
+
+    mTxIDs.clear();
+    mTxIndexes.clear();
+    mTxBodies.clear();
+    mTxResults.clear();
+    mTxMetas.clear();
+    mFeeTxIDs.clear();
+    mFeeTxIndexes.clear();
+    mFeeTxChanges.clear();
+}
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+// Copyright 2017 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "overlay/StellarXDR.h"
+#include "util/NonCopyable.h"
+#include <string>
+#include <vector>
+
+namespace stellar
+{
+class Database;
+
+/**
+ * The txhistory and txfeehistory rows of the ledger being closed.
+ *
+ * TransactionFrame adds the rows of each transaction as it is applied, and
+ * they are written with multi-row inserts, a few per table, once the
+ * transaction set has been applied, instead of one INSERT per transaction.
+ * The rows are written in the same SQL transaction as the rest of the
+ * ledger, so they are committed (or rolled back) together with it.
+ */
+class TxHistoryBatch : NonMovableOrCopyable
+{
+    uint32 mLedgerSeq;
+
+    std::vector<std::string> mTxIDs;
+    std::vector<int> mTxIndexes;
+    std::vector<xdr::opaque_vec<>> mTxBodies;
+    std::vector<xdr::opaque_vec<>> mTxResults;
+    std::vector<xdr::opaque_vec<>> mTxMetas;
+
+    std::vector<std::string> mFeeTxIDs;
+    std::vector<int> mFeeTxIndexes;
+    std::vector<xdr::opaque_vec<>> mFeeTxChanges;
+
+  public:
+    explicit TxHistoryBatch(uint32 ledgerSeq);
+
+    // Add the txhistory row of a transaction, fields XDR encoded.
+    void addTransaction(std::string txID, int txindex,
+                        xdr::opaque_vec<> txBody, xdr::opaque_vec<> txResult,
+                        xdr::opaque_vec<> txMeta);
+
+    // Add the txfeehistory row of a transaction, changes XDR encoded.
+    void addTransactionFee(std::string txID, int txindex,
+                           xdr::opaque_vec<> txChanges);
+
+    // Write the rows added so far, blobs encoded the way `db` stores them,
+    // and forget them.
+    void store(Database& db);
+};
+}
@@ -0,0 +1,221 @@
+// Copyright 2017 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "util/BlockCompression.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#ifdef USE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace stellar
+{
+
+// Every member header we write has this fixed layout (RFC 1952): the gzip
+// magic, deflate method, FEXTRA flag, zero mtime, unknown OS, then an extra
+// field holding a single "SB" subfield with the block's sizes.
+static const size_t kHeaderSize = 24;
+static const size_t kTrailerSize = 8;
+static const unsigned char kHeaderPrefix[] = {0x1f, 0x8b, 8,  4,   0, 0,
+                                              0,    0,    0,  255, 12, 0,
+                                              'S',  'B',  8,  0};
+
+static void
+putLE32(unsigned char* p, uint32_t v)
+{
+    p[0] = static_cast<unsigned char>(v);
+    p[1] = static_cast<unsigned char>(v >> 8);
+    p[2] = static_cast<unsigned char>(v >> 16);
+    p[3] = static_cast<unsigned char>(v >> 24);
+}
+
+static uint32_t
+getLE32(unsigned char const* p)
+{
+    return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) |
+           (uint32_t(p[3]) << 24);
+}
+
+static void
+checkSupported()
+{
+    if (!blockCompressionSupported())
+    {
+        throw std::runtime_error(
+            "block-compressed files are not supported by this build");
+    }
+}
+
+bool
+blockCompressionSupported()
+{
+#ifdef USE_ZLIB
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool
+isBlockCompressedFile(std::string const& filename)
+{
+    std::ifstream in(filename, std::ifstream::binary);
+    unsigned char magic[2];
+    if (!in.read(reinterpret_cast<char*>(magic), 2))
+    {
+        return false;
+    }
+    return magic[0] == kHeaderPrefix[0] && magic[1] == kHeaderPrefix[1];
+}
+
+bool
+readCompressedBlockHeader(std::FILE* f, CompressedBlockHeader& hdr)
+{
+    unsigned char buf[kHeaderSize];
+    size_t got = std::fread(buf, 1, kHeaderSize, f);
+    if (got == 0 && std::feof(f))
+    {
+        return false;
+    }
+    if (got != kHeaderSize ||
+        std::memcmp(buf, kHeaderPrefix, 4) != 0 ||
+        std::memcmp(buf + 10, kHeaderPrefix + 10, 6) != 0)
+    {
+        throw std::runtime_error("malformed block-compressed file");
+    }
+    hdr.mRawSize = getLE32(buf + 16);
+    hdr.mCompressedSize = getLE32(buf + 20);
+    return true;
+}
+
+static void
+seekForward(std::FILE* f, uint64_t n)
+{
+#ifdef _WIN32
+    int r = _fseeki64(f, static_cast<__int64>(n), SEEK_CUR);
+#else
+    int r = fseeko(f, static_cast<off_t>(n), SEEK_CUR);
+#endif
+    if (r != 0)
+    {
+        throw std::runtime_error("failed seeking in block-compressed file");
+    }
+}
+
+void
+skipCompressedBlock(std::FILE* f, CompressedBlockHeader const& hdr)
+{
+    seekForward(f, uint64_t(hdr.mCompressedSize) + kTrailerSize);
+}
+
+void
+readCompressedBlock(std::FILE* f, CompressedBlockHeader const& hdr, char* out)
+{
+    checkSupported();
+#ifdef USE_ZLIB
+    std::vector<unsigned char> in(hdr.mCompressedSize + kTrailerSize);
+    if (std::fread(in.data(), 1, in.size(), f) != in.size())
+    {
+        throw std::runtime_error("truncated block-compressed file");
+    }
+
+    z_stream zs;
+    std::memset(&zs, 0, sizeof(zs));
+    if (inflateInit2(&zs, -MAX_WBITS) != Z_OK)
+    {
+        throw std::runtime_error("inflateInit2 failed");
+    }
+    zs.next_in = in.data();
+    zs.avail_in = hdr.mCompressedSize;
+    zs.next_out = reinterpret_cast<Bytef*>(out);
+    zs.avail_out = hdr.mRawSize;
+    int r = inflate(&zs, Z_FINISH);
+    inflateEnd(&zs);
+
+    unsigned char const* trailer = in.data() + hdr.mCompressedSize;
+    if (r != Z_STREAM_END || zs.avail_out != 0 ||
+        getLE32(trailer + 4) != hdr.mRawSize ||
+        getLE32(trailer) !=
+            crc32(0, reinterpret_cast<Bytef*>(out), hdr.mRawSize))
+    {
+        throw std::runtime_error("corrupt block in block-compressed file");
+    }
+#endif
+}
+
+BlockCompressor::BlockCompressor(std::ostream& out, size_t blockSize)
+    : mOut(out), mBlockSize(blockSize)
+{
+    checkSupported();
+    mPending.reserve(mBlockSize);
+}
+
+void
+BlockCompressor::write(char const* data, size_t size)
+{
+    while (size != 0)
+    {
+        size_t n = std::min(size, mBlockSize - mPending.size());
+        mPending.insert(mPending.end(), data, data + n);
+        data += n;
+        size -= n;
+        if (mPending.size() == mBlockSize)
+        {
+            writeBlock(mPending.data(), mPending.size());
+            mPending.clear();
+        }
+    }
+}
+
+void
+BlockCompressor::flush()
+{
+    if (!mPending.empty())
+    {
+        writeBlock(mPending.data(), mPending.size());
+        mPending.clear();
+    }
+}
+
+void
+BlockCompressor::writeBlock(char const* data, size_t size)
+{
+#ifdef USE_ZLIB
+    z_stream zs;
+    std::memset(&zs, 0, sizeof(zs));
+    if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8,
+                     Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        throw std::runtime_error("deflateInit2 failed");
+    }
+    uLong bound = deflateBound(&zs, static_cast<uLong>(size));
+    mScratch.resize(kHeaderSize + bound + kTrailerSize);
+    auto buf = reinterpret_cast<unsigned char*>(mScratch.data());
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    zs.avail_in = static_cast<uInt>(size);
+    zs.next_out = buf + kHeaderSize;
+    zs.avail_out = static_cast<uInt>(bound);
+    int r = deflate(&zs, Z_FINISH);
+    uint32_t compressed = static_cast<uint32_t>(zs.total_out);
+    deflateEnd(&zs);
+    if (r != Z_STREAM_END)
+    {
+        throw std::runtime_error("deflate failed");
+    }
+
+    std::memcpy(buf, kHeaderPrefix, sizeof(kHeaderPrefix));
+    putLE32(buf + 16, static_cast<uint32_t>(size));
+    putLE32(buf + 20, compressed);
+    unsigned char* trailer = buf + kHeaderSize + compressed;
+    putLE32(trailer, static_cast<uint32_t>(
+                         crc32(0, reinterpret_cast<Bytef const*>(data),
+                               static_cast<uInt>(size))));
+    putLE32(trailer + 4, static_cast<uint32_t>(size));
+    mOut.write(mScratch.data(), kHeaderSize + compressed + kTrailerSize);
+#endif
+}
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+// Copyright 2017 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include <cstdint>
+#include <cstdio>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace stellar
+{
+
+/**
+ * Helpers for the "block-compressed" file format, used to store buckets.
+ *
+ * A block-compressed file is a sequence of independent gzip members, each
+ * holding the deflated contents of one block of the uncompressed file. Any
+ * gzip implementation decompresses the whole file back to the original, so
+ * a block-compressed bucket can be published to a history archive as-is.
+ *
+ * Each member carries, in a gzip "extra" field, the uncompressed and
+ * compressed sizes of its block. Readers use these to step from block to
+ * block, and to seek to the block holding a given uncompressed offset,
+ * without inflating the blocks in between.
+ *
+ * Requires zlib; without it (see `blockCompressionSupported`) files can be
+ * neither written nor read in this format.
+ */
+
+// Whether this build can read and write block-compressed files.
+bool blockCompressionSupported();
+
+// Whether `filename` starts like a block-compressed (or any gzip) file. Plain
+// XDR files never do: their first byte has the XDR continuation bit set.
+bool isBlockCompressedFile(std::string const& filename);
+
+// Default uncompressed size of a block.
+static const size_t kDefaultCompressedBlockSize = 256 * 1024;
+
+struct CompressedBlockHeader
+{
+    uint32_t mRawSize;
+    uint32_t mCompressedSize;
+};
+
+// Read the header of the member at the current position of `f`. Returns
+// false at end of file; throws if the data there is not a block header.
+bool readCompressedBlockHeader(std::FILE* f, CompressedBlockHeader& hdr);
+
+// Skip the body of the member whose header was just read.
+void skipCompressedBlock(std::FILE* f, CompressedBlockHeader const& hdr);
+
+// Read and inflate the body of the member whose header was just read into
+// `out`, which must have room for `hdr.mRawSize` bytes.
+void readCompressedBlock(std::FILE* f, CompressedBlockHeader const& hdr,
+                         char* out);
+
+// Accumulates uncompressed bytes and writes them to a stream as a sequence of
+// block-compressed members of `blockSize` bytes each (the last may be short).
+class BlockCompressor
+{
+    std::ostream& mOut;
+    size_t mBlockSize;
+    std::vector<char> mPending;
+    std::vector<char> mScratch;
+
+    void writeBlock(char const* data, size_t size);
+
+  public:
+    BlockCompressor(std::ostream& out,
+                    size_t blockSize = kDefaultCompressedBlockSize);
+
+    void write(char const* data, size_t size);
+
+    // Write out any partial block. Must be called before closing the stream.
+    void flush();
+};
+}
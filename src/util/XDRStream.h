@@ -6,41 +6,321 @@
 
 #include "crypto/ByteSlice.h"
 #include "crypto/SHA.h"
+#include "util/BlockCompression.h"
 #include "util/Logging.h"
+#include "util/make_unique.h"
 #include "xdrpp/marshal.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 namespace stellar
 {
 
 /**
  * Helper for loading a sequence of XDR objects from a file one at a time,
  * rather than all at once.
+ *
+ * The file is read in large blocks (of `blockSize` bytes) and records are
+ * decoded directly out of the block, so that long sequential scans (bucket
+ * merges and applies, history replay) pay one read syscall per block rather
+ * than two per record. On platforms that support it the kernel is told to
+ * expect sequential access and to read ahead the next block.
+ *
+ * Alternatively, if `mapFile` is set, the whole file is mapped into memory
+ * and records are decoded in place from the mapping, without copying through
+ * a block at all. Mapped readers of the same file share its page cache. On
+ * platforms without mmap this falls back to block reads.
+ *
+ * Block-compressed files (see util/BlockCompression.h) are recognized when
+ * opened and inflated a block at a time as they are read; mapping is not used
+ * for them. Offsets (`pos` and `seek`) are always offsets in the uncompressed
+ * data.
  */
 class XDRInputFileStream
 {
-    std::ifstream mIn;
-    std::vector<char> mBuf;
+    std::FILE* mFile{nullptr};
+    std::vector<char> mBlock;
+    void* mMap{nullptr};
+    size_t mMapSize{0};
+    char const* mData{nullptr};
+    size_t mBlockPos{0};
+    size_t mBlockEnd{0};
+    uint64_t mFileOffset{0};
+    bool mEOF{false};
+    bool mMapped{false};
+    bool mCompressed{false};
+    // For compressed files: uncompressed and file offsets of the start of
+    // each block, built on the first seek.
+    std::vector<std::pair<uint64_t, uint64_t>> mBlockTable;
     int mSizeLimit;
+    size_t mBlockSize;
+    bool mMapFile;
+
+    // Ensure at least `n` contiguous unread bytes are available at mData,
+    // starting at mBlockPos. Returns false if the file ends first.
+    bool
+    fill(size_t n)
+    {
+        size_t avail = mBlockEnd - mBlockPos;
+        if (avail >= n)
+        {
+            return true;
+        }
+        if (mEOF)
+        {
+            return false;
+        }
+
+        // Shift the unread tail of the block to the front, growing the block
+        // if a single record is larger than it.
+        if (avail != 0 && mBlockPos != 0)
+        {
+            std::memmove(mBlock.data(), mBlock.data() + mBlockPos, avail);
+        }
+        mBlockPos = 0;
+        mBlockEnd = avail;
+        if (mBlock.size() < std::max(n, mBlockSize))
+        {
+            mBlock.resize(std::max(n, mBlockSize));
+        }
+        mData = mBlock.data();
+
+        while (mCompressed && mBlockEnd < n && !mEOF)
+        {
+            CompressedBlockHeader hdr;
+            if (!readCompressedBlockHeader(mFile, hdr))
+            {
+                mEOF = true;
+                break;
+            }
+            if (mBlock.size() < mBlockEnd + hdr.mRawSize)
+            {
+                mBlock.resize(mBlockEnd + hdr.mRawSize);
+                mData = mBlock.data();
+            }
+            readCompressedBlock(mFile, hdr, mBlock.data() + mBlockEnd);
+            mBlockEnd += hdr.mRawSize;
+            mFileOffset += hdr.mRawSize;
+        }
+
+        while (mBlockEnd < n && !mEOF)
+        {
+            size_t want = mBlock.size() - mBlockEnd;
+            size_t got = std::fread(mBlock.data() + mBlockEnd, 1, want, mFile);
+            if (got < want)
+            {
+                if (std::ferror(mFile))
+                {
+                    throw std::runtime_error("failed reading XDR file");
+                }
+                mEOF = true;
+            }
+            mBlockEnd += got;
+            mFileOffset += got;
+            adviseReadAhead();
+        }
+        return mBlockEnd >= n;
+    }
+
+    void
+    seekFile(uint64_t offset)
+    {
+#ifdef _WIN32
+        int r = _fseeki64(mFile, static_cast<__int64>(offset), SEEK_SET);
+#else
+        int r = fseeko(mFile, static_cast<off_t>(offset), SEEK_SET);
+#endif
+        if (r != 0)
+        {
+            throw std::runtime_error("failed seeking in XDR file");
+        }
+    }
+
+    uint64_t
+    tellFile()
+    {
+#ifdef _WIN32
+        return static_cast<uint64_t>(_ftelli64(mFile));
+#else
+        return static_cast<uint64_t>(ftello(mFile));
+#endif
+    }
+
+    void
+    seekCompressed(uint64_t offset)
+    {
+        if (mBlockTable.empty())
+        {
+            seekFile(0);
+            uint64_t raw = 0, fileOffset = 0;
+            CompressedBlockHeader hdr;
+            while (readCompressedBlockHeader(mFile, hdr))
+            {
+                mBlockTable.emplace_back(raw, fileOffset);
+                skipCompressedBlock(mFile, hdr);
+                raw += hdr.mRawSize;
+                fileOffset = tellFile();
+            }
+            mBlockTable.emplace_back(raw, fileOffset);
+        }
+
+        // The last table entry marks the end of the file.
+        auto i = std::upper_bound(
+            mBlockTable.begin(), mBlockTable.end() - 1, offset,
+            [](uint64_t o, std::pair<uint64_t, uint64_t> const& b) {
+                return o < b.first;
+            });
+        if (i != mBlockTable.begin())
+        {
+            --i;
+        }
+        seekFile(i->second);
+        mBlockPos = mBlockEnd = 0;
+        mFileOffset = i->first;
+        mEOF = false;
+        if (fill(1))
+        {
+            mBlockPos = static_cast<size_t>(
+                std::min<uint64_t>(offset - i->first, mBlockEnd));
+        }
+    }
+
+    void
+    adviseReadAhead()
+    {
+#if defined(POSIX_FADV_WILLNEED)
+        if (!mEOF)
+        {
+            posix_fadvise(fileno(mFile), static_cast<off_t>(mFileOffset),
+                          static_cast<off_t>(mBlockSize), POSIX_FADV_WILLNEED);
+        }
+#endif
+    }
+
+    // Map the whole of the (already open) file. Returns false if mapping is
+    // unsupported or fails, in which case block reads are used instead.
+    bool
+    mapWholeFile()
+    {
+#ifndef _WIN32
+        struct stat st;
+        if (fstat(fileno(mFile), &st) != 0)
+        {
+            return false;
+        }
+        mMapSize = static_cast<size_t>(st.st_size);
+        if (mMapSize != 0)
+        {
+            void* p = ::mmap(nullptr, mMapSize, PROT_READ, MAP_PRIVATE,
+                             fileno(mFile), 0);
+            if (p == MAP_FAILED)
+            {
+                mMapSize = 0;
+                return false;
+            }
+            ::madvise(p, mMapSize, MADV_SEQUENTIAL);
+            mMap = p;
+            mData = static_cast<char const*>(p);
+        }
+        mBlockPos = 0;
+        mBlockEnd = mMapSize;
+        mEOF = true;
+        mMapped = true;
+        return true;
+#else
+        return false;
+#endif
+    }
 
   public:
-    XDRInputFileStream(int sizeLimit = 0) : mSizeLimit{sizeLimit}
+    // Default block size; small enough to be cheap for short files such as
+    // history checkpoints. Bucket readers ask for larger blocks.
+    static const size_t kDefaultBlockSize = 64 * 1024;
+
+    XDRInputFileStream(int sizeLimit = 0, size_t blockSize = kDefaultBlockSize,
+                       bool mapFile = false)
+        : mSizeLimit{sizeLimit}
+        , mBlockSize{blockSize != 0 ? blockSize : size_t(kDefaultBlockSize)}
+        , mMapFile{mapFile}
+    {
+    }
+
+    XDRInputFileStream(XDRInputFileStream const&) = delete;
+    XDRInputFileStream& operator=(XDRInputFileStream const&) = delete;
+
+    XDRInputFileStream(XDRInputFileStream&& other)
+        : mFile(other.mFile)
+        , mBlock(std::move(other.mBlock))
+        , mMap(other.mMap)
+        , mMapSize(other.mMapSize)
+        , mData(other.mMap ? other.mData : mBlock.data())
+        , mBlockPos(other.mBlockPos)
+        , mBlockEnd(other.mBlockEnd)
+        , mFileOffset(other.mFileOffset)
+        , mEOF(other.mEOF)
+        , mMapped(other.mMapped)
+        , mCompressed(other.mCompressed)
+        , mBlockTable(std::move(other.mBlockTable))
+        , mSizeLimit(other.mSizeLimit)
+        , mBlockSize(other.mBlockSize)
+        , mMapFile(other.mMapFile)
     {
+        other.mFile = nullptr;
+        other.mMap = nullptr;
+        other.mMapSize = 0;
+        other.mData = nullptr;
+        other.mBlockPos = other.mBlockEnd = 0;
+    }
+
+    ~XDRInputFileStream()
+    {
+        close();
     }
 
     void
     close()
     {
-        mIn.close();
+#ifndef _WIN32
+        if (mMap)
+        {
+            ::munmap(mMap, mMapSize);
+        }
+#endif
+        mMap = nullptr;
+        mMapSize = 0;
+        mData = nullptr;
+        if (mFile)
+        {
+            std::fclose(mFile);
+            mFile = nullptr;
+        }
+        mBlockPos = mBlockEnd = 0;
+        mFileOffset = 0;
+        mEOF = false;
+        mMapped = false;
+        mCompressed = false;
+        mBlockTable.clear();
     }
 
     void
     open(std::string const& filename)
     {
-        mIn.open(filename, std::ifstream::binary);
-        if (!mIn)
+        close();
+        mCompressed = isBlockCompressedFile(filename);
+        mFile = std::fopen(filename.c_str(), "rb");
+        if (!mFile)
         {
             std::string msg("failed to open XDR file: ");
             msg += filename;
@@ -49,25 +329,71 @@ class XDRInputFileStream
             CLOG(ERROR, "Fs") << msg;
             throw std::runtime_error(msg);
         }
+        if (mMapFile && !mCompressed && mapWholeFile())
+        {
+            return;
+        }
+        // We do our own buffering in mBlock; stdio's would only add a copy.
+        std::setvbuf(mFile, nullptr, _IONBF, 0);
+#if defined(POSIX_FADV_SEQUENTIAL)
+        posix_fadvise(fileno(mFile), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
     }
 
     operator bool() const
     {
-        return mIn.good();
+        return mFile != nullptr && !(mEOF && mBlockPos == mBlockEnd);
+    }
+
+    // Byte offset in the file of the next record to be read.
+    uint64_t
+    pos() const
+    {
+        if (mMapped)
+        {
+            return mBlockPos;
+        }
+        return mFileOffset - (mBlockEnd - mBlockPos);
+    }
+
+    // Position the stream so the next record is read from byte `offset`,
+    // which must be the start of a record (as returned by `pos`).
+    void
+    seek(uint64_t offset)
+    {
+        if (!mFile)
+        {
+            throw std::runtime_error("seek on unopened XDR file");
+        }
+        if (mMapped)
+        {
+            mBlockPos =
+                static_cast<size_t>(std::min<uint64_t>(offset, mBlockEnd));
+            return;
+        }
+        if (mCompressed)
+        {
+            seekCompressed(offset);
+            return;
+        }
+        seekFile(offset);
+        mBlockPos = mBlockEnd = 0;
+        mFileOffset = offset;
+        mEOF = false;
     }
 
     template <typename T>
     bool
     readOne(T& out)
     {
-        char szBuf[4];
-        if (!mIn.read(szBuf, 4))
+        if (!mFile || !fill(4))
         {
             return false;
         }
 
         // Read 4 bytes of size, big-endian, with XDR 'continuation' bit cleared
         // (high bit of high byte).
+        char const* szBuf = mData + mBlockPos;
         uint32_t sz = 0;
         sz |= static_cast<uint8_t>(szBuf[0] & '\x7f');
         sz <<= 8;
@@ -81,34 +407,46 @@ class XDRInputFileStream
         {
             return false;
         }
-        if (sz > mBuf.size())
-        {
-            mBuf.resize(sz);
-        }
-        if (!mIn.read(mBuf.data(), sz))
+        mBlockPos += 4;
+        if (!fill(sz))
         {
             throw xdr::xdr_runtime_error("malformed XDR file");
         }
-        xdr::xdr_get g(mBuf.data(), mBuf.data() + sz);
+        // Consume the record before decoding it, so that a malformed body
+        // does not leave the stream positioned mid-record.
+        char const* body = mData + mBlockPos;
+        mBlockPos += sz;
+        xdr::xdr_get g(body, body + sz);
         xdr::xdr_argpack_archive(g, out);
         return true;
     }
 };
 
+/**
+ * Helper for writing a sequence of XDR objects to a file, optionally in the
+ * block-compressed format. Hashes and byte counts passed to `writeOne` always
+ * cover the uncompressed XDR.
+ */
 class XDROutputFileStream
 {
     std::ofstream mOut;
     std::vector<char> mBuf;
+    std::unique_ptr<BlockCompressor> mCompressor;
 
   public:
     void
     close()
     {
+        if (mCompressor)
+        {
+            mCompressor->flush();
+            mCompressor.reset();
+        }
         mOut.close();
     }
 
     void
-    open(std::string const& filename)
+    open(std::string const& filename, bool compressed = false)
     {
         mOut.open(filename, std::ofstream::binary | std::ofstream::trunc);
         if (!mOut)
@@ -120,6 +458,10 @@ class XDROutputFileStream
             CLOG(FATAL, "Fs") << msg;
             throw std::runtime_error(msg);
         }
+        if (compressed)
+        {
+            mCompressor = make_unique<BlockCompressor>(mOut);
+        }
     }
 
     operator bool() const
@@ -149,7 +491,15 @@ class XDROutputFileStream
         xdr::xdr_put p(mBuf.data() + 4, mBuf.data() + 4 + sz);
         xdr_argpack_archive(p, t);
 
-        if (!mOut.write(mBuf.data(), sz + 4))
+        if (mCompressor)
+        {
+            mCompressor->write(mBuf.data(), sz + 4);
+        }
+        else
+        {
+            mOut.write(mBuf.data(), sz + 4);
+        }
+        if (!mOut)
         {
             return false;
         }